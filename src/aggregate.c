@@ -0,0 +1,529 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "globals.h"
+
+typedef struct
+{
+    Ingredient *ingredients;
+    int ingredient_count;
+    Potion *potions;
+    int potion_count;
+    Trophy *trophies;
+    int trophy_count;
+    Monster *monsters;
+    int monster_count;
+    NamePool names; // of the session, the merged tables point at the names of every session
+} SessionTables;
+
+typedef struct
+{
+    const char *input_dir;
+    ReplayFile *files;
+    SessionTables *tables;
+    int session_count;
+    atomic_int next_task;
+    atomic_long total_lines;
+    atomic_int failed_files;
+
+    //pairs (i, i + stride) for i a multiple of 2 * stride are merged in the current round
+    int stride;
+    int task_count;
+} AggregateJob;
+
+static void take_session_tables(SessionTables *tables)
+{
+    /**
+        * Function Name: take_session_tables
+        *
+        * Purpose:
+        *    Moves the inventory, potions, trophies and bestiary of the calling thread's session, and their names,
+        *    into a SessionTables.
+        *
+        * Parameters:
+        *     SessionTables *tables - Receives the tables, sorted by name.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Sorts every table and every monster's signs and potions by name so that sessions can be merged linearly.
+        *     - The session no longer owns the moved tables, free_state() only releases what is left.
+        */
+    tables->ingredients = ingredients;
+    tables->ingredient_count = last_added_ingredient_index + 1;
+    tables->potions = potions;
+    tables->potion_count = last_added_potion_index + 1;
+    tables->trophies = trophies;
+    tables->trophy_count = last_added_trophy_index + 1;
+    tables->monsters = monsters;
+    tables->monster_count = last_added_monster_index + 1;
+
+    qsort(tables->ingredients, tables->ingredient_count, sizeof(Ingredient), cmpIngredient);
+    qsort(tables->potions, tables->potion_count, sizeof(Potion), cmpPotion);
+    qsort(tables->trophies, tables->trophy_count, sizeof(Trophy), cmpTrophy);
+    qsort(tables->monsters, tables->monster_count, sizeof(Monster), cmpMonster);
+    for (int i = 0; i < tables->monster_count; i++)
+    {
+        qsort(tables->monsters[i].signs, tables->monsters[i].sign_count, sizeof(Sign), cmpSign);
+        qsort(tables->monsters[i].potions, tables->monsters[i].potion_count, sizeof(Potion), cmpPotion);
+    }
+
+    ingredients = NULL;
+    last_added_ingredient_index = -1;
+    potions = NULL;
+    last_added_potion_index = -1;
+    trophies = NULL;
+    last_added_trophy_index = -1;
+    monsters = NULL;
+    last_added_monster_index = -1;
+    name_pool_take(&tables->names);
+}
+
+static int merge_counted(const Ingredient *a, int a_count, const Ingredient *b, int b_count, Ingredient *out)
+{
+    /**
+        * Function Name: merge_counted
+        *
+        * Purpose:
+        *    Merges two name sorted tables, summing the quantities of the names found in both.
+        *
+        * Parameters:
+        *     const Ingredient *a - The first sorted table.
+        *     int a_count - The number of entries in the first table.
+        *     const Ingredient *b - The second sorted table.
+        *     int b_count - The number of entries in the second table.
+        *     Ingredient *out - Receives the merged table, room for a_count + b_count entries.
+        *
+        * Return:
+        *     int - The number of entries in the merged table.
+        *
+        * Side Effects:
+        *     - Potion and Trophy have the same layout as Ingredient and are merged through this function too.
+        *     - Runs in time linear in the number of distinct names.
+        */
+    int i = 0, j = 0, count = 0;
+    while (i < a_count && j < b_count)
+    {
+        int order = strcmp(a[i].name, b[j].name);
+        if (order < 0)
+            out[count++] = a[i++];
+        else if (order > 0)
+            out[count++] = b[j++];
+        else
+        {
+            out[count] = a[i++];
+            out[count++].quantity += b[j++].quantity;
+        }
+    }
+    while (i < a_count)
+        out[count++] = a[i++];
+    while (j < b_count)
+        out[count++] = b[j++];
+    return count;
+}
+
+static int union_names(const Sign *a, int a_count, const Sign *b, int b_count, Sign *out)
+{
+    /**
+        * Function Name: union_names
+        *
+        * Purpose:
+        *    Unions two name sorted lists of a monster, keeping each name once.
+        *
+        * Parameters:
+        *     const Sign *a - The first sorted list.
+        *     int a_count - The number of entries in the first list.
+        *     const Sign *b - The second sorted list.
+        *     int b_count - The number of entries in the second list.
+        *     Sign *out - Receives the union, room for a_count + b_count entries.
+        *
+        * Return:
+        *     int - The number of entries in the union.
+        *
+        * Side Effects:
+        *     - A monster's potions have the same layout as its signs and are unioned through this function too.
+        */
+    int i = 0, j = 0, count = 0;
+    while (i < a_count && j < b_count)
+    {
+        int order = strcmp(a[i].name, b[j].name);
+        if (order < 0)
+            out[count++] = a[i++];
+        else if (order > 0)
+            out[count++] = b[j++];
+        else
+        {
+            out[count++] = a[i++];
+            j++;
+        }
+    }
+    while (i < a_count)
+        out[count++] = a[i++];
+    while (j < b_count)
+        out[count++] = b[j++];
+    return count;
+}
+
+static void merge_monster(Monster *out, Monster *a, Monster *b)
+{
+    /**
+        * Function Name: merge_monster
+        *
+        * Purpose:
+        *    Combines two bestiary entries of the same monster into one.
+        *
+        * Parameters:
+        *     Monster *out - Receives the combined entry.
+        *     Monster *a - The first entry, its lists are freed.
+        *     Monster *b - The second entry, its lists are freed.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Allocates the combined sign and potion lists, both stay sorted by name.
+        */
+    *out = *a;
+
+    out->sign_capacity = a->sign_count + b->sign_count + 1;
+    out->signs = malloc(out->sign_capacity * sizeof(Sign));
+    out->sign_count = union_names(a->signs, a->sign_count, b->signs, b->sign_count, out->signs);
+
+    out->potion_capacity = a->potion_count + b->potion_count + 1;
+    out->potions = malloc(out->potion_capacity * sizeof(Potion));
+    out->potion_count = union_names((Sign *)a->potions, a->potion_count, (Sign *)b->potions, b->potion_count, (Sign *)out->potions);
+
+    free(a->signs);
+    free(a->potions);
+    free(b->signs);
+    free(b->potions);
+}
+
+static void merge_session_tables(SessionTables *into, SessionTables *from)
+{
+    /**
+        * Function Name: merge_session_tables
+        *
+        * Purpose:
+        *    Merges the tables of one session into another.
+        *
+        * Parameters:
+        *     SessionTables *into - The tables that receive the merge.
+        *     SessionTables *from - The tables merged in, released afterwards.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Sums the quantities of ingredients, potions and trophies with the same name.
+        *     - Unions the signs and potions of monsters with the same name.
+        *     - Runs in time linear in the number of distinct names of both sessions.
+        */
+    Ingredient *merged_ingredients = malloc((into->ingredient_count + from->ingredient_count + 1) * sizeof(Ingredient));
+    into->ingredient_count = merge_counted(into->ingredients, into->ingredient_count,
+                                           from->ingredients, from->ingredient_count, merged_ingredients);
+    free(into->ingredients);
+    free(from->ingredients);
+    into->ingredients = merged_ingredients;
+
+    Potion *merged_potions = malloc((into->potion_count + from->potion_count + 1) * sizeof(Potion));
+    into->potion_count = merge_counted((Ingredient *)into->potions, into->potion_count,
+                                       (Ingredient *)from->potions, from->potion_count, (Ingredient *)merged_potions);
+    free(into->potions);
+    free(from->potions);
+    into->potions = merged_potions;
+
+    Trophy *merged_trophies = malloc((into->trophy_count + from->trophy_count + 1) * sizeof(Trophy));
+    into->trophy_count = merge_counted((Ingredient *)into->trophies, into->trophy_count,
+                                       (Ingredient *)from->trophies, from->trophy_count, (Ingredient *)merged_trophies);
+    free(into->trophies);
+    free(from->trophies);
+    into->trophies = merged_trophies;
+
+    Monster *merged_monsters = malloc((into->monster_count + from->monster_count + 1) * sizeof(Monster));
+    int i = 0, j = 0, count = 0;
+    while (i < into->monster_count && j < from->monster_count)
+    {
+        int order = strcmp(into->monsters[i].name, from->monsters[j].name);
+        if (order < 0)
+            merged_monsters[count++] = into->monsters[i++];
+        else if (order > 0)
+            merged_monsters[count++] = from->monsters[j++];
+        else
+            merge_monster(&merged_monsters[count++], &into->monsters[i++], &from->monsters[j++]);
+    }
+    while (i < into->monster_count)
+        merged_monsters[count++] = into->monsters[i++];
+    while (j < from->monster_count)
+        merged_monsters[count++] = from->monsters[j++];
+    free(into->monsters);
+    free(from->monsters);
+    into->monsters = merged_monsters;
+    into->monster_count = count;
+}
+
+static void *aggregate_replay_worker(void *arg)
+{
+    /**
+        * Function Name: aggregate_replay_worker
+        *
+        * Purpose:
+        *    Thread body of the map phase, replays session logs into private tables.
+        *
+        * Parameters:
+        *     void *arg - The shared AggregateJob.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - Fills job->tables[i] for every file i it takes, the responses are discarded.
+        */
+    AggregateJob *job = arg;
+    char input_path[4096];
+    FILE *discard = fopen("/dev/null", "w");
+
+    while (1)
+    {
+        int index = atomic_fetch_add(&job->next_task, 1);
+        if (index >= job->session_count)
+            break;
+
+        memset(&job->tables[index], 0, sizeof(SessionTables));
+        snprintf(input_path, sizeof(input_path), "%s/%s", job->input_dir, job->files[index].name);
+        FILE *input = fopen(input_path, "r");
+        if (!input)
+        {
+            fprintf(stderr, "Could not replay %s\n", input_path);
+            atomic_fetch_add(&job->failed_files, 1);
+            continue;
+        }
+
+        init_state();
+        output_stream = discard;
+        atomic_fetch_add(&job->total_lines, replay_session(input));
+        output_stream = NULL;
+        //the session is counted while it still owns the tables it hands over
+        mem_stats_end_session();
+        take_session_tables(&job->tables[index]);
+        free_state();
+        fclose(input);
+    }
+
+    fclose(discard);
+    return NULL;
+}
+
+static void *aggregate_merge_worker(void *arg)
+{
+    /**
+        * Function Name: aggregate_merge_worker
+        *
+        * Purpose:
+        *    Thread body of one round of the reduction tree.
+        *
+        * Parameters:
+        *     void *arg - The shared AggregateJob.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - Merges tables[i + stride] into tables[i] for every pair it takes.
+        */
+    AggregateJob *job = arg;
+    while (1)
+    {
+        int task = atomic_fetch_add(&job->next_task, 1);
+        if (task >= job->task_count)
+            break;
+        int left = task * 2 * job->stride;
+        merge_session_tables(&job->tables[left], &job->tables[left + job->stride]);
+    }
+    return NULL;
+}
+
+static void run_aggregate_workers(AggregateJob *job, void *(*worker)(void *), int task_count, int thread_count)
+{
+    /**
+        * Function Name: run_aggregate_workers
+        *
+        * Purpose:
+        *    Runs task_count tasks of a phase on up to thread_count threads and waits for them.
+        *
+        * Parameters:
+        *     AggregateJob *job - The shared job.
+        *     void *(*worker)(void *) - The thread body of the phase.
+        *     int task_count - The number of tasks in the phase.
+        *     int thread_count - The maximum number of threads.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Resets the job's task counter.
+        */
+    if (thread_count > task_count)
+        thread_count = task_count;
+    atomic_store(&job->next_task, 0);
+
+    pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+    for (int i = 0; i < thread_count; i++)
+        pthread_create(&threads[i], NULL, worker, job);
+    for (int i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+static void print_counted(const char *label, const Ingredient *items, int count)
+{
+    /**
+        * Function Name: print_counted
+        *
+        * Purpose:
+        *    Prints one merged quantity table in the format of the Total queries.
+        *
+        * Parameters:
+        *     const char *label - The name of the table.
+        *     const Ingredient *items - The sorted table.
+        *     int count - The number of entries in the table.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Entries with zero quantity are skipped, "None" is printed when nothing is left.
+        */
+    int printed = 0;
+    print_output("%s: ", label);
+    for (int i = 0; i < count; i++)
+    {
+        if (items[i].quantity == 0)
+            continue;
+        print_output("%s%d %s", printed > 0 ? ", " : "", items[i].quantity, items[i].name);
+        printed++;
+    }
+    print_output("%s\n", printed == 0 ? "None" : "");
+}
+
+static void print_bestiary(const Monster *monsters, int monster_count)
+{
+    /**
+        * Function Name: print_bestiary
+        *
+        * Purpose:
+        *    Prints one line per merged monster with its effective signs and potions.
+        *
+        * Parameters:
+        *     const Monster *monsters - The sorted bestiary.
+        *     int monster_count - The number of monsters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Signs and potions are printed together in alphabetical order like "What is effective against".
+        */
+    for (int i = 0; i < monster_count; i++)
+    {
+        const Monster *m = &monsters[i];
+        print_output("%s: ", m->name);
+        int s = 0, p = 0;
+        while (s < m->sign_count || p < m->potion_count)
+        {
+            const char *name;
+            if (p >= m->potion_count || (s < m->sign_count && strcmp(m->signs[s].name, m->potions[p].name) <= 0))
+                name = m->signs[s++].name;
+            else
+                name = m->potions[p++].name;
+            print_output("%s%s", s + p > 1 ? ", " : "", name);
+        }
+        print_output("\n");
+    }
+}
+
+int aggregate_directory(const char *input_dir, int thread_count)
+{
+    /**
+        * Function Name: aggregate_directory
+        *
+        * Purpose:
+        *    Replays every input file of a directory in its own session and prints the combined
+        *    inventory, potions, trophies and bestiary of all sessions.
+        *
+        * Parameters:
+        *     const char *input_dir - The directory holding the input* session logs.
+        *     int thread_count - The number of worker threads, one per online core if not positive.
+        *
+        * Return:
+        *     int - 0 on success, 1 if the directory or a file could not be processed.
+        *
+        * Side Effects:
+        *     - The sessions are replayed in parallel, then merged pairwise in a parallel reduction tree.
+        *     - Prints the merged tables to stdout and the timing to stderr.
+        */
+    DIR *dir = opendir(input_dir);
+    if (!dir)
+    {
+        fprintf(stderr, "Could not open %s\n", input_dir);
+        return 1;
+    }
+
+    AggregateJob job;
+    job.input_dir = input_dir;
+    job.session_count = list_session_logs(dir, input_dir, &job.files);
+    closedir(dir);
+    job.tables = calloc(job.session_count + 1, sizeof(SessionTables));
+    atomic_init(&job.next_task, 0);
+    atomic_init(&job.total_lines, 0);
+    atomic_init(&job.failed_files, 0);
+
+    if (thread_count <= 0)
+        thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1)
+        thread_count = 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    run_aggregate_workers(&job, aggregate_replay_worker, job.session_count, thread_count);
+
+    for (job.stride = 1; job.stride < job.session_count; job.stride *= 2)
+    {
+        job.task_count = (job.session_count - job.stride + 2 * job.stride - 1) / (2 * job.stride);
+        run_aggregate_workers(&job, aggregate_merge_worker, job.task_count, thread_count);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    SessionTables *merged = &job.tables[0];
+    print_counted("Ingredients", merged->ingredients, merged->ingredient_count);
+    print_counted("Potions", (Ingredient *)merged->potions, merged->potion_count);
+    print_counted("Trophies", (Ingredient *)merged->trophies, merged->trophy_count);
+    print_bestiary(merged->monsters, merged->monster_count);
+
+    fprintf(stderr, "Aggregated %d sessions, %ld lines on %d threads in %.3f s\n",
+            job.session_count - atomic_load(&job.failed_files), atomic_load(&job.total_lines), thread_count, seconds);
+
+    for (int i = 0; i < merged->monster_count; i++)
+    {
+        free(merged->monsters[i].signs);
+        free(merged->monsters[i].potions);
+    }
+    free(merged->ingredients);
+    free(merged->potions);
+    free(merged->trophies);
+    free(merged->monsters);
+    for (int i = 0; i < job.session_count; i++)
+        name_pool_release(&job.tables[i].names);
+    free(job.tables);
+    free(job.files);
+    return atomic_load(&job.failed_files) == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+THREAD_LOCAL BestiaryIndex bestiary_index;
+
+const BestiaryEntry *bestiary_index_find(const char *name)
+{
+    /**
+        * Function Name: bestiary_index_find
+        *
+        * Purpose:
+        *    Finds the monsters a sign or potion was learned to be effective against in the calling thread's session.
+        *
+        * Parameters:
+        *     const char *name - The name of the sign or potion.
+        *
+        * Return:
+        *     const BestiaryEntry * - The entry, NULL if the session never learned anything about the name.
+        */
+    const BestiaryIndex *index = &bestiary_index;
+    if (index->buckets == NULL)
+        return NULL;
+    for (BestiaryEntry *entry = index->buckets[hash_name(name) & (index->bucket_count - 1)]; entry != NULL; entry = entry->next_in_bucket)
+        if (strcmp(entry->name, name) == 0)
+            return entry;
+    return NULL;
+}
+
+void bestiary_index_learned(const char *name, int monster)
+{
+    /**
+        * Function Name: bestiary_index_learned
+        *
+        * Purpose:
+        *    Files a monster under a sign or potion the session just learned to be effective against it.
+        *
+        * Parameters:
+        *     const char *name - The name of the sign or potion.
+        *     int monster - The index of the monster in the session's monsters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Allocates the buckets on first use, then doubles them and rehashes the entries when they are full.
+        *     - A name learned both as a sign and as a potion against the same monster files it twice.
+        */
+    BestiaryIndex *index = &bestiary_index;
+    BestiaryEntry *entry = (BestiaryEntry *)bestiary_index_find(name);
+    if (entry == NULL)
+    {
+        if (index->buckets == NULL || index->entry_count >= index->bucket_count)
+        {
+            int bucket_count = index->buckets == NULL ? 64 : index->bucket_count * 2;
+            BestiaryEntry **buckets = mem_calloc(MEM_BESTIARY_INDEX, bucket_count, sizeof(BestiaryEntry *));
+            for (int i = 0; i < index->bucket_count; i++)
+            {
+                BestiaryEntry *moved = index->buckets[i];
+                while (moved != NULL)
+                {
+                    BestiaryEntry *next = moved->next_in_bucket;
+                    BestiaryEntry **bucket = &buckets[hash_name(moved->name) & (bucket_count - 1)];
+                    moved->next_in_bucket = *bucket;
+                    *bucket = moved;
+                    moved = next;
+                }
+            }
+            mem_free(MEM_BESTIARY_INDEX, index->buckets, index->bucket_count * sizeof(BestiaryEntry *));
+            index->buckets = buckets;
+            index->bucket_count = bucket_count;
+        }
+
+        entry = mem_calloc(MEM_BESTIARY_INDEX, 1, sizeof(BestiaryEntry));
+        entry->name = name_pool_intern(name);
+        BestiaryEntry **bucket = &index->buckets[hash_name(name) & (index->bucket_count - 1)];
+        entry->next_in_bucket = *bucket;
+        *bucket = entry;
+        index->entry_count++;
+    }
+
+    if (entry->monster_count >= entry->monster_capacity)
+    {
+        int capacity = entry->monster_capacity == 0 ? 4 : entry->monster_capacity * 2;
+        entry->monsters = mem_realloc(MEM_BESTIARY_INDEX, entry->monsters, entry->monster_capacity * sizeof(int), capacity * sizeof(int));
+        entry->monster_capacity = capacity;
+    }
+    entry->monsters[entry->monster_count++] = monster;
+}
+
+void bestiary_index_free()
+{
+    /**
+        * Function Name: bestiary_index_free
+        *
+        * Purpose:
+        *    Releases the calling thread's bestiary index.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The next session on the thread starts with an empty index.
+        */
+    BestiaryIndex *index = &bestiary_index;
+    for (int i = 0; i < index->bucket_count; i++)
+    {
+        BestiaryEntry *entry = index->buckets[i];
+        while (entry != NULL)
+        {
+            BestiaryEntry *next = entry->next_in_bucket;
+            mem_free(MEM_BESTIARY_INDEX, entry->monsters, entry->monster_capacity * sizeof(int));
+            mem_free(MEM_BESTIARY_INDEX, entry, sizeof(BestiaryEntry));
+            entry = next;
+        }
+    }
+    mem_free(MEM_BESTIARY_INDEX, index->buckets, index->bucket_count * sizeof(BestiaryEntry *));
+    memset(index, 0, sizeof(BestiaryIndex));
+}
@@ -0,0 +1,820 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include "globals.h"
+
+// frames larger than this are taken as a corrupt stream, the text parser holds lines of less than 1 GiB,
+// whose frames are at most twice as long, so no line it accepts is beyond it
+#define BINARY_MAX_FRAME 0x7fff0000
+
+// a frame being decoded, a read past its end marks it as failed instead of reading garbage
+typedef struct
+{
+    const unsigned char *data;
+    int length;
+    int position;
+    Bool failed;
+} FrameReader;
+
+// how a name field is checked, so that a binary command is one the text grammar could have given
+typedef enum
+{
+    NAME_WORD,            // a single word
+    NAME_WORDS,           // one or more words separated by single spaces
+    NAME_WORDS_NO_POTION, // as NAME_WORDS, without the word "potion"
+    NAME_WORDS_NO_TYPE,   // as NAME_WORDS, without the words "potion" and "sign", may be empty
+    NAME_PREFIX,          // a single word of a name pattern, alphabetic up to a final '*'
+    NAME_WORDS_PREFIX     // words of a name pattern, the last one as NAME_PREFIX
+} NameRule;
+
+void append_bytes(OutputBuffer *buffer, const void *bytes, int length)
+{
+    /**
+        * Function Name: append_bytes
+        *
+        * Purpose:
+        *    Appends raw bytes to a growable buffer.
+        *
+        * Parameters:
+        *     OutputBuffer *buffer - The buffer.
+        *     const void *bytes - The bytes to be appended.
+        *     int length - The number of bytes.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Doubles the capacity of the buffer until the bytes fit, up to the largest an int can count.
+        */
+    if (buffer->length + length > buffer->capacity)
+    {
+        while (buffer->length + length > buffer->capacity)
+            buffer->capacity = buffer->capacity == 0 ? 256 : buffer->capacity > INT_MAX / 2 ? INT_MAX : buffer->capacity * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+void append_u8(OutputBuffer *buffer, int value)
+{
+    /**
+        * Function Name: append_u8
+        *
+        * Purpose:
+        *    Appends one byte to a buffer.
+        *
+        * Parameters:
+        *     OutputBuffer *buffer - The buffer.
+        *     int value - The byte.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    unsigned char byte = value;
+    append_bytes(buffer, &byte, 1);
+}
+
+void append_u32(OutputBuffer *buffer, uint32_t value)
+{
+    /**
+        * Function Name: append_u32
+        *
+        * Purpose:
+        *    Appends a 32-bit little-endian integer to a buffer, negative quantities as two's complement.
+        *
+        * Parameters:
+        *     OutputBuffer *buffer - The buffer.
+        *     uint32_t value - The integer.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    unsigned char bytes[4] = {value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff};
+    append_bytes(buffer, bytes, 4);
+}
+
+void append_name_field(OutputBuffer *buffer, const char *name, int length)
+{
+    /**
+        * Function Name: append_name_field
+        *
+        * Purpose:
+        *    Appends a name as a 32-bit length followed by its bytes.
+        *
+        * Parameters:
+        *     OutputBuffer *buffer - The buffer.
+        *     const char *name - The name, not null terminated.
+        *     int length - The number of bytes of the name.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    append_u32(buffer, length);
+    append_bytes(buffer, name, length);
+}
+
+static int read_u8(FrameReader *reader)
+{
+    /**
+        * Function Name: read_u8
+        *
+        * Purpose:
+        *    Reads one byte of a frame.
+        *
+        * Parameters:
+        *     FrameReader *reader - The frame.
+        *
+        * Return:
+        *     int - The byte, 0 if the frame has no byte left.
+        */
+    if (reader->position + 1 > reader->length)
+    {
+        reader->failed = TRUE;
+        return 0;
+    }
+    return reader->data[reader->position++];
+}
+
+static uint32_t read_u32(FrameReader *reader)
+{
+    /**
+        * Function Name: read_u32
+        *
+        * Purpose:
+        *    Reads a 32-bit little-endian integer of a frame.
+        *
+        * Parameters:
+        *     FrameReader *reader - The frame.
+        *
+        * Return:
+        *     uint32_t - The integer, 0 if the frame is too short.
+        */
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)read_u8(reader) << (8 * i);
+    return value;
+}
+
+static Bool is_valid_name(const char *name, NameRule rule)
+{
+    /**
+        * Function Name: is_valid_name
+        *
+        * Purpose:
+        *    Checks a decoded name against what the text grammar accepts in the same place.
+        *
+        * Parameters:
+        *     const char *name - The name.
+        *     NameRule rule - Which names the field takes.
+        *
+        * Return:
+        *     Bool - TRUE if the name is valid, FALSE otherwise.
+        */
+    //the text grammar learns an empty name when the type comes right after "learns", e.g. "learns sign sign ..."
+    if (name[0] == '\0')
+        return rule == NAME_WORDS_NO_TYPE;
+
+    //a pattern is a name followed by '*', whose last word may be just the '*', e.g. "Black *"
+    if (rule == NAME_PREFIX || rule == NAME_WORDS_PREFIX)
+    {
+        int length = strlen(name);
+        if (name[length - 1] != '*')
+            return FALSE;
+        if (length == 1)
+            return TRUE;
+        char *words = malloc(length);
+        memcpy(words, name, length - 1);
+        words[length - 1] = '\0';
+        Bool valid;
+        if (words[length - 2] == ' ')
+        {
+            words[length - 2] = '\0';
+            valid = rule == NAME_WORDS_PREFIX && is_valid_name(words, NAME_WORDS);
+        }
+        else
+            valid = is_valid_name(words, rule == NAME_PREFIX ? NAME_WORD : NAME_WORDS);
+        free(words);
+        return valid;
+    }
+
+    int word_count = 0;
+    const char *word = name;
+    while (1)
+    {
+        int length = strcspn(word, " ");
+        if (length == 0)
+            return FALSE;
+
+        for (int i = 0; i < length; i++)
+            if (!((word[i] >= 'A' && word[i] <= 'Z') || (word[i] >= 'a' && word[i] <= 'z')))
+                return FALSE;
+        if (rule != NAME_WORD && rule != NAME_WORDS && length == 6 && strncmp(word, "potion", 6) == 0)
+            return FALSE;
+        if (rule == NAME_WORDS_NO_TYPE && length == 4 && strncmp(word, "sign", 4) == 0)
+            return FALSE;
+
+        word_count++;
+        if (word[length] == '\0')
+            break;
+        word += length + 1;
+    }
+    return word_count == 1 || rule != NAME_WORD;
+}
+
+static int read_name(FrameReader *reader, Command *command, NameRule rule)
+{
+    /**
+        * Function Name: read_name
+        *
+        * Purpose:
+        *    Reads a length-prefixed name of a frame into a command.
+        *
+        * Parameters:
+        *     FrameReader *reader - The frame.
+        *     Command *command - The command that stores the name.
+        *     NameRule rule - Which names the field takes.
+        *
+        * Return:
+        *     int - The offset of the stored name.
+        *
+        * Side Effects:
+        *     - Marks the frame as failed if the name is missing or not valid.
+        *     - The name goes straight into the command's text, whatever its length.
+        */
+    uint32_t length = read_u32(reader);
+    if (reader->failed || length > (uint32_t)(reader->length - reader->position) ||
+        memchr(reader->data + reader->position, '\0', length) != NULL)
+    {
+        reader->failed = TRUE;
+        return 0;
+    }
+
+    int name = command_add_chars(command, (const char *)reader->data + reader->position, length);
+    reader->position += length;
+    if (!is_valid_name(command_text(command, name), rule))
+    {
+        reader->failed = TRUE;
+        return 0;
+    }
+    return name;
+}
+
+static int read_items(FrameReader *reader, Command *command)
+{
+    /**
+        * Function Name: read_items
+        *
+        * Purpose:
+        *    Reads a list of quantities and single word names of a frame into the items of a command.
+        *
+        * Parameters:
+        *     FrameReader *reader - The frame.
+        *     Command *command - The command that receives the items.
+        *
+        * Return:
+        *     int - The number of items read.
+        *
+        * Side Effects:
+        *     - Marks the frame as failed if a quantity is not positive or a name is not valid.
+        */
+    uint32_t count = read_u32(reader);
+    for (uint32_t i = 0; i < count && !reader->failed; i++)
+    {
+        uint32_t quantity = read_u32(reader);
+        if (quantity == 0 || quantity > 0x7fffffff)
+            reader->failed = TRUE;
+        int name = read_name(reader, command, NAME_WORD);
+        if (reader->failed)
+            return i;
+        command_add_stored_item(command, name, quantity);
+    }
+    return count;
+}
+
+static void read_name_list(FrameReader *reader, Command *command, NameRule rule)
+{
+    /**
+        * Function Name: read_name_list
+        *
+        * Purpose:
+        *    Reads a list of names of a frame into the items of a command.
+        *
+        * Parameters:
+        *     FrameReader *reader - The frame.
+        *     Command *command - The command that receives one item per name.
+        *     NameRule rule - How every name is checked.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Marks the frame as failed if the list is empty or a name is not valid.
+        */
+    uint32_t count = read_u32(reader);
+    if (count == 0)
+        reader->failed = TRUE;
+    for (uint32_t i = 0; i < count && !reader->failed; i++)
+    {
+        int name = read_name(reader, command, rule);
+        if (!reader->failed)
+            command_add_stored_item(command, name, 1);
+    }
+}
+
+static void decode_command(const unsigned char *frame, int length, Command *command)
+{
+    /**
+        * Function Name: decode_command
+        *
+        * Purpose:
+        *    Turns a request frame into a command, without any tokenizing or grammar matching.
+        *
+        * Parameters:
+        *     const unsigned char *frame - The payload of the frame, opcode first.
+        *     int length - The number of bytes of the payload.
+        *     Command *command - Receives the command, its previous content is discarded.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The kind is COMMAND_INVALID for unknown opcodes and for frames that are malformed or have trailing bytes.
+        */
+    command_reset(command);
+    FrameReader reader = {frame, length, 0, FALSE};
+    CommandKind kind = COMMAND_INVALID;
+    int opcode = read_u8(&reader);
+
+    switch (opcode)
+    {
+    case OPCODE_EXIT:
+        kind = COMMAND_EXIT;
+        break;
+    case OPCODE_LOOT:
+        kind = COMMAND_LOOT;
+        read_items(&reader, command);
+        break;
+    case OPCODE_TRADE:
+        kind = COMMAND_TRADE;
+        command->trophy_count = read_items(&reader, command);
+        read_items(&reader, command);
+        break;
+    case OPCODE_BREW:
+        kind = COMMAND_BREW;
+        command->name = read_name(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_BREW_BATCH:
+        kind = COMMAND_BREW_BATCH;
+        command->quantity = read_u32(&reader);
+        if (command->quantity < 0)
+            reader.failed = TRUE;
+        command->name = read_name(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_BREW_LIST:
+        kind = COMMAND_BREW_LIST;
+        read_name_list(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_LEARN_FORMULA:
+        kind = COMMAND_LEARN_FORMULA;
+        command->name = read_name(&reader, command, NAME_WORDS_NO_POTION);
+        if (read_items(&reader, command) == 0)
+            reader.failed = TRUE;
+        break;
+    case OPCODE_LEARN_SIGN:
+        kind = COMMAND_LEARN_EFFECTIVENESS;
+        command->is_sign = TRUE;
+        command->name = read_name(&reader, command, NAME_WORDS_NO_TYPE);
+        command->target = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_LEARN_POTION:
+        kind = COMMAND_LEARN_EFFECTIVENESS;
+        command->name = read_name(&reader, command, NAME_WORDS_NO_TYPE);
+        command->target = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_ENCOUNTER:
+        kind = COMMAND_ENCOUNTER;
+        command->name = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_ENCOUNTER_BATCH:
+        kind = COMMAND_ENCOUNTER_BATCH;
+        command->quantity = read_u32(&reader);
+        if (command->quantity <= 0)
+            reader.failed = TRUE;
+        command->name = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_INGREDIENT_QUERY:
+        kind = COMMAND_INGREDIENT_QUERY;
+        command->name = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_POTION_QUERY:
+        kind = COMMAND_POTION_QUERY;
+        command->name = read_name(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_TROPHY_QUERY:
+        kind = COMMAND_TROPHY_QUERY;
+        command->name = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_ALL_INGREDIENTS_QUERY:
+        kind = COMMAND_ALL_INGREDIENTS_QUERY;
+        break;
+    case OPCODE_ALL_POTIONS_QUERY:
+        kind = COMMAND_ALL_POTIONS_QUERY;
+        break;
+    case OPCODE_ALL_TROPHIES_QUERY:
+        kind = COMMAND_ALL_TROPHIES_QUERY;
+        break;
+    case OPCODE_MONSTER_QUERY:
+        kind = COMMAND_MONSTER_QUERY;
+        command->name = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_POTION_FORMULA_QUERY:
+        kind = COMMAND_POTION_FORMULA_QUERY;
+        command->name = read_name(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_BREWABLE_QUERY:
+        kind = COMMAND_BREWABLE_QUERY;
+        break;
+    case OPCODE_MEMORY_QUERY:
+        kind = COMMAND_MEMORY_QUERY;
+        break;
+    case OPCODE_MEMORY_ALLOCATIONS_QUERY:
+        kind = COMMAND_MEMORY_ALLOCATIONS_QUERY;
+        break;
+    case OPCODE_USES_QUERY:
+        kind = COMMAND_USES_QUERY;
+        command->name = read_name(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_EFFECTIVE_AGAINST_QUERY:
+        kind = COMMAND_EFFECTIVE_AGAINST_QUERY;
+        command->name = read_name(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_TOP_INGREDIENTS_QUERY:
+    case OPCODE_TOP_POTIONS_QUERY:
+    case OPCODE_TOP_TROPHIES_QUERY:
+    case OPCODE_INGREDIENTS_BELOW_QUERY:
+    case OPCODE_POTIONS_BELOW_QUERY:
+    case OPCODE_TROPHIES_BELOW_QUERY:
+        //the six opcodes are in the order of their command kinds
+        kind = COMMAND_TOP_INGREDIENTS_QUERY + (opcode - OPCODE_TOP_INGREDIENTS_QUERY);
+        command->quantity = read_u32(&reader);
+        if (command->quantity <= 0)
+            reader.failed = TRUE;
+        break;
+    case OPCODE_MULTI_INGREDIENT_QUERY:
+        kind = COMMAND_MULTI_INGREDIENT_QUERY;
+        read_name_list(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_MULTI_POTION_QUERY:
+        kind = COMMAND_MULTI_POTION_QUERY;
+        read_name_list(&reader, command, NAME_WORDS);
+        break;
+    case OPCODE_MULTI_TROPHY_QUERY:
+        kind = COMMAND_MULTI_TROPHY_QUERY;
+        read_name_list(&reader, command, NAME_WORD);
+        break;
+    case OPCODE_INGREDIENT_PREFIX_QUERY:
+    case OPCODE_POTION_PREFIX_QUERY:
+    case OPCODE_TROPHY_PREFIX_QUERY:
+    case OPCODE_MONSTER_PREFIX_QUERY:
+        kind = COMMAND_INGREDIENT_PREFIX_QUERY + (opcode - OPCODE_INGREDIENT_PREFIX_QUERY);
+        command->name = read_name(&reader, command, opcode == OPCODE_POTION_PREFIX_QUERY ? NAME_WORDS_PREFIX : NAME_PREFIX);
+        break;
+    default:
+        reader.failed = TRUE;
+        break;
+    }
+
+    if (reader.failed || reader.position != reader.length)
+    {
+        command_reset(command);
+        return;
+    }
+    command->kind = kind;
+}
+
+static int buffered_frame(const unsigned char *data, int available, int *length)
+{
+    /**
+        * Function Name: buffered_frame
+        *
+        * Purpose:
+        *    Tells if the input read so far starts with a whole length-prefixed frame.
+        *
+        * Parameters:
+        *     const unsigned char *data - The input not decoded yet.
+        *     int available - The number of bytes of it.
+        *     int *length - Receives the payload length once the prefix is read.
+        *
+        * Return:
+        *     int - 1 if the whole frame is there, 0 if more input is needed, -1 if the length is corrupt.
+        */
+    *length = 0;
+    if (available < 4)
+        return 0;
+    uint32_t frame_length = data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+    if (frame_length > BINARY_MAX_FRAME)
+        return -1;
+    *length = frame_length;
+    return available - 4 >= (int)frame_length ? 1 : 0;
+}
+
+static void flush_responses(OutputBuffer *responses, FILE *output)
+{
+    /**
+        * Function Name: flush_responses
+        *
+        * Purpose:
+        *    Writes the response frames collected so far and flushes them to the client.
+        *
+        * Parameters:
+        *     OutputBuffer *responses - The frames, emptied.
+        *     FILE *output - The stream of the client.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (responses->length > 0)
+        fwrite(responses->data, 1, responses->length, output);
+    responses->length = 0;
+    fflush(output);
+}
+
+int run_binary_session(FILE *input, FILE *output)
+{
+    /**
+        * Function Name: run_binary_session
+        *
+        * Purpose:
+        *    Runs a session whose commands and responses are binary frames instead of text lines.
+        *
+        * Parameters:
+        *     FILE *input - The stream of request frames, nothing of it read yet, it is read through its descriptor.
+        *     FILE *output - The stream receiving one response frame per request, one per potion for a brew list.
+        *
+        * Return:
+        *     int - 0 once the stream ends or an Exit frame is read, 1 on a truncated or corrupt stream.
+        *
+        * Side Effects:
+        *     - Decoded commands go through execute_command like parsed lines, so the tables change the same way.
+        *     - The handlers append their response frames directly, no text answer is made.
+        *     - Input is read as it arrives and every whole frame of it is answered, the responses are written
+        *       and flushed before waiting for more. A client waiting for its answers always gets them, and
+        *       a stream sent at once is answered in large writes.
+        */
+    init_state();
+    OutputBuffer responses = {NULL, 0, 0};
+    int capacity = 65536;
+    unsigned char *data = malloc(capacity);
+    int start = 0;
+    int end = 0;
+    int status = 0;
+
+    while (1)
+    {
+        int length;
+        int found = buffered_frame(data + start, end - start, &length);
+        if (found < 0)
+        {
+            fprintf(stderr, "Truncated or corrupt frame, the session is stopped\n");
+            status = 1;
+            break;
+        }
+        if (found == 0)
+        {
+            //nothing whole is left to answer, so the client may be waiting for what was answered so far
+            flush_responses(&responses, output);
+            memmove(data, data + start, end - start);
+            end -= start;
+            start = 0;
+            while (4 + length > capacity)
+            {
+                capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+                data = realloc(data, capacity);
+            }
+            ssize_t read_length = read(fileno(input), data + end, capacity - end);
+            if (read_length < 0 && errno == EINTR)
+                continue;
+            if (read_length <= 0)
+            {
+                if (end > 0)
+                {
+                    fprintf(stderr, "Truncated or corrupt frame, the session is stopped\n");
+                    status = 1;
+                }
+                break;
+            }
+            end += read_length;
+            continue;
+        }
+
+        decode_command(data + start + 4, length, &line_command);
+        start += 4 + length;
+        response_frames = &responses;
+        Bool running = execute_command(&line_command);
+        response_frames = NULL;
+        if (!running)
+            break;
+        if (responses.length >= 65536)
+        {
+            fwrite(responses.data, 1, responses.length, output);
+            responses.length = 0;
+        }
+    }
+
+    flush_responses(&responses, output);
+    free(responses.data);
+    free(data);
+    free_state();
+    return status;
+}
+
+static void encode_command(OutputBuffer *out, const Command *command)
+{
+    /**
+        * Function Name: encode_command
+        *
+        * Purpose:
+        *    Appends the request frame of a parsed command.
+        *
+        * Parameters:
+        *     OutputBuffer *out - The buffer receiving the frame.
+        *     const Command *command - The command, as produced by parse_line.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Invalid commands are sent as OPCODE_INVALID, so every line still gets its INVALID response.
+        *     - So would be a command whose frame is larger than BINARY_MAX_FRAME, which no line the parser holds gives.
+        */
+    static const unsigned char opcodes[] = {
+        [COMMAND_INVALID] = OPCODE_INVALID,
+        [COMMAND_EXIT] = OPCODE_EXIT,
+        [COMMAND_LOOT] = OPCODE_LOOT,
+        [COMMAND_TRADE] = OPCODE_TRADE,
+        [COMMAND_BREW] = OPCODE_BREW,
+        [COMMAND_BREW_BATCH] = OPCODE_BREW_BATCH,
+        [COMMAND_BREW_LIST] = OPCODE_BREW_LIST,
+        [COMMAND_LEARN_FORMULA] = OPCODE_LEARN_FORMULA,
+        [COMMAND_LEARN_EFFECTIVENESS] = OPCODE_LEARN_POTION,
+        [COMMAND_ENCOUNTER] = OPCODE_ENCOUNTER,
+        [COMMAND_INGREDIENT_QUERY] = OPCODE_INGREDIENT_QUERY,
+        [COMMAND_POTION_QUERY] = OPCODE_POTION_QUERY,
+        [COMMAND_TROPHY_QUERY] = OPCODE_TROPHY_QUERY,
+        [COMMAND_ALL_INGREDIENTS_QUERY] = OPCODE_ALL_INGREDIENTS_QUERY,
+        [COMMAND_ALL_POTIONS_QUERY] = OPCODE_ALL_POTIONS_QUERY,
+        [COMMAND_ALL_TROPHIES_QUERY] = OPCODE_ALL_TROPHIES_QUERY,
+        [COMMAND_MONSTER_QUERY] = OPCODE_MONSTER_QUERY,
+        [COMMAND_POTION_FORMULA_QUERY] = OPCODE_POTION_FORMULA_QUERY,
+        [COMMAND_BREWABLE_QUERY] = OPCODE_BREWABLE_QUERY,
+        [COMMAND_USES_QUERY] = OPCODE_USES_QUERY,
+        [COMMAND_EFFECTIVE_AGAINST_QUERY] = OPCODE_EFFECTIVE_AGAINST_QUERY,
+        [COMMAND_TOP_INGREDIENTS_QUERY] = OPCODE_TOP_INGREDIENTS_QUERY,
+        [COMMAND_TOP_POTIONS_QUERY] = OPCODE_TOP_POTIONS_QUERY,
+        [COMMAND_TOP_TROPHIES_QUERY] = OPCODE_TOP_TROPHIES_QUERY,
+        [COMMAND_INGREDIENTS_BELOW_QUERY] = OPCODE_INGREDIENTS_BELOW_QUERY,
+        [COMMAND_POTIONS_BELOW_QUERY] = OPCODE_POTIONS_BELOW_QUERY,
+        [COMMAND_TROPHIES_BELOW_QUERY] = OPCODE_TROPHIES_BELOW_QUERY,
+        [COMMAND_MULTI_INGREDIENT_QUERY] = OPCODE_MULTI_INGREDIENT_QUERY,
+        [COMMAND_MULTI_POTION_QUERY] = OPCODE_MULTI_POTION_QUERY,
+        [COMMAND_MULTI_TROPHY_QUERY] = OPCODE_MULTI_TROPHY_QUERY,
+        [COMMAND_INGREDIENT_PREFIX_QUERY] = OPCODE_INGREDIENT_PREFIX_QUERY,
+        [COMMAND_POTION_PREFIX_QUERY] = OPCODE_POTION_PREFIX_QUERY,
+        [COMMAND_TROPHY_PREFIX_QUERY] = OPCODE_TROPHY_PREFIX_QUERY,
+        [COMMAND_MONSTER_PREFIX_QUERY] = OPCODE_MONSTER_PREFIX_QUERY,
+        [COMMAND_ENCOUNTER_BATCH] = OPCODE_ENCOUNTER_BATCH,
+        [COMMAND_MEMORY_QUERY] = OPCODE_MEMORY_QUERY,
+        [COMMAND_MEMORY_ALLOCATIONS_QUERY] = OPCODE_MEMORY_ALLOCATIONS_QUERY,
+    };
+
+    int frame_position = out->length;
+    append_u32(out, 0);
+    int opcode = opcodes[command->kind];
+    if (opcode == OPCODE_LEARN_POTION && command->is_sign)
+        opcode = OPCODE_LEARN_SIGN;
+    append_u8(out, opcode);
+
+    const char *name = command_text(command, command->name);
+    switch (opcode)
+    {
+    case OPCODE_TRADE:
+        append_u32(out, command->trophy_count);
+        for (int i = 0; i < command->trophy_count; i++)
+        {
+            append_u32(out, command->items[i].quantity);
+            append_name_field(out, command_text(command, command->items[i].name), strlen(command_text(command, command->items[i].name)));
+        }
+        append_u32(out, command->item_count - command->trophy_count);
+        for (int i = command->trophy_count; i < command->item_count; i++)
+        {
+            append_u32(out, command->items[i].quantity);
+            append_name_field(out, command_text(command, command->items[i].name), strlen(command_text(command, command->items[i].name)));
+        }
+        break;
+    case OPCODE_LEARN_FORMULA:
+        append_name_field(out, name, strlen(name));
+        // fall through
+    case OPCODE_LOOT:
+        append_u32(out, command->item_count);
+        for (int i = 0; i < command->item_count; i++)
+        {
+            append_u32(out, command->items[i].quantity);
+            append_name_field(out, command_text(command, command->items[i].name), strlen(command_text(command, command->items[i].name)));
+        }
+        break;
+    case OPCODE_BREW_BATCH:
+    case OPCODE_ENCOUNTER_BATCH:
+        append_u32(out, command->quantity);
+        append_name_field(out, name, strlen(name));
+        break;
+    case OPCODE_TOP_INGREDIENTS_QUERY:
+    case OPCODE_TOP_POTIONS_QUERY:
+    case OPCODE_TOP_TROPHIES_QUERY:
+    case OPCODE_INGREDIENTS_BELOW_QUERY:
+    case OPCODE_POTIONS_BELOW_QUERY:
+    case OPCODE_TROPHIES_BELOW_QUERY:
+        append_u32(out, command->quantity);
+        break;
+    case OPCODE_BREW_LIST:
+    case OPCODE_MULTI_INGREDIENT_QUERY:
+    case OPCODE_MULTI_POTION_QUERY:
+    case OPCODE_MULTI_TROPHY_QUERY:
+        append_u32(out, command->item_count);
+        for (int i = 0; i < command->item_count; i++)
+            append_name_field(out, command_text(command, command->items[i].name), strlen(command_text(command, command->items[i].name)));
+        break;
+    case OPCODE_LEARN_SIGN:
+    case OPCODE_LEARN_POTION:
+        append_name_field(out, name, strlen(name));
+        append_name_field(out, command_text(command, command->target), strlen(command_text(command, command->target)));
+        break;
+    case OPCODE_BREW:
+    case OPCODE_ENCOUNTER:
+    case OPCODE_INGREDIENT_QUERY:
+    case OPCODE_POTION_QUERY:
+    case OPCODE_TROPHY_QUERY:
+    case OPCODE_MONSTER_QUERY:
+    case OPCODE_POTION_FORMULA_QUERY:
+    case OPCODE_USES_QUERY:
+    case OPCODE_EFFECTIVE_AGAINST_QUERY:
+    case OPCODE_INGREDIENT_PREFIX_QUERY:
+    case OPCODE_POTION_PREFIX_QUERY:
+    case OPCODE_TROPHY_PREFIX_QUERY:
+    case OPCODE_MONSTER_PREFIX_QUERY:
+        append_name_field(out, name, strlen(name));
+        break;
+    default:
+        break;
+    }
+
+    uint32_t frame_length = out->length - frame_position - 4;
+    if (frame_length > BINARY_MAX_FRAME)
+    {
+        out->length = frame_position + 4;
+        append_u8(out, OPCODE_INVALID);
+        frame_length = 1;
+    }
+    for (int i = 0; i < 4; i++)
+        out->data[frame_position + i] = (frame_length >> (8 * i)) & 0xff;
+}
+
+int encode_text_session(FILE *input, FILE *output)
+{
+    /**
+        * Function Name: encode_text_session
+        *
+        * Purpose:
+        *    Converts a text session into the request frames of the binary protocol.
+        *
+        * Parameters:
+        *     FILE *input - The text session, one command per line.
+        *     FILE *output - The stream receiving one request frame per line.
+        *
+        * Return:
+        *     int - Always 0.
+        *
+        * Side Effects:
+        *     - Lines go through the parser only, no session state is used or changed.
+        */
+    OutputBuffer frames = {NULL, 0, 0};
+    while (read_command(input, &line_command, FALSE))
+    {
+        encode_command(&frames, &line_command);
+        if (frames.length >= 65536)
+        {
+            fwrite(frames.data, 1, frames.length, output);
+            frames.length = 0;
+        }
+    }
+    if (frames.length > 0)
+        fwrite(frames.data, 1, frames.length, output);
+    fflush(output);
+    free(frames.data);
+    command_free(&line_command);
+    line_parser_free();
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "globals.h"
+
+THREAD_LOCAL BrewIndex brew_index;
+
+const BrewIngredient *brew_index_find(const char *name)
+{
+    /**
+        * Function Name: brew_index_find
+        *
+        * Purpose:
+        *    Finds the entry of an ingredient in the calling thread's brew index.
+        *
+        * Parameters:
+        *     const char *name - The name of the ingredient.
+        *
+        * Return:
+        *     const BrewIngredient * - The entry, NULL if the ingredient was never in stock nor required by a learned formula.
+        */
+    const BrewIndex *index = &brew_index;
+    if (index->buckets == NULL)
+        return NULL;
+    for (BrewIngredient *entry = index->buckets[hash_name(name) & (index->bucket_count - 1)]; entry != NULL; entry = entry->next_in_bucket)
+        if (strcmp(entry->name, name) == 0)
+            return entry;
+    return NULL;
+}
+
+static BrewIngredient *find_or_add_ingredient(BrewIndex *index, const char *name)
+{
+    /**
+        * Function Name: find_or_add_ingredient
+        *
+        * Purpose:
+        *    Finds the entry of an ingredient, or adds one that is not in stock and required by nothing yet.
+        *
+        * Parameters:
+        *     BrewIndex *index - The index.
+        *     const char *name - The name of the ingredient.
+        *
+        * Return:
+        *     BrewIngredient * - The entry.
+        *
+        * Side Effects:
+        *     - A new entry is linked to the knowledge base formulas requiring the ingredient.
+        *     - Allocates the buckets on first use, then doubles them and rehashes the entries when they are full.
+        */
+    BrewIngredient *found = (BrewIngredient *)brew_index_find(name);
+    if (found != NULL)
+        return found;
+
+    if (index->buckets == NULL || index->entry_count >= index->bucket_count)
+    {
+        int bucket_count = index->buckets == NULL ? 64 : index->bucket_count * 2;
+        BrewIngredient **buckets = mem_calloc(MEM_BREW_INDEX, bucket_count, sizeof(BrewIngredient *));
+        for (int i = 0; i < index->bucket_count; i++)
+        {
+            BrewIngredient *entry = index->buckets[i];
+            while (entry != NULL)
+            {
+                BrewIngredient *next = entry->next_in_bucket;
+                BrewIngredient **bucket = &buckets[hash_name(entry->name) & (bucket_count - 1)];
+                entry->next_in_bucket = *bucket;
+                *bucket = entry;
+                entry = next;
+            }
+        }
+        mem_free(MEM_BREW_INDEX, index->buckets, index->bucket_count * sizeof(BrewIngredient *));
+        index->buckets = buckets;
+        index->bucket_count = bucket_count;
+    }
+
+    BrewIngredient *entry = mem_calloc(MEM_BREW_INDEX, 1, sizeof(BrewIngredient));
+    entry->name = name_pool_intern(name);
+    entry->kb_requirements = kb_find_requirements(name, &entry->kb_requirement_count);
+    BrewIngredient **bucket = &index->buckets[hash_name(name) & (index->bucket_count - 1)];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    index->entry_count++;
+    return entry;
+}
+
+static FormulaProgress *formula_progress(BrewIndex *index, int formula, int *ingredient_count)
+{
+    /**
+        * Function Name: formula_progress
+        *
+        * Purpose:
+        *    Returns the satisfied requirement counter of a formula.
+        *
+        * Parameters:
+        *     BrewIndex *index - The index.
+        *     int formula - The formula, a session index or BREW_KB_FORMULA(k) for a knowledge base formula.
+        *     int *ingredient_count - Receives the number of requirements of the formula.
+        *
+        * Return:
+        *     FormulaProgress * - The counter.
+        *
+        * Side Effects:
+        *     - The counters of the knowledge base formulas are allocated on first use.
+        */
+    if (formula >= 0)
+    {
+        *ingredient_count = formulas[formula].ingredient_count;
+        return &index->progress[formula];
+    }
+    if (index->kb_progress == NULL)
+        index->kb_progress = mem_calloc(MEM_BREW_INDEX, knowledge_base->formula_count, sizeof(FormulaProgress));
+    *ingredient_count = knowledge_base->formulas[BREW_KB_FORMULA(formula)].ingredient_count;
+    return &index->kb_progress[BREW_KB_FORMULA(formula)];
+}
+
+static void update_progress(BrewIndex *index, int formula, int delta)
+{
+    /**
+        * Function Name: update_progress
+        *
+        * Purpose:
+        *    Counts requirements of a formula becoming met or unmet, and keeps the brewable list in step.
+        *
+        * Parameters:
+        *     BrewIndex *index - The index.
+        *     int formula - The formula, a session index or BREW_KB_FORMULA(k).
+        *     int delta - 1 if a requirement became met, -1 if it is no longer met, 0 to only check the counter.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - A formula enters the brewable list when all its requirements are met and leaves it in constant time,
+        *       the last formula of the list taking its place.
+        */
+    int ingredient_count;
+    FormulaProgress *progress = formula_progress(index, formula, &ingredient_count);
+    progress->satisfied += delta;
+    Bool brewable = progress->satisfied == ingredient_count;
+
+    if (brewable && progress->brewable_position == 0)
+    {
+        if (index->brewable_count >= index->brewable_capacity)
+        {
+            int capacity = index->brewable_capacity == 0 ? 16 : index->brewable_capacity * 2;
+            index->brewable = mem_realloc(MEM_BREW_INDEX, index->brewable, index->brewable_capacity * sizeof(int), capacity * sizeof(int));
+            index->brewable_capacity = capacity;
+        }
+        index->brewable[index->brewable_count++] = formula;
+        progress->brewable_position = index->brewable_count;
+    }
+    else if (!brewable && progress->brewable_position != 0)
+    {
+        int position = progress->brewable_position - 1;
+        int last = index->brewable[--index->brewable_count];
+        index->brewable[position] = last;
+        formula_progress(index, last, &ingredient_count)->brewable_position = position + 1;
+        progress->brewable_position = 0;
+    }
+}
+
+static int first_requirement_above(const void *requirements, size_t size, int count, int quantity)
+{
+    /**
+        * Function Name: first_requirement_above
+        *
+        * Purpose:
+        *    Binary searches a requirement list ordered by required quantity.
+        *
+        * Parameters:
+        *     const void *requirements - The list, of Requirement or KbRequirement.
+        *     size_t size - The size of one requirement, whose required quantity is its first member.
+        *     int count - The number of requirements.
+        *     int quantity - The quantity searched for.
+        *
+        * Return:
+        *     int - The position of the first requirement needing more than quantity, count if there is none.
+        */
+    int low = 0;
+    int high = count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (*(const int *)((const char *)requirements + middle * size) > quantity)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+void brew_index_ingredient_changed(const char *name, int quantity)
+{
+    /**
+        * Function Name: brew_index_ingredient_changed
+        *
+        * Purpose:
+        *    Tells the brew index the new quantity of an ingredient of the inventory.
+        *
+        * Parameters:
+        *     const char *name - The name of the ingredient.
+        *     int quantity - Its quantity after the change.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Only the requirements whose quantity lies between the old and the new quantity change state,
+        *       they are found by binary search in the ingredient's lists, which are ordered by required quantity.
+        *     - Must be called by every LOOT, TRADE and BREW change of the inventory, after the change.
+        */
+    BrewIndex *index = &brew_index;
+    BrewIngredient *entry = find_or_add_ingredient(index, name);
+
+    //a requirement is met when the ingredient is in the inventory with at least the quantity required
+    int low = entry->in_stock ? entry->quantity : INT_MIN;
+    int high = quantity;
+    int delta = 1;
+    if (high < low)
+    {
+        low = quantity;
+        high = entry->quantity;
+        delta = -1;
+    }
+    entry->in_stock = TRUE;
+    entry->quantity = quantity;
+    if (low == high)
+        return;
+
+    int from = low == INT_MIN ? 0 : first_requirement_above(entry->requirements, sizeof(Requirement), entry->requirement_count, low);
+    for (int i = from; i < entry->requirement_count && entry->requirements[i].required <= high; i++)
+        update_progress(index, entry->requirements[i].formula, delta);
+
+    from = low == INT_MIN ? 0 : first_requirement_above(entry->kb_requirements, sizeof(KbRequirement), entry->kb_requirement_count, low);
+    for (int i = from; i < entry->kb_requirement_count && entry->kb_requirements[i].required <= high; i++)
+        update_progress(index, BREW_KB_FORMULA(entry->kb_requirements[i].formula), delta);
+}
+
+void brew_index_formula_learned(int formula)
+{
+    /**
+        * Function Name: brew_index_formula_learned
+        *
+        * Purpose:
+        *    Adds a formula the session just learned to the brew index.
+        *
+        * Parameters:
+        *     int formula - The index of the formula in the session's formulas.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Files every requirement of the formula under its ingredient, in required quantity order,
+        *       and counts those the inventory already meets.
+        */
+    BrewIndex *index = &brew_index;
+    if (formula >= index->progress_capacity)
+    {
+        int capacity = index->progress_capacity == 0 ? 16 : index->progress_capacity;
+        while (formula >= capacity)
+            capacity *= 2;
+        index->progress = mem_realloc(MEM_BREW_INDEX, index->progress, index->progress_capacity * sizeof(FormulaProgress),
+                                      capacity * sizeof(FormulaProgress));
+        memset(index->progress + index->progress_capacity, 0, (capacity - index->progress_capacity) * sizeof(FormulaProgress));
+        index->progress_capacity = capacity;
+    }
+
+    const PotionFormula *learned = &formulas[formula];
+    int satisfied = 0;
+    for (int i = 0; i < learned->ingredient_count; i++)
+    {
+        BrewIngredient *entry = find_or_add_ingredient(index, learned->ingredients[i].name);
+        if (entry->requirement_count >= entry->requirement_capacity)
+        {
+            int capacity = entry->requirement_capacity == 0 ? 4 : entry->requirement_capacity * 2;
+            entry->requirements = mem_realloc(MEM_BREW_INDEX, entry->requirements, entry->requirement_capacity * sizeof(Requirement),
+                                              capacity * sizeof(Requirement));
+            entry->requirement_capacity = capacity;
+        }
+        int required = learned->ingredients[i].quantity;
+        int position = first_requirement_above(entry->requirements, sizeof(Requirement), entry->requirement_count, required);
+        memmove(&entry->requirements[position + 1], &entry->requirements[position], (entry->requirement_count - position) * sizeof(Requirement));
+        entry->requirements[position].required = required;
+        entry->requirements[position].formula = formula;
+        entry->requirement_count++;
+
+        if (entry->in_stock && entry->quantity >= required)
+            satisfied++;
+    }
+    index->progress[formula].satisfied = 0;
+    index->progress[formula].brewable_position = 0;
+    update_progress(index, formula, satisfied);
+}
+
+int brew_index_collect(Potion *brewable)
+{
+    /**
+        * Function Name: brew_index_collect
+        *
+        * Purpose:
+        *    Copies the names of the potions the inventory is enough for right now.
+        *
+        * Parameters:
+        *     Potion *brewable - Receives one potion per brewable formula, room for brew_index.brewable_count of them.
+        *
+        * Return:
+        *     int - The number of potions copied, in no particular order and with a quantity of 0.
+        *
+        * Side Effects:
+        *     - Reads the brewable list only, no formula or ingredient is scanned.
+        */
+    const BrewIndex *index = &brew_index;
+    for (int i = 0; i < index->brewable_count; i++)
+    {
+        int formula = index->brewable[i];
+        brewable[i].name = formula >= 0 ? formulas[formula].name : kb_name(knowledge_base->formulas[BREW_KB_FORMULA(formula)].name);
+        brewable[i].quantity = 0;
+    }
+    return index->brewable_count;
+}
+
+void brew_index_free()
+{
+    /**
+        * Function Name: brew_index_free
+        *
+        * Purpose:
+        *    Releases the calling thread's brew index.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The next session on the thread starts with an empty index.
+        */
+    BrewIndex *index = &brew_index;
+    for (int i = 0; i < index->bucket_count; i++)
+    {
+        BrewIngredient *entry = index->buckets[i];
+        while (entry != NULL)
+        {
+            BrewIngredient *next = entry->next_in_bucket;
+            mem_free(MEM_BREW_INDEX, entry->requirements, entry->requirement_capacity * sizeof(Requirement));
+            mem_free(MEM_BREW_INDEX, entry, sizeof(BrewIngredient));
+            entry = next;
+        }
+    }
+    mem_free(MEM_BREW_INDEX, index->buckets, index->bucket_count * sizeof(BrewIngredient *));
+    mem_free(MEM_BREW_INDEX, index->progress, index->progress_capacity * sizeof(FormulaProgress));
+    if (index->kb_progress != NULL)
+        mem_free(MEM_BREW_INDEX, index->kb_progress, knowledge_base->formula_count * sizeof(FormulaProgress));
+    mem_free(MEM_BREW_INDEX, index->brewable, index->brewable_capacity * sizeof(int));
+    memset(index, 0, sizeof(BrewIndex));
+}
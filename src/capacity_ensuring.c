@@ -22,8 +22,8 @@ void ensure_ingredient_capacity() {
      *     - Updates the global variable ingredient_capacity to reflect the new capacity.
      */
     if (last_added_ingredient_index + 1 >= ingredient_capacity) {
+        ingredients = mem_realloc(MEM_INVENTORY, ingredients, ingredient_capacity * sizeof(Ingredient), 2 * ingredient_capacity * sizeof(Ingredient));
         ingredient_capacity *= 2;
-        ingredients = realloc(ingredients, ingredient_capacity * sizeof(Ingredient));
     }
 }
 
@@ -46,8 +46,8 @@ void ensure_potion_capacity() {
      *     - Updates the global variable potion_capacity to reflect the new capacity.
      */
     if (last_added_potion_index + 1 >= potion_capacity) {
+        potions = mem_realloc(MEM_POTIONS, potions, potion_capacity * sizeof(Potion), 2 * potion_capacity * sizeof(Potion));
         potion_capacity *= 2;
-        potions = realloc(potions, potion_capacity * sizeof(Potion));
     }
 }
 
@@ -70,8 +70,8 @@ void ensure_trophy_capacity() {
      *     - Updates the global variable trophy_capacity to reflect the new capacity.
      */
     if (last_added_trophy_index + 1 >= trophy_capacity) {
+        trophies = mem_realloc(MEM_TROPHIES, trophies, trophy_capacity * sizeof(Trophy), 2 * trophy_capacity * sizeof(Trophy));
         trophy_capacity *= 2;
-        trophies = realloc(trophies, trophy_capacity * sizeof(Trophy));
     }
 }
 
@@ -94,8 +94,8 @@ void ensure_monster_capacity() {
      *     - Updates the global variable monster_capacity to reflect the new capacity.
      */
     if (last_added_monster_index + 1 >= monster_capacity) {
+        monsters = mem_realloc(MEM_BESTIARY, monsters, monster_capacity * sizeof(Monster), 2 * monster_capacity * sizeof(Monster));
         monster_capacity *= 2;
-        monsters = realloc(monsters, monster_capacity * sizeof(Monster));
     }
 }
 
@@ -118,8 +118,8 @@ void ensure_formula_capacity() {
      *     - Updates the global variable formula_capacity to reflect the new capacity.
      */
     if (last_added_formula_index + 1 >= formula_capacity) {
+        formulas = mem_realloc(MEM_FORMULAS, formulas, formula_capacity * sizeof(PotionFormula), 2 * formula_capacity * sizeof(PotionFormula));
         formula_capacity *= 2;
-        formulas = realloc(formulas, formula_capacity * sizeof(PotionFormula));
     }
 }
 
@@ -142,8 +142,8 @@ void ensure_sign_capacity() {
      *     - Updates the global variable sign_capacity to reflect the new capacity.
      */
     if (last_added_sign_index + 1 >= sign_capacity) {
+        signs = mem_realloc(MEM_BESTIARY, signs, sign_capacity * sizeof(Sign), 2 * sign_capacity * sizeof(Sign));
         sign_capacity *= 2;
-        signs = realloc(signs, sign_capacity * sizeof(Sign));
     }
 }
 
@@ -166,8 +166,8 @@ void ensure_monster_sign_capacity(Monster *m) {
      *     - Updates the global variable sign_capacity to reflect the new capacity.
      */
     if (m->sign_count >= m->sign_capacity) {
+        m->signs = mem_realloc(MEM_BESTIARY, m->signs, m->sign_capacity * sizeof(Sign), 2 * m->sign_capacity * sizeof(Sign));
         m->sign_capacity *= 2;
-        m->signs = realloc(m->signs, m->sign_capacity * sizeof(Sign));
     }
 }
 
@@ -190,7 +190,7 @@ void ensure_monster_potion_capacity(Monster *m) {
      *     - Updates the global variable potion_capacity to reflect the new capacity.
     */
     if (m->potion_count >= m->potion_capacity) {
+        m->potions = mem_realloc(MEM_BESTIARY, m->potions, m->potion_capacity * sizeof(Potion), 2 * m->potion_capacity * sizeof(Potion));
         m->potion_capacity *= 2;
-        m->potions = realloc(m->potions, m->potion_capacity * sizeof(Potion));
     }
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+void command_reset(Command *command)
+{
+    /**
+        * Function Name: command_reset
+        *
+        * Purpose:
+        *    Empties a command so that it can be filled again.
+        *
+        * Parameters:
+        *     Command *command - The command to be emptied.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Keeps the allocated item and text buffers, so a reused command does not allocate again.
+        */
+    command->kind = COMMAND_INVALID;
+    command->name = 0;
+    command->target = 0;
+    command->is_sign = FALSE;
+    command->quantity = 0;
+    command->item_count = 0;
+    command->trophy_count = 0;
+    command->text_length = 0;
+}
+
+void command_free(Command *command)
+{
+    /**
+        * Function Name: command_free
+        *
+        * Purpose:
+        *    Releases the buffers of a command.
+        *
+        * Parameters:
+        *     Command *command - The command to be released.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Frees the item and text buffers and resets the command to an empty one.
+        */
+    free(command->items);
+    free(command->text);
+    command->items = NULL;
+    command->item_capacity = 0;
+    command->text = NULL;
+    command->text_capacity = 0;
+    command_reset(command);
+}
+
+const char *command_text(const Command *command, int offset)
+{
+    /**
+        * Function Name: command_text
+        *
+        * Purpose:
+        *    Returns a name stored in a command.
+        *
+        * Parameters:
+        *     const Command *command - The command holding the name.
+        *     int offset - The offset of the name, as stored in the command's fields.
+        *
+        * Return:
+        *     const char * - The null terminated name, valid until the command is changed.
+        */
+    return command->text + offset;
+}
+
+static void ensure_command_text_capacity(Command *command, int length)
+{
+    /**
+        * Function Name: ensure_command_text_capacity
+        *
+        * Purpose:
+        *    Ensures that the text buffer of a command can take length more characters.
+        *
+        * Parameters:
+        *     Command *command - The command whose buffer needs to be checked.
+        *     int length - The number of characters to be appended.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Doubles the capacity of the text buffer until it is large enough.
+        */
+    if (command->text_capacity == 0)
+    {
+        command->text_capacity = 256;
+        command->text = malloc(command->text_capacity);
+    }
+    while (command->text_length + length >= command->text_capacity)
+    {
+        command->text_capacity *= 2;
+        command->text = realloc(command->text, command->text_capacity);
+    }
+}
+
+int command_add_text(Command *command, const char *text)
+{
+    /**
+        * Function Name: command_add_text
+        *
+        * Purpose:
+        *    Stores a name in a command.
+        *
+        * Parameters:
+        *     Command *command - The command that stores the name.
+        *     const char *text - The name to be stored.
+        *
+        * Return:
+        *     int - The offset of the stored name.
+        *
+        * Side Effects:
+        *     - Appends the name and its terminator to the command's text buffer.
+        */
+    return command_add_chars(command, text, strlen(text));
+}
+
+int command_add_chars(Command *command, const char *chars, int length)
+{
+    /**
+        * Function Name: command_add_chars
+        *
+        * Purpose:
+        *    Stores a name given by its characters in a command.
+        *
+        * Parameters:
+        *     Command *command - The command that stores the name.
+        *     const char *chars - The characters of the name, not null terminated.
+        *     int length - The number of characters.
+        *
+        * Return:
+        *     int - The offset of the stored name.
+        *
+        * Side Effects:
+        *     - Appends the characters and a terminator to the command's text buffer.
+        */
+    ensure_command_text_capacity(command, length + 1);
+    int offset = command->text_length;
+    memcpy(command->text + offset, chars, length);
+    command->text[offset + length] = '\0';
+    command->text_length += length + 1;
+    return offset;
+}
+
+int command_add_words(Command *command, const char *text, const int *word_starts, int from, int to)
+{
+    /**
+        * Function Name: command_add_words
+        *
+        * Purpose:
+        *    Stores a multi-word name in a command, the words joined by single spaces.
+        *
+        * Parameters:
+        *     Command *command - The command that stores the name.
+        *     const char *text - The words of the input line, each followed by its terminator.
+        *     const int *word_starts - The offset of every word in text.
+        *     int from - The index of the first word of the name.
+        *     int to - The index after the last word of the name.
+        *
+        * Return:
+        *     int - The offset of the stored name.
+        *
+        * Side Effects:
+        *     - Appends the name and its terminator to the command's text buffer.
+        */
+    int offset = command->text_length;
+    for (int i = from; i < to; i++)
+    {
+        int length = strlen(text + word_starts[i]);
+        ensure_command_text_capacity(command, length + 1);
+        memcpy(command->text + command->text_length, text + word_starts[i], length);
+        command->text_length += length;
+        if (i < to - 1)
+            command->text[command->text_length++] = ' ';
+    }
+    ensure_command_text_capacity(command, 1);
+    command->text[command->text_length++] = '\0';
+    return offset;
+}
+
+void command_add_stored_item(Command *command, int name, int quantity)
+{
+    /**
+        * Function Name: command_add_stored_item
+        *
+        * Purpose:
+        *    Appends a quantity and a name already stored in a command to its item list.
+        *
+        * Parameters:
+        *     Command *command - The command that receives the item.
+        *     int name - The offset of the name in the command's text.
+        *     int quantity - Its quantity.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Doubles the capacity of the item list if it is full.
+        */
+    if (command->item_count >= command->item_capacity)
+    {
+        command->item_capacity = command->item_capacity == 0 ? 16 : command->item_capacity * 2;
+        command->items = realloc(command->items, command->item_capacity * sizeof(CommandItem));
+    }
+    command->items[command->item_count].name = name;
+    command->items[command->item_count].quantity = quantity;
+    command->item_count++;
+}
+
+void command_add_item(Command *command, const char *name, int quantity)
+{
+    /**
+        * Function Name: command_add_item
+        *
+        * Purpose:
+        *    Appends a quantity and a name to the item list of a command.
+        *
+        * Parameters:
+        *     Command *command - The command that receives the item.
+        *     const char *name - The name of the ingredient or trophy.
+        *     int quantity - Its quantity.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Doubles the capacity of the item list if it is full.
+        */
+    command_add_stored_item(command, command_add_text(command, name), quantity);
+}
+
+void command_add_item_words(Command *command, const char *text, const int *word_starts, int from, int to, int quantity)
+{
+    /**
+        * Function Name: command_add_item_words
+        *
+        * Purpose:
+        *    Appends a quantity and a multi-word name to the item list of a command, the words joined by single spaces.
+        *
+        * Parameters:
+        *     Command *command - The command that receives the item.
+        *     const char *text - The words of the input line, each followed by its terminator.
+        *     const int *word_starts - The offset of every word in text.
+        *     int from - The index of the first word of the name.
+        *     int to - The index after the last word of the name.
+        *     int quantity - Its quantity.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The name is joined straight into the command's text, whatever its length.
+        */
+    command_add_stored_item(command, command_add_words(command, text, word_starts, from, to), quantity);
+}
+
+void command_copy(Command *command, const Command *source)
+{
+    /**
+        * Function Name: command_copy
+        *
+        * Purpose:
+        *    Makes a command an exact copy of another one.
+        *
+        * Parameters:
+        *     Command *command - The command to be overwritten.
+        *     const Command *source - The command to be copied.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Copies the items and names into the command's own buffers, growing them if needed.
+        */
+    command_reset(command);
+    command->kind = source->kind;
+    command->name = source->name;
+    command->target = source->target;
+    command->is_sign = source->is_sign;
+    command->quantity = source->quantity;
+    command->trophy_count = source->trophy_count;
+
+    if (source->item_count > command->item_capacity)
+    {
+        while (source->item_count > command->item_capacity)
+            command->item_capacity = command->item_capacity == 0 ? 16 : command->item_capacity * 2;
+        command->items = realloc(command->items, command->item_capacity * sizeof(CommandItem));
+    }
+    if (source->item_count > 0)
+        memcpy(command->items, source->items, source->item_count * sizeof(CommandItem));
+    command->item_count = source->item_count;
+
+    ensure_command_text_capacity(command, source->text_length);
+    if (source->text_length > 0)
+        memcpy(command->text, source->text, source->text_length);
+    command->text_length = source->text_length;
+}
+
+void parse_line(const char *line, Command *command)
+{
+    /**
+        * Function Name: parse_line
+        *
+        * Purpose:
+        *    Turns a line of input into a validated command.
+        *
+        * Parameters:
+        *     const char *line - The line of input to be parsed, with or without its newline.
+        *     Command *command - Receives the parsed command, its previous content is discarded.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Does not read or modify any session state, so lines can be parsed on any thread ahead of execution.
+        *     - The line is fed to the calling thread's line parser as a single chunk, the same path as the
+        *       chunks of a line too long to be read at once.
+        *     - Invalid lines give a COMMAND_INVALID command.
+        */
+    line_parser_begin();
+    line_parser_feed(line, strlen(line));
+    line_parser_finish(command);
+}
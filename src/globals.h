@@ -1,8 +1,16 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <sys/types.h>
+
 #define MAX_LINE_LENGTH 1024
-#define MAX_WORD_LEN 64
+
+// every session keeps its own tables, so independent sessions can run on separate threads
+#define THREAD_LOCAL _Thread_local
 
 //necessary type definitions
 typedef enum
@@ -11,55 +19,28 @@ typedef enum
     TRUE = 1
 } Bool;
 
-typedef enum
-{
-    SENTENCE,
-    QUESTION,
-    EXIT
-} LineType;
-
-typedef enum
-{
-    LOOT,
-    TRADE,
-    BREW,
-    LEARN,
-    ENCOUNTER,
-} Sentence;
-
-typedef enum
-{
-    INGREDIENT,
-    POTION,
-    TROPHY,
-    ALL_INGREDIENTS,
-    ALL_POTIONS,
-    ALL_TROPHIES,
-    MONSTER,
-    POTION_FORMULA,
-} Question;
-
+// names of any length are stored once in the session's name pool, the tables only point at them
 typedef struct
 {
-    char name[MAX_WORD_LEN];
+    const char *name;
     int quantity;
 } Ingredient;
 
 typedef struct
 {
-    char name[MAX_WORD_LEN];
+    const char *name;
     int quantity;
 } Potion;
 
 typedef struct
 {
-    char name[MAX_WORD_LEN];
+    const char *name;
     int quantity;
 } Sign;
 
 typedef struct
 {
-    char name[MAX_WORD_LEN];
+    const char *name;
     Sign *signs;
     int sign_count;
     int sign_capacity;
@@ -71,85 +52,803 @@ typedef struct
 
 typedef struct
 {
-    char name[MAX_WORD_LEN];
+    const char *name;
     int quantity;
 } Trophy;
 
 typedef struct
 {
-    char name[MAX_WORD_LEN];
+    const char *name;
     Ingredient *ingredients;
     int ingredient_count;
     int ingredient_capacity;
 } PotionFormula;
 
+typedef struct
+{
+    char name[256];
+    off_t size;
+} ReplayFile;
+
+typedef enum
+{
+    COMMAND_INVALID,
+    COMMAND_EXIT,
+    COMMAND_LOOT,
+    COMMAND_TRADE,
+    COMMAND_BREW,
+    COMMAND_BREW_BATCH,
+    COMMAND_BREW_LIST,
+    COMMAND_LEARN_FORMULA,
+    COMMAND_LEARN_EFFECTIVENESS,
+    COMMAND_ENCOUNTER,
+    COMMAND_ENCOUNTER_BATCH,
+    COMMAND_MEMORY_QUERY, // a question about the session's own allocations, answered where the commands run
+    COMMAND_MEMORY_ALLOCATIONS_QUERY,
+    // questions only read the tables and must stay last
+    COMMAND_INGREDIENT_QUERY,
+    COMMAND_POTION_QUERY,
+    COMMAND_TROPHY_QUERY,
+    COMMAND_ALL_INGREDIENTS_QUERY,
+    COMMAND_ALL_POTIONS_QUERY,
+    COMMAND_ALL_TROPHIES_QUERY,
+    COMMAND_MONSTER_QUERY,
+    COMMAND_POTION_FORMULA_QUERY,
+    COMMAND_BREWABLE_QUERY,
+    COMMAND_USES_QUERY,
+    COMMAND_EFFECTIVE_AGAINST_QUERY,
+    COMMAND_TOP_INGREDIENTS_QUERY,
+    COMMAND_TOP_POTIONS_QUERY,
+    COMMAND_TOP_TROPHIES_QUERY,
+    COMMAND_INGREDIENTS_BELOW_QUERY,
+    COMMAND_POTIONS_BELOW_QUERY,
+    COMMAND_TROPHIES_BELOW_QUERY,
+    COMMAND_MULTI_INGREDIENT_QUERY,
+    COMMAND_MULTI_POTION_QUERY,
+    COMMAND_MULTI_TROPHY_QUERY,
+    COMMAND_INGREDIENT_PREFIX_QUERY,
+    COMMAND_POTION_PREFIX_QUERY,
+    COMMAND_TROPHY_PREFIX_QUERY,
+    COMMAND_MONSTER_PREFIX_QUERY,
+} CommandKind;
+
+typedef struct
+{
+    int name; // offset of the name in the command's text
+    int quantity;
+} CommandItem;
+
+// opcodes of the binary protocol, the first byte of a request frame
+// a frame is a 32-bit little-endian payload length followed by the payload
+// names are a 32-bit length and their bytes, quantities are 32-bit, item lists a 32-bit count of quantity and name
+typedef enum
+{
+    OPCODE_INVALID,                // always answered with RESPONSE_INVALID
+    OPCODE_EXIT,                   // ends the session, no response
+    OPCODE_LOOT,                   // ingredient list
+    OPCODE_TRADE,                  // trophy list, ingredient list
+    OPCODE_BREW,                   // potion
+    OPCODE_LEARN_FORMULA,          // potion, ingredient list
+    OPCODE_LEARN_SIGN,             // sign, monster
+    OPCODE_LEARN_POTION,           // potion, monster
+    OPCODE_ENCOUNTER,              // monster
+    OPCODE_INGREDIENT_QUERY,       // ingredient
+    OPCODE_POTION_QUERY,           // potion
+    OPCODE_TROPHY_QUERY,           // trophy
+    OPCODE_ALL_INGREDIENTS_QUERY,
+    OPCODE_ALL_POTIONS_QUERY,
+    OPCODE_ALL_TROPHIES_QUERY,
+    OPCODE_MONSTER_QUERY,          // monster
+    OPCODE_POTION_FORMULA_QUERY,   // potion
+    OPCODE_BREW_BATCH,             // count (0 for as many as possible), potion
+    OPCODE_BREW_LIST,              // potion list, answered with one response per potion
+    OPCODE_BREWABLE_QUERY,
+    OPCODE_USES_QUERY,             // ingredient
+    OPCODE_EFFECTIVE_AGAINST_QUERY, // sign or potion
+    OPCODE_TOP_INGREDIENTS_QUERY,  // count
+    OPCODE_TOP_POTIONS_QUERY,      // count
+    OPCODE_TOP_TROPHIES_QUERY,     // count
+    OPCODE_INGREDIENTS_BELOW_QUERY, // quantity
+    OPCODE_POTIONS_BELOW_QUERY,    // quantity
+    OPCODE_TROPHIES_BELOW_QUERY,   // quantity
+    OPCODE_MULTI_INGREDIENT_QUERY, // ingredient list, 32-bit count and names
+    OPCODE_MULTI_POTION_QUERY,     // potion list
+    OPCODE_MULTI_TROPHY_QUERY,     // trophy list
+    OPCODE_INGREDIENT_PREFIX_QUERY, // name pattern, a word ending with '*'
+    OPCODE_POTION_PREFIX_QUERY,    // name pattern, words the last of which ends with '*'
+    OPCODE_TROPHY_PREFIX_QUERY,    // name pattern
+    OPCODE_MONSTER_PREFIX_QUERY,   // name pattern
+    OPCODE_ENCOUNTER_BATCH,        // count, monster
+    OPCODE_MEMORY_QUERY,
+    OPCODE_MEMORY_ALLOCATIONS_QUERY,
+} BinaryOpcode;
+
+// codes of the binary responses, the first byte of a response frame, each mirrors one text answer
+typedef enum
+{
+    RESPONSE_INVALID,
+    RESPONSE_INGREDIENTS_OBTAINED,
+    RESPONSE_NOT_ENOUGH_TROPHIES,
+    RESPONSE_TRADE_SUCCESSFUL,
+    RESPONSE_NO_FORMULA,            // potion
+    RESPONSE_NOT_ENOUGH_INGREDIENTS,
+    RESPONSE_POTION_BREWED,         // potion
+    RESPONSE_FORMULA_KNOWN,
+    RESPONSE_FORMULA_LEARNED,       // potion
+    RESPONSE_EFFECTIVENESS_KNOWN,
+    RESPONSE_BESTIARY_UPDATED,      // monster
+    RESPONSE_BESTIARY_ADDED,        // monster
+    RESPONSE_UNPREPARED,
+    RESPONSE_MONSTER_DEFEATED,      // monster
+    RESPONSE_NO_KNOWLEDGE,          // monster
+    RESPONSE_QUANTITY,              // signed 32-bit quantity
+    RESPONSE_NONE,
+    RESPONSE_ITEMS,                 // item list, for inventories and formulas
+    RESPONSE_NAMES,                 // 32-bit count of names, for the signs and potions effective against a monster
+    RESPONSE_POTIONS_BREWED,        // count, potion
+    RESPONSE_ENCOUNTERS,            // fights won, escapes, monster
+} BinaryResponse;
+
+// a parsed and validated line, executing it needs no more parsing
+// names are stored back to back in text and referenced by offset, so the buffers can grow and be reused
+typedef struct
+{
+    CommandKind kind;
+    int name;   // potion, monster, ingredient or trophy name, or the sign/potion learned as effective
+    int target; // the monster of a LEARN effectiveness sentence
+    Bool is_sign;
+    int quantity; // the count of a BREW_BATCH, 0 for as many as possible, of an ENCOUNTER_BATCH, or of a top or below question
+
+    CommandItem *items; // quantities and names of LOOT, TRADE and formula lists, names of brew lists and multi-gets
+    int item_count;
+    int item_capacity;
+    int trophy_count;   // for TRADE the first trophy_count items are the trophies given
+
+    char *text;
+    int text_length;
+    int text_capacity;
+} Command;
+
+// a line already parsed on this thread, with the command it gave
+// the items, the raw line and the names of the command live in the same allocation, right after the entry
+typedef struct ParseCacheEntry
+{
+    struct ParseCacheEntry *next_in_bucket;
+    struct ParseCacheEntry *newer;
+    struct ParseCacheEntry *older;
+    uint64_t hash;
+    size_t size; // bytes charged to the budget
+    int line_length;
+    char *line;
+    Command record;
+} ParseCacheEntry;
+
+// LRU cache of parsed commands keyed by the raw bytes of their lines, one per thread
+typedef struct
+{
+    ParseCacheEntry **buckets;
+    int bucket_count;
+    int entry_count;
+    ParseCacheEntry *newest;
+    ParseCacheEntry *oldest;
+    size_t bytes;
+    long hits;
+    long misses;
+    long evictions;
+} ParseCache;
+
+// a line split into words and matched against the grammar as its characters arrive, so it is never held whole
+// only the words are kept, not the spaces between them, and nothing once the line cannot match
+typedef struct
+{
+    char *text;                 // the words back to back, each followed by its terminator
+    int text_length;
+    int text_capacity;
+    int *word_starts;           // the offset of every word in text
+    int *spaces_before;         // the number of spaces right before every word
+    unsigned char *transitions; // the action set of the automaton transition every matched word took
+    int word_count;
+    int word_capacity;
+    int word_length;  // characters of the last word seen so far, -1 once it is ended by a space, a comma or a question mark
+    int spaces;       // spaces read since the last word
+    int last_solid;   // the word holding the last character that is neither a space nor a tab, -1 if there is none yet
+    int solid_length; // the characters of that word up to that character, the tabs after it are trimmed at the end of the line
+    int matched;      // the words already run through the automaton
+    int state;        // the automaton state after them, 0 once no rule can match the line
+    int type;         // the first "sign" or "potion" after the verb, -1 if none
+} LineParser;
+
+#define PARSE_CACHE_DEFAULT_BUDGET (1 << 20)
+
+// bounded lock-free ring between exactly one producer thread and one consumer thread
+// slots are filled and read in place, so whatever buffers a slot owns are reused
+typedef struct
+{
+    char *slots;
+    size_t slot_size;
+    size_t mask;
+    _Alignas(64) atomic_size_t head; // slots published so far, only the producer stores it
+    _Alignas(64) atomic_size_t tail; // slots released so far, only the consumer stores it
+} SpscRing;
+
+// growable buffer that collects the responses of a session instead of its output stream
+typedef struct
+{
+    char *data;
+    int length;
+    int capacity;
+} OutputBuffer;
+
+// the tables a snapshot is made of, a dirty mask has bit 1 << table set for each table changed
+typedef enum
+{
+    SNAPSHOT_INGREDIENTS,
+    SNAPSHOT_POTIONS,
+    SNAPSHOT_TROPHIES,
+    SNAPSHOT_FORMULAS,
+    SNAPSHOT_MONSTERS,
+    SNAPSHOT_BREWABLE, // the names of the potions the inventory is enough for
+    SNAPSHOT_USES,     // the reverse postings from ingredient to formula
+    SNAPSHOT_EFFECTIVE, // the reverse postings from sign or potion to monster
+    SNAPSHOT_RANKED_INGREDIENTS, // the ingredients, potions and trophies in stock in rank index order
+    SNAPSHOT_RANKED_POTIONS,
+    SNAPSHOT_RANKED_TROPHIES,
+    SNAPSHOT_TABLE_COUNT
+} SnapshotTable;
+
+// a name and one of the names filed under it, the reverse postings of a snapshot are sorted pairs
+typedef struct
+{
+    const char *name;
+    const char *owner;
+} Posting;
+
+// one immutable version of a table, the items and everything they point to live in the same block
+typedef struct
+{
+    int count;
+    void *items;
+} TableVersion;
+
+// a consistent view of a session, tables unchanged since the previous version are shared with it
+typedef struct
+{
+    long version;
+    TableVersion *tables[SNAPSHOT_TABLE_COUNT];
+} Snapshot;
+
+// a snapshot or table version that is no longer current, freed once no reader can hold it
+typedef struct
+{
+    void *block;
+    long epoch;
+} RetiredBlock;
+
+// versioned copy-on-write storage of a session, published by one writer and read by any number of threads
+typedef struct
+{
+    _Atomic(Snapshot *) current;
+    RetiredBlock *retired; // only touched by the writer
+    int retired_count;
+    int retired_capacity;
+} SnapshotStore;
+
+// names front coded in blocks, each block its first name in full and the others as what they add to the name
+// before them, so a sorted list sharing long prefixes takes a fraction of its size
+#define NAME_DICT_BLOCK_NAMES 16
+#define NAME_DICT_BLOCK_COUNT(name_count) (((name_count) + NAME_DICT_BLOCK_NAMES - 1) / NAME_DICT_BLOCK_NAMES)
+
+// a sorted list of names, looked up by binary search over the first names of the blocks, then a scan of one block
+typedef struct
+{
+    const int *block_offsets; // where each block starts in the blocks
+    const char *blocks;
+    int name_count;
+    _Atomic(char *) *decoded; // the names of each block once decoded, back to back, NULL until first used
+} NameDict;
+
+// layout of a compiled knowledge base file: the header, then formulas and monsters sorted by name,
+// then the ingredients of every formula and the signs and potions of every monster, referenced by position,
+// the ingredients of a formula in decreasing quantity order, and the signs and the potions of a monster in name order,
+// then one requirement per formula ingredient, ordered by ingredient name then required quantity,
+// then one effect per monster sign and potion, ordered by sign or potion name then monster
+// every name is stored once in the name dictionary at the end of the file, its block offsets then its blocks,
+// and referenced by its number there, which follows name order
+#define KB_MAGIC "WTKB"
+#define KB_VERSION 7
+
+typedef struct
+{
+    char magic[4];
+    int version;
+    int formula_count;
+    int monster_count;
+    int ingredient_count;
+    int sign_count;
+    int potion_count;
+    int name_count;
+    int dictionary_length; // bytes of the blocks of the name dictionary
+} KbHeader;
+
+// an ingredient of a formula, or a sign or potion of a monster
+typedef struct
+{
+    int name; // number in the name dictionary
+    int quantity;
+} KbItem;
+
+// the records of the file are used in place once mapped
+typedef struct
+{
+    int name;
+    int first_ingredient;
+    int ingredient_count;
+} KbFormula;
+
+typedef struct
+{
+    int name;
+    int first_sign;
+    int sign_count;
+    int first_potion;
+    int potion_count;
+} KbMonster;
+
+// one requirement of a knowledge base formula on an ingredient, laid out like Requirement
+typedef struct
+{
+    int required;
+    int formula; // the position of the formula in the knowledge base
+    int ingredient; // number in the name dictionary
+} KbRequirement;
+
+// a sign or potion of a knowledge base monster, the reverse of its effectiveness lists
+typedef struct
+{
+    int name; // number in the name dictionary
+    int monster; // the position of the monster in the knowledge base
+} KbEffect;
+
+// a knowledge base mapped read-only, its records and names shared by every thread and by every process
+// mapping the same file
+typedef struct
+{
+    const KbFormula *formulas;
+    const KbMonster *monsters;
+    const KbItem *ingredients;
+    const KbItem *signs;
+    const KbItem *potions;
+    int formula_count;
+    int monster_count;
+    NameDict names;
+    _Atomic(Ingredient *) *decoded_items; // the items of each formula, then the signs and potions of each monster, decoded on first use
+    const KbRequirement *requirements; // in the file, ordered by ingredient name then required quantity
+    int requirement_count;
+    const KbEffect *effects; // in the file, ordered by name then monster
+    int effect_count;
+} KnowledgeBase;
+
+// one requirement of a formula on an ingredient, the required quantity comes first so lists of both kinds
+// can be binary searched by it
+typedef struct
+{
+    int required;
+    int formula; // a session formula index, or BREW_KB_FORMULA(k) for the k-th formula of the knowledge base
+} Requirement;
+
+// turns the position of a knowledge base formula into a formula of the brew index, and back
+#define BREW_KB_FORMULA(k) (-1 - (k))
+
+// every ingredient the inventory holds or a formula requires, with the requirements ordered by required quantity
+typedef struct BrewIngredient
+{
+    struct BrewIngredient *next_in_bucket;
+    const char *name;
+    int quantity;
+    Bool in_stock; // in the inventory, even with a quantity of 0 or less
+    Requirement *requirements; // of the session's formulas
+    int requirement_count;
+    int requirement_capacity;
+    const KbRequirement *kb_requirements; // of the knowledge base formulas, shared and read-only
+    int kb_requirement_count;
+} BrewIngredient;
+
+typedef struct
+{
+    int satisfied;          // requirements of the formula the inventory meets
+    int brewable_position;  // position in the brewable list plus one, 0 if not in it
+} FormulaProgress;
+
+// which formulas the inventory is enough for, kept up to date on every change instead of scanning, one per thread
+typedef struct
+{
+    BrewIngredient **buckets;
+    int bucket_count;
+    int entry_count;
+    FormulaProgress *progress; // of the session's formulas, by index
+    int progress_capacity;
+    FormulaProgress *kb_progress; // of the knowledge base formulas, allocated on first use
+    int *brewable; // the formulas with every requirement met
+    int brewable_count;
+    int brewable_capacity;
+} BrewIndex;
+
+// every sign or potion the session learned to be effective, with the monsters it was learned against
+typedef struct BestiaryEntry
+{
+    struct BestiaryEntry *next_in_bucket;
+    const char *name;
+    int *monsters; // session monster indices, in learn order
+    int monster_count;
+    int monster_capacity;
+} BestiaryEntry;
+
+// the reverse of the monsters' effectiveness lists, one per thread
+typedef struct
+{
+    BestiaryEntry **buckets;
+    int bucket_count;
+    int entry_count;
+} BestiaryIndex;
+
+// the tables kept in order, the inventories by quantity and by name, the monsters by name only
+typedef enum
+{
+    RANK_INGREDIENTS,
+    RANK_POTIONS,
+    RANK_TROPHIES,
+    RANK_MONSTERS,
+    RANK_TABLE_COUNT
+} RankTable;
+
+// the tables with a quantity, the ones ranked by it
+#define RANK_INVENTORY_COUNT RANK_MONSTERS
+
+#define RANK_MAX_LEVEL 16
+
+// an item ever added to a table, linked on its first level levels of two skip lists
+typedef struct RankNode
+{
+    const char *name;
+    int quantity;
+    int level;
+    struct RankNode **next_by_name; // the second half of next
+    struct RankNode *next[];        // level links in quantity order, then level links in name order
+} RankNode;
+
+// every name of a table in name order, and the items with a quantity other than 0 most plentiful first
+// and in name order for equal quantities, kept up to date on every change, one per table and thread
+typedef struct
+{
+    RankNode *head;  // has every level of both lists and no item, NULL until the first item
+    int level;       // the levels of the quantity order some item is linked on
+    int name_level;  // the same for the name order
+    int count;       // the items in quantity order
+    unsigned seed;
+} RankIndex;
+
+// a block of names, filled from the start and never moved
+typedef struct NamePoolBlock
+{
+    struct NamePoolBlock *next; // the block filled before this one
+    int used;
+    int size;
+    char text[];
+} NamePoolBlock;
+
+// every name a session stored in its tables, each once, one per thread
+typedef struct
+{
+    NamePoolBlock *blocks; // the newest first
+    const char **slots;    // open addressing, the stored names, NULL for an empty slot
+    int slot_count;        // a power of two, at least twice the names
+    int count;
+    size_t bytes;          // of the names and their terminators
+} NamePool;
+
+// what the allocations of the tables and the handlers are counted under
+typedef enum
+{
+    MEM_INVENTORY,
+    MEM_POTIONS,
+    MEM_TROPHIES,
+    MEM_FORMULAS,   // the formulas and their ingredient lists
+    MEM_BESTIARY,   // the monsters and their sign and potion lists
+    MEM_TEMPORARIES, // buffers of a single command, and those kept for the next one
+    MEM_NAMES,       // the name pool, the blocks of names and the hash table over them
+    MEM_BREW_INDEX,
+    MEM_BESTIARY_INDEX,
+    MEM_RANK_INDEX,
+    MEM_INVENTORY_INDEX, // the hash tables of the inventories and of the formulas
+    MEM_PARSE_CACHE, // counted on the thread parsing the lines, the parser threads in --pipeline mode, and not in the total
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+typedef struct
+{
+    size_t live;      // bytes allocated and not freed
+    size_t peak;      // the most live bytes so far
+    long allocations; // calls to the allocator, a resize counts as one
+} MemCounter;
+
+// the memory counters of a session, one per thread
+typedef struct
+{
+    MemCounter subsystems[MEM_SUBSYSTEM_COUNT];
+    MemCounter total;
+    Bool session_ended; // already added to the process totals
+} MemStats;
+
+// the position of every name of an inventory, or of the formulas, in its array, one per table and thread
+typedef struct
+{
+    int *buckets;      // open addressing, the position of an item or -1, NULL until the first lookup
+    int bucket_count;  // a power of two, at least twice the items filed
+    int count;         // the items filed, the first ones of the array
+    Bool reordered;    // the items moved since they were filed
+} InventoryIndex;
+
 // global variables
-extern int last_added_ingredient_index;
-extern int last_added_potion_index;
-extern int last_added_sign_index;
-extern int last_added_monster_index;
-extern int last_added_trophy_index;
-extern int last_added_formula_index;
-
-extern int ingredient_capacity;
-extern int potion_capacity;
-extern int trophy_capacity;
-extern int sign_capacity;
-extern int monster_capacity;
-extern int formula_capacity;
-
-extern Ingredient *ingredients;
-extern Potion *potions;
-extern Trophy *trophies;
-extern PotionFormula *formulas;
-extern Monster *monsters;
-extern Sign *signs;
+extern THREAD_LOCAL int last_added_ingredient_index;
+extern THREAD_LOCAL int last_added_potion_index;
+extern THREAD_LOCAL int last_added_sign_index;
+extern THREAD_LOCAL int last_added_monster_index;
+extern THREAD_LOCAL int last_added_trophy_index;
+extern THREAD_LOCAL int last_added_formula_index;
+
+extern THREAD_LOCAL int ingredient_capacity;
+extern THREAD_LOCAL int potion_capacity;
+extern THREAD_LOCAL int trophy_capacity;
+extern THREAD_LOCAL int sign_capacity;
+extern THREAD_LOCAL int monster_capacity;
+extern THREAD_LOCAL int formula_capacity;
+
+extern THREAD_LOCAL Ingredient *ingredients;
+extern THREAD_LOCAL Potion *potions;
+extern THREAD_LOCAL Trophy *trophies;
+extern THREAD_LOCAL PotionFormula *formulas;
+extern THREAD_LOCAL Monster *monsters;
+extern THREAD_LOCAL Sign *signs;
+
+// the base layer under every session's formulas and monsters, NULL unless --kb is given
+extern const KnowledgeBase *knowledge_base;
+
+// set on threads answering from a snapshot, whose tables are shared and must not be sorted in place
+extern THREAD_LOCAL Bool tables_read_only;
+
+// where the responses of the current session are written, stdout when NULL
+extern THREAD_LOCAL FILE *output_stream;
+// if set, responses are appended here instead of output_stream
+extern THREAD_LOCAL OutputBuffer *output_buffer;
+// if set, the session is binary and responses are appended here as frames instead of being printed
+extern THREAD_LOCAL OutputBuffer *response_frames;
+// the command the lines of a session are parsed into, reused line after line
+extern THREAD_LOCAL Command line_command;
+
+// bytes of parsed commands each thread may keep, 0 turns the parse cache off, set before any thread starts
+extern size_t parse_cache_budget;
+extern THREAD_LOCAL ParseCache parse_cache;
+
+extern THREAD_LOCAL BrewIndex brew_index;
+extern THREAD_LOCAL BestiaryIndex bestiary_index;
+extern THREAD_LOCAL RankIndex rank_index[RANK_TABLE_COUNT];
+extern THREAD_LOCAL InventoryIndex inventory_index[RANK_INVENTORY_COUNT];
+extern THREAD_LOCAL InventoryIndex formula_index;
+extern THREAD_LOCAL NamePool name_pool;
+extern THREAD_LOCAL MemStats mem_stats;
+// set on threads answering from a snapshot, the brewable potions in name order and the sorted reverse postings
+extern THREAD_LOCAL const TableVersion *brewable_view;
+extern THREAD_LOCAL const TableVersion *uses_view;
+extern THREAD_LOCAL const TableVersion *effective_view;
+// set on threads answering from a snapshot, the items in stock in rank index order, as Ingredient
+extern THREAD_LOCAL const TableVersion *ranked_view[RANK_INVENTORY_COUNT];
+
+// main.c
+Bool execute_command(const Command *command);
+
+// command.c
+void command_reset(Command *command);
+void command_free(Command *command);
+const char *command_text(const Command *command, int offset);
+int command_add_text(Command *command, const char *text);
+int command_add_chars(Command *command, const char *chars, int length);
+int command_add_words(Command *command, const char *text, const int *word_starts, int from, int to);
+void command_add_item(Command *command, const char *name, int quantity);
+void command_add_stored_item(Command *command, int name, int quantity);
+void command_add_item_words(Command *command, const char *text, const int *word_starts, int from, int to, int quantity);
+void command_copy(Command *command, const Command *source);
+void parse_line(const char *line, Command *command);
+
+// line_reader.c
+void line_parser_begin();
+void line_parser_feed(const char *chunk, int length);
+void line_parser_finish(Command *command);
+void line_parser_free();
+Bool read_line_chunk(FILE *input, char *chunk, int size, Bool *continued);
+Bool read_command(FILE *input, Command *command, Bool cached);
+
+// parse_cache.c
+void parse_line_cached(const char *line, Command *command);
+void parse_cache_free();
+void parse_cache_report();
+
+// ring.c
+void ring_init(SpscRing *ring, size_t slot_size, size_t capacity);
+void ring_free(SpscRing *ring);
+void *ring_slot(SpscRing *ring, size_t index);
+void *ring_slot_for_write(SpscRing *ring, atomic_int *stop);
+void ring_publish(SpscRing *ring);
+void *ring_slot_for_read(SpscRing *ring, atomic_int *stop);
+void ring_release(SpscRing *ring);
+void ring_wait(int *spins);
+
+// snapshot.c
+void snapshot_store_init(SnapshotStore *store);
+void snapshot_store_free(SnapshotStore *store);
+unsigned snapshot_dirty_tables(CommandKind kind);
+Snapshot *snapshot_publish(SnapshotStore *store, unsigned dirty, long epoch);
+Snapshot *snapshot_current(SnapshotStore *store);
+void snapshot_reclaim(SnapshotStore *store, long safe_epoch);
+void snapshot_install(const Snapshot *snapshot);
+const Posting *snapshot_find_postings(const TableVersion *table, const char *name, int *count);
+
+// kb.c
+int compile_knowledge_base(const char *input_path, const char *output_path);
+Bool load_knowledge_base(const char *path);
+const KbFormula *kb_find_formula(const char *potion_name);
+PotionFormula *kb_get_formula(const char *potion_name);
+const KbMonster *kb_find_monster(const char *monster_name);
+Bool kb_knows_effectiveness(const KbMonster *monster, const char *name, Bool is_sign);
+const KbRequirement *kb_find_requirements(const char *ingredient_name, int *count);
+const KbEffect *kb_find_effects(const char *name, int *count);
+const char *kb_name(int name);
+const Sign *kb_monster_signs(const KbMonster *monster);
+const Potion *kb_monster_potions(const KbMonster *monster);
+int kb_first_monster_from(const char *name);
+
+// brew_index.c
+const BrewIngredient *brew_index_find(const char *name);
+void brew_index_ingredient_changed(const char *name, int quantity);
+void brew_index_formula_learned(int formula);
+int brew_index_collect(Potion *brewable);
+void brew_index_free();
+
+// bestiary_index.c
+const BestiaryEntry *bestiary_index_find(const char *name);
+void bestiary_index_learned(const char *name, int monster);
+void bestiary_index_free();
+
+// rank_index.c
+void rank_index_changed(RankTable table, const char *name, int old_quantity, int new_quantity);
+const RankNode *rank_index_first(RankTable table);
+const RankNode *rank_index_first_below(RankTable table, int quantity);
+void rank_index_add_name(RankTable table, const char *name);
+const RankNode *rank_index_first_from(RankTable table, const char *name);
+int rank_index_collect(RankTable table, Ingredient *ranked);
+void rank_index_free();
+
+// inventory_index.c
+int inventory_index_find(RankTable table, const char *name);
+void inventory_index_reordered(RankTable table);
+int formula_index_find(const char *name);
+void formula_index_reordered();
+void inventory_index_free();
+
+// name_pool.c
+const char *name_pool_intern(const char *name);
+void name_pool_take(NamePool *pool);
+void name_pool_release(NamePool *pool);
+void name_pool_free();
+
+// mem_stats.c
+void *mem_malloc(MemSubsystem subsystem, size_t size);
+void *mem_calloc(MemSubsystem subsystem, size_t count, size_t size);
+void *mem_realloc(MemSubsystem subsystem, void *block, size_t old_size, size_t size);
+void mem_free(MemSubsystem subsystem, void *block, size_t size);
+const char *mem_subsystem_name(int subsystem);
+void mem_stats_in_use(size_t *in_use);
+void mem_stats_end_session();
+void mem_stats_end_thread();
+void mem_stats_free();
+void mem_report();
+
+// name_dict.c
+char *name_dict_encode(const char *const *names, int count, int *block_offsets, int *length);
+int name_dict_find(const NameDict *dict, const char *name);
+int name_dict_first_from(const NameDict *dict, const char *name);
+const char *name_dict_name(const NameDict *dict, int number);
+
+// binary.c
+void append_bytes(OutputBuffer *buffer, const void *bytes, int length);
+void append_u8(OutputBuffer *buffer, int value);
+void append_u32(OutputBuffer *buffer, uint32_t value);
+void append_name_field(OutputBuffer *buffer, const char *name, int length);
+int run_binary_session(FILE *input, FILE *output);
+int encode_text_session(FILE *input, FILE *output);
+
+// response.c
+void respond(BinaryResponse code, const char *name);
+void respond_one_of(BinaryResponse code, const char *name, Bool last);
+void respond_quantity(int quantity);
+void respond_brewed(int count, const char *name);
+void respond_encounters(int won, int escaped, const char *name);
+void respond_list_begin(BinaryResponse code, Bool none_if_empty);
+void respond_item(long quantity, const char *name);
+void respond_name(const char *name);
+void respond_text_only(const char *text);
+void respond_list_end();
+
+// pipeline.c
+int run_pipeline(FILE *input, int parser_count, int query_count);
+
+// state.c
+void init_state();
+void free_state();
+
+// replay.c
+long replay_session(FILE *input);
+int list_session_logs(DIR *dir, const char *dir_path, ReplayFile **files);
+int replay_directory(const char *input_dir, const char *output_dir, int thread_count);
+
+// aggregate.c
+int aggregate_directory(const char *input_dir, int thread_count);
 
 // utils.c
-void remove_trailing_newline(char *line);
-void remove_trailing_spaces(char *line);
-int split_into_words(char *line, char words[][MAX_WORD_LEN]);
+void print_output(const char *format, ...);
 Bool is_alphabetic_custom(const char *token);
 Bool is_digit_custom(const char *token);
 int cmpIngredient(const void *a, const void *b);
 int cmpPotion(const void *a, const void *b);
 int cmpTrophy(const void *a, const void *b);
-int cmp(const void *a, const void *b);
+int cmpSign(const void *a, const void *b);
+int cmpMonster(const void *a, const void *b);
+int cmpFormula(const void *a, const void *b);
 int cmpForRecipe(const void *a, const void *b);
-Bool is_valid_potion_name_spacing(const char *line, const char *potion_name);
+unsigned hash_name(const char *name);
+int first_name_from(const void *items, int count, size_t item_size, const char *name);
 
-// type_detections.c
-LineType detect_type(char words[][MAX_WORD_LEN], int word_count);
-Sentence detect_sentence(char words[][MAX_WORD_LEN]);
-Question detect_question(char words[][MAX_WORD_LEN], int word_count);
+// grammar.c
+void grammar_begin(LineParser *parser);
+void grammar_match(LineParser *parser, int to);
+void grammar_finish(LineParser *parser, Command *command);
 
 // sentence_handle.c
-Bool is_valid_ingredient_sentence(char words[][MAX_WORD_LEN], int word_count);
-void add_ingredient(Ingredient *ingredients, char *name, int quantity);
-Bool is_valid_trade_sentence(char words[][MAX_WORD_LEN], int word_count);
-Bool check_valid_trade(Trophy *trophies, Trophy *trophies_to_trade, int trade_index);
-void trade(Ingredient *ingredients, Trophy *trophies, Trophy *trophies_to_trade, int num_trophies_to_trade, char words[][MAX_WORD_LEN], int curr_index, int word_count);
-Bool is_valid_brew_sentence(char words[][MAX_WORD_LEN], int word_count, const char *line);
+int plan_received_ingredients(const Command *command);
+Bool trade(Ingredient *ingredients, Trophy *trophies, const Command *command);
+void loot(Ingredient *ingredients, const Command *command);
+void item_plan_free();
 Bool has_formula(const char *potion_name, PotionFormula *formulas);
 Bool can_brew(const char *potion_name, Ingredient *inventory, PotionFormula *formulas);
 void brew_potion(const char *potion_name, Ingredient *inventory, Potion *potions, PotionFormula *formulas);
+int brewable_count(const PotionFormula *formula, const Ingredient *inventory);
+void brew_potions(const PotionFormula *formula, int count, Ingredient *inventory, Potion *potions);
+void brew_potion_list(const Command *command, Ingredient *inventory, Potion *potions, PotionFormula *formulas);
 PotionFormula *get_formula(const char *potion_name, PotionFormula *formulas);
 void add_potion(Potion *potions, const char *name);
-Bool is_valid_learn_sentence(char words[][MAX_WORD_LEN], int word_count, const char *line);
-Bool learn_potion_formula(char words[][MAX_WORD_LEN], int word_count, PotionFormula *formulas);
-Bool learn_effectiveness(char words[][MAX_WORD_LEN], int word_count, Monster *monsters);
-Bool is_valid_encounter_sentence(char words[][MAX_WORD_LEN], int word_count);
-void handle_encounter(char words[][MAX_WORD_LEN], int word_count, Monster *monsters, Potion *potions, Trophy *trophies);
+void add_potions(Potion *potions, const char *name, int count);
+Bool learn_potion_formula(const Command *command, PotionFormula *formulas);
+Bool learn_effectiveness(const Command *command, Monster *monsters);
+void handle_encounter(const char *monster_name, Monster *monsters, Potion *potions, Trophy *trophies);
+void handle_encounters(const char *monster_name, int count, Monster *monsters, Potion *potions, Trophy *trophies);
 
 // question_handle.c
-void handle_specific_ingredient_query(char words[][MAX_WORD_LEN], int word_count);
-void handle_specific_potion_query(char words[][MAX_WORD_LEN], int word_count, const char *line);
-void handle_specific_trophy_query(char words[][MAX_WORD_LEN], int word_count);
+void handle_specific_ingredient_query(const char *ingredient_name);
+void handle_specific_potion_query(const char *potion_name);
+void handle_specific_trophy_query(const char *trophy_name);
 void handle_all_ingredients_query();
 void handle_all_potions_query();
 void handle_all_trophies_query();
-void handle_monster_query(char words[][MAX_WORD_LEN], int word_count);
-void handle_potion_recipe_query(char words[][MAX_WORD_LEN], int word_count, const char *line);
+void handle_monster_query(const char *monster_name);
+void handle_potion_recipe_query(const char *potion_name);
+void handle_brewable_query();
+void handle_uses_query(const char *ingredient_name);
+void handle_effective_against_query(const char *name);
+void handle_top_query(RankTable table, int count);
+void handle_below_query(RankTable table, int quantity);
+void handle_multi_quantity_query(const Command *command, const Ingredient *items, int item_count);
+void handle_prefix_query(RankTable table, const char *pattern);
+void handle_memory_query();
+void handle_memory_allocations_query();
 
 //capacity_ensuring.c
 void ensure_ingredient_capacity();
@@ -0,0 +1,806 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "globals.h"
+
+#define GRAMMAR_MAX_NFA_STATES 1024
+#define GRAMMAR_MAX_DFA_STATES 512
+#define GRAMMAR_MAX_ACTION_SETS 256
+#define GRAMMAR_SET_WORDS (GRAMMAR_MAX_NFA_STATES / 64)
+
+// what the interpreter does with a token, a DFA transition may carry several of them
+#define ACTION_NAME 1     // the token is part of the name, the name is the span from the first to the last such token
+#define ACTION_QUANTITY 2 // the token is the quantity of the next item
+#define ACTION_ITEM 4     // the token is the name of an ingredient item
+#define ACTION_TROPHY 8   // the token is the name of a trophy item
+#define ACTION_TARGET 16  // the token is the monster of a LEARN effectiveness sentence
+#define ACTION_COUNT 32   // the token is the count of a batch command
+#define ACTION_POTION 64  // the token is a word of a potion name in a list, consecutive words make one name
+
+// every token of a line falls in exactly one class, the automaton reads classes instead of words
+typedef enum
+{
+    TOKEN_OTHER,
+    TOKEN_WORD,          // alphabetic and not a keyword
+    TOKEN_NUMBER,        // a valid quantity, digits without leading zero, positive and fitting in an int
+    TOKEN_COMMA,
+    TOKEN_QUESTION_MARK,
+    TOKEN_PREFIX,        // alphabetic, possibly empty, and ending with '*'
+    TOKEN_KEYWORD        // keyword k has the class TOKEN_KEYWORD + k
+} TokenClass;
+
+static const char *keywords[] = {
+    "Exit", "Geralt", "loots", "trades", "brews", "learns", "encounters", "trophy", "for", "a", "potion", "sign",
+    "is", "effective", "against", "consists", "of", "Total", "ingredient", "What", "in", "max", "can", "brew", "uses",
+    "Top", "below", "monster", "memory", "allocations",
+};
+
+#define KEYWORD_COUNT ((int)(sizeof(keywords) / sizeof(keywords[0])))
+#define TOKEN_CLASS_COUNT (TOKEN_KEYWORD + KEYWORD_COUNT)
+
+// a pattern is a list of space separated elements:
+//   keywords stand for themselves, "," and QMARK for the comma and the question mark
+//   NAME is any alphabetic word including keywords, NAME-k is NAME except the keyword k, NUM is a quantity,
+//   PREFIX is the last word of a name pattern such as "Blood*"
+//   NAME:name, NUM:quantity, NAME:item, NAME:trophy, NAME:target, NUM:count and NAME:potion attach an action to the element
+//   "(", ")" group elements and "|" separates alternatives, and a trailing *, + or ? repeats an element or a group
+typedef struct
+{
+    CommandKind kind;
+    const char *pattern;
+    Bool check_spacing;   // from the name, or the first potion of a list, to the question mark, words must be one space apart
+    Bool name_until_type; // the name is every word up to the first "sign" or "potion", which also tells if it is a sign
+} GrammarRule;
+
+static const GrammarRule grammar_rules[] = {
+    {COMMAND_EXIT, "Exit", FALSE, FALSE},
+    {COMMAND_LOOT, "Geralt loots ( ( NUM:quantity NAME:item , )* NUM:quantity NAME:item? )?", FALSE, FALSE},
+    {COMMAND_TRADE, "Geralt trades ( NUM:quantity NAME:trophy trophy ( ( , NUM:quantity NAME:trophy trophy )+ ,? )? )? "
+                    "for ( NUM:quantity NAME:item ( , NUM:quantity NAME:item )* ,? )?", FALSE, FALSE},
+    {COMMAND_BREW_BATCH, "Geralt brews NUM:count NAME:name+", TRUE, FALSE},
+    {COMMAND_BREW_BATCH, "Geralt brews max NAME:name+", TRUE, FALSE},
+    {COMMAND_BREW_LIST, "Geralt brews NAME:potion+ ( , NAME:potion+ )+", TRUE, FALSE},
+    {COMMAND_BREW, "Geralt brews NAME:name+", TRUE, FALSE},
+    {COMMAND_LEARN_FORMULA, "Geralt learns NAME-potion:name+ potion consists of NUM:quantity NAME:item ( , NUM:quantity NAME:item )* ,?", TRUE, FALSE},
+    {COMMAND_LEARN_EFFECTIVENESS, "Geralt learns NAME sign is effective against NAME:target", FALSE, TRUE},
+    {COMMAND_LEARN_EFFECTIVENESS, "Geralt learns NAME-potion:name+ potion is effective against NAME:target", TRUE, TRUE},
+    {COMMAND_ENCOUNTER, "Geralt encounters a NAME:name", FALSE, FALSE},
+    {COMMAND_ENCOUNTER_BATCH, "Geralt encounters NUM:count NAME:name", FALSE, FALSE},
+    {COMMAND_ALL_INGREDIENTS_QUERY, "Total ingredient QMARK", FALSE, FALSE},
+    {COMMAND_INGREDIENT_QUERY, "Total ingredient NAME:name QMARK", FALSE, FALSE},
+    {COMMAND_MULTI_INGREDIENT_QUERY, "Total ingredient NAME:item ( , NAME:item )+ QMARK", FALSE, FALSE},
+    {COMMAND_INGREDIENT_PREFIX_QUERY, "Total ingredient PREFIX:name QMARK", FALSE, FALSE},
+    {COMMAND_ALL_POTIONS_QUERY, "Total potion QMARK", FALSE, FALSE},
+    {COMMAND_POTION_QUERY, "Total potion NAME:name+ QMARK", TRUE, FALSE},
+    {COMMAND_MULTI_POTION_QUERY, "Total potion NAME:potion+ ( , NAME:potion+ )+ QMARK", TRUE, FALSE},
+    {COMMAND_POTION_PREFIX_QUERY, "Total potion NAME:name* PREFIX:name QMARK", TRUE, FALSE},
+    {COMMAND_ALL_TROPHIES_QUERY, "Total trophy QMARK", FALSE, FALSE},
+    {COMMAND_TROPHY_QUERY, "Total trophy NAME:name QMARK", FALSE, FALSE},
+    {COMMAND_MULTI_TROPHY_QUERY, "Total trophy NAME:item ( , NAME:item )+ QMARK", FALSE, FALSE},
+    {COMMAND_TROPHY_PREFIX_QUERY, "Total trophy PREFIX:name QMARK", FALSE, FALSE},
+    {COMMAND_MONSTER_PREFIX_QUERY, "Total monster PREFIX:name QMARK", FALSE, FALSE},
+    {COMMAND_MEMORY_QUERY, "Total memory QMARK", FALSE, FALSE},
+    {COMMAND_MEMORY_ALLOCATIONS_QUERY, "Total memory allocations QMARK", FALSE, FALSE},
+    {COMMAND_MONSTER_QUERY, "What is effective against NAME:name QMARK", FALSE, FALSE},
+    {COMMAND_POTION_FORMULA_QUERY, "What is in NAME:name+ QMARK", TRUE, FALSE},
+    {COMMAND_BREWABLE_QUERY, "What can Geralt brew QMARK", FALSE, FALSE},
+    {COMMAND_USES_QUERY, "What uses NAME:name QMARK", FALSE, FALSE},
+    {COMMAND_EFFECTIVE_AGAINST_QUERY, "What is NAME-effective:name+ effective against QMARK", TRUE, FALSE},
+    {COMMAND_TOP_INGREDIENTS_QUERY, "Top NUM:count ingredient QMARK", FALSE, FALSE},
+    {COMMAND_TOP_POTIONS_QUERY, "Top NUM:count potion QMARK", FALSE, FALSE},
+    {COMMAND_TOP_TROPHIES_QUERY, "Top NUM:count trophy QMARK", FALSE, FALSE},
+    {COMMAND_INGREDIENTS_BELOW_QUERY, "Total ingredient below NUM:count QMARK", FALSE, FALSE},
+    {COMMAND_POTIONS_BELOW_QUERY, "Total potion below NUM:count QMARK", FALSE, FALSE},
+    {COMMAND_TROPHIES_BELOW_QUERY, "Total trophy below NUM:count QMARK", FALSE, FALSE},
+};
+
+#define RULE_COUNT ((int)(sizeof(grammar_rules) / sizeof(grammar_rules[0])))
+
+// NFA built from the patterns, a state has either one token edge or up to two empty edges
+typedef struct
+{
+    uint64_t classes; // the token classes of the token edge, 0 if the state only has empty edges
+    int action;
+    int next;
+    int empty[2];
+    int empty_count;
+    int accept_rule; // the rule matched when the whole line ends here, -1 if none
+    int rule;        // the rule whose pattern the state was built for
+} NfaState;
+
+typedef struct
+{
+    int start;
+    int end; // has no edges yet, so the fragment can be linked to what follows
+} Fragment;
+
+typedef struct
+{
+    const char *pattern;
+    char element[64];
+    int position;
+} PatternReader;
+
+static NfaState nfa[GRAMMAR_MAX_NFA_STATES];
+static int nfa_count;
+static int building_rule;
+
+// the automaton, state 0 rejects everything and state 1 is the start
+// a transition may serve several rules that share a prefix, so its actions are kept per rule
+// and only those of the rule finally matched are applied
+static short dfa_next[GRAMMAR_MAX_DFA_STATES][TOKEN_CLASS_COUNT];
+static unsigned char dfa_action_set[GRAMMAR_MAX_DFA_STATES][TOKEN_CLASS_COUNT];
+static signed char dfa_rule[GRAMMAR_MAX_DFA_STATES];
+static int dfa_count;
+
+// the distinct per-rule action vectors of the transitions
+static unsigned char action_sets[GRAMMAR_MAX_ACTION_SETS][RULE_COUNT];
+static int action_set_count;
+
+// the classes of "sign" and "potion", which end the name of a LEARN effectiveness sentence
+static int sign_token;
+static int potion_token;
+
+static pthread_once_t grammar_once = PTHREAD_ONCE_INIT;
+
+static void grammar_error(const char *message, const char *pattern)
+{
+    /**
+        * Function Name: grammar_error
+        *
+        * Purpose:
+        *    Reports a mistake in the grammar table, which is a programming error.
+        *
+        * Parameters:
+        *     const char *message - What is wrong.
+        *     const char *pattern - The pattern it was found in.
+        *
+        * Return:
+        *     void - Does not return, exits the program.
+        */
+    fprintf(stderr, "grammar: %s in \"%s\"\n", message, pattern);
+    exit(1);
+}
+
+static int new_nfa_state()
+{
+    /**
+        * Function Name: new_nfa_state
+        *
+        * Purpose:
+        *    Adds a state without edges to the NFA.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     int - The index of the new state.
+        */
+    if (nfa_count >= GRAMMAR_MAX_NFA_STATES)
+        grammar_error("too many NFA states", "");
+    NfaState *state = &nfa[nfa_count];
+    state->classes = 0;
+    state->action = 0;
+    state->next = -1;
+    state->empty_count = 0;
+    state->accept_rule = -1;
+    state->rule = building_rule;
+    return nfa_count++;
+}
+
+static void add_empty_edge(int from, int to)
+{
+    /**
+        * Function Name: add_empty_edge
+        *
+        * Purpose:
+        *    Links two NFA states with an edge that reads no token.
+        *
+        * Parameters:
+        *     int from - The state the edge leaves.
+        *     int to - The state the edge enters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    nfa[from].empty[nfa[from].empty_count++] = to;
+}
+
+static int keyword_index(const char *word)
+{
+    /**
+        * Function Name: keyword_index
+        *
+        * Purpose:
+        *    Finds a word in the keyword list.
+        *
+        * Parameters:
+        *     const char *word - The word.
+        *
+        * Return:
+        *     int - The index of the keyword, -1 if the word is not a keyword.
+        */
+    for (int k = 0; k < KEYWORD_COUNT; k++)
+    {
+        if (word[0] == keywords[k][0] && strcmp(word, keywords[k]) == 0)
+            return k;
+    }
+    return -1;
+}
+
+static Fragment term_fragment(const char *element, const char *pattern)
+{
+    /**
+        * Function Name: term_fragment
+        *
+        * Purpose:
+        *    Builds the NFA fragment reading one token that matches a pattern element.
+        *
+        * Parameters:
+        *     const char *element - The element without repetition, e.g. "potion", "NUM:quantity".
+        *     const char *pattern - The whole pattern, for error messages.
+        *
+        * Return:
+        *     Fragment - The fragment.
+        */
+    char symbol[64];
+    strcpy(symbol, element);
+    int action = 0;
+    char *tag = strchr(symbol, ':');
+    if (tag != NULL)
+    {
+        *tag++ = '\0';
+        if (strcmp(tag, "name") == 0)
+            action = ACTION_NAME;
+        else if (strcmp(tag, "quantity") == 0)
+            action = ACTION_QUANTITY;
+        else if (strcmp(tag, "item") == 0)
+            action = ACTION_ITEM;
+        else if (strcmp(tag, "trophy") == 0)
+            action = ACTION_TROPHY;
+        else if (strcmp(tag, "target") == 0)
+            action = ACTION_TARGET;
+        else if (strcmp(tag, "count") == 0)
+            action = ACTION_COUNT;
+        else if (strcmp(tag, "potion") == 0)
+            action = ACTION_POTION;
+        else
+            grammar_error("unknown action", pattern);
+    }
+
+    uint64_t names = 1ull << TOKEN_WORD;
+    for (int k = 0; k < KEYWORD_COUNT; k++)
+        names |= 1ull << (TOKEN_KEYWORD + k);
+
+    uint64_t classes;
+    if (strcmp(symbol, "NAME") == 0)
+        classes = names;
+    else if (strncmp(symbol, "NAME-", 5) == 0 && keyword_index(symbol + 5) >= 0)
+        classes = names & ~(1ull << (TOKEN_KEYWORD + keyword_index(symbol + 5)));
+    else if (strcmp(symbol, "NUM") == 0)
+        classes = 1ull << TOKEN_NUMBER;
+    else if (strcmp(symbol, ",") == 0)
+        classes = 1ull << TOKEN_COMMA;
+    else if (strcmp(symbol, "QMARK") == 0)
+        classes = 1ull << TOKEN_QUESTION_MARK;
+    else if (strcmp(symbol, "PREFIX") == 0)
+        classes = 1ull << TOKEN_PREFIX;
+    else if (keyword_index(symbol) >= 0)
+        classes = 1ull << (TOKEN_KEYWORD + keyword_index(symbol));
+    else
+    {
+        grammar_error("unknown element", pattern);
+        classes = 0;
+    }
+
+    Fragment fragment;
+    fragment.start = new_nfa_state();
+    fragment.end = new_nfa_state();
+    nfa[fragment.start].classes = classes;
+    nfa[fragment.start].action = action;
+    nfa[fragment.start].next = fragment.end;
+    return fragment;
+}
+
+static Fragment repeat_fragment(Fragment fragment, char repetition)
+{
+    /**
+        * Function Name: repeat_fragment
+        *
+        * Purpose:
+        *    Wraps a fragment so it is read zero or more (*), one or more (+) or zero or one (?) times.
+        *
+        * Parameters:
+        *     Fragment fragment - The fragment to be repeated.
+        *     char repetition - '*', '+', '?' or '\0' for exactly once.
+        *
+        * Return:
+        *     Fragment - The repeated fragment.
+        */
+    if (repetition == '\0')
+        return fragment;
+
+    Fragment repeated;
+    repeated.start = repetition == '+' ? fragment.start : new_nfa_state();
+    repeated.end = new_nfa_state();
+    if (repetition != '+')
+    {
+        add_empty_edge(repeated.start, fragment.start);
+        add_empty_edge(repeated.start, repeated.end);
+    }
+    if (repetition != '?')
+        add_empty_edge(fragment.end, fragment.start);
+    add_empty_edge(fragment.end, repeated.end);
+    return repeated;
+}
+
+static Bool next_element(PatternReader *reader)
+{
+    /**
+        * Function Name: next_element
+        *
+        * Purpose:
+        *    Reads the next space separated element of a pattern.
+        *
+        * Parameters:
+        *     PatternReader *reader - The pattern and the position to read from.
+        *
+        * Return:
+        *     Bool - TRUE if an element was read into reader->element, FALSE at the end of the pattern.
+        */
+    const char *p = reader->pattern + reader->position;
+    while (*p == ' ')
+        p++;
+    if (*p == '\0')
+        return FALSE;
+
+    int length = 0;
+    while (p[length] != '\0' && p[length] != ' ' && length < (int)sizeof(reader->element) - 1)
+    {
+        reader->element[length] = p[length];
+        length++;
+    }
+    reader->element[length] = '\0';
+    reader->position = p + length - reader->pattern;
+    return TRUE;
+}
+
+static Fragment parse_alternatives(PatternReader *reader, Bool in_group, char *repetition);
+
+static Fragment parse_sequence(PatternReader *reader, Bool in_group, char *repetition, Bool *more_alternatives)
+{
+    /**
+        * Function Name: parse_sequence
+        *
+        * Purpose:
+        *    Builds the fragment of consecutive elements, up to a "|", the end of the group or the end of the pattern.
+        *
+        * Parameters:
+        *     PatternReader *reader - The pattern being read.
+        *     Bool in_group - TRUE inside parentheses.
+        *     char *repetition - Receives the repetition after the closing parenthesis of the group.
+        *     Bool *more_alternatives - Set to TRUE if the sequence ended at a "|".
+        *
+        * Return:
+        *     Fragment - The fragment of the sequence.
+        */
+    Fragment sequence;
+    sequence.start = new_nfa_state();
+    sequence.end = sequence.start;
+    *more_alternatives = FALSE;
+
+    while (next_element(reader))
+    {
+        char *element = reader->element;
+        if (strcmp(element, "|") == 0)
+        {
+            *more_alternatives = TRUE;
+            return sequence;
+        }
+        if (element[0] == ')')
+        {
+            if (!in_group)
+                grammar_error("unbalanced parenthesis", reader->pattern);
+            *repetition = element[1];
+            return sequence;
+        }
+
+        Fragment fragment;
+        if (strcmp(element, "(") == 0)
+        {
+            char group_repetition = '\0';
+            fragment = parse_alternatives(reader, TRUE, &group_repetition);
+            fragment = repeat_fragment(fragment, group_repetition);
+        }
+        else
+        {
+            int length = strlen(element);
+            char element_repetition = '\0';
+            if (length > 1 && strchr("*+?", element[length - 1]) != NULL)
+            {
+                element_repetition = element[length - 1];
+                element[length - 1] = '\0';
+            }
+            fragment = repeat_fragment(term_fragment(element, reader->pattern), element_repetition);
+        }
+        add_empty_edge(sequence.end, fragment.start);
+        sequence.end = fragment.end;
+    }
+
+    if (in_group)
+        grammar_error("unbalanced parenthesis", reader->pattern);
+    return sequence;
+}
+
+static Fragment parse_alternatives(PatternReader *reader, Bool in_group, char *repetition)
+{
+    /**
+        * Function Name: parse_alternatives
+        *
+        * Purpose:
+        *    Builds the fragment of one or more sequences separated by "|".
+        *
+        * Parameters:
+        *     PatternReader *reader - The pattern being read.
+        *     Bool in_group - TRUE inside parentheses.
+        *     char *repetition - Receives the repetition after the closing parenthesis of the group.
+        *
+        * Return:
+        *     Fragment - The fragment matching any of the sequences.
+        */
+    Bool more_alternatives;
+    Fragment result = parse_sequence(reader, in_group, repetition, &more_alternatives);
+    while (more_alternatives)
+    {
+        Fragment alternative = parse_sequence(reader, in_group, repetition, &more_alternatives);
+        Fragment choice;
+        choice.start = new_nfa_state();
+        choice.end = new_nfa_state();
+        add_empty_edge(choice.start, result.start);
+        add_empty_edge(choice.start, alternative.start);
+        add_empty_edge(result.end, choice.end);
+        add_empty_edge(alternative.end, choice.end);
+        result = choice;
+    }
+    return result;
+}
+
+static void add_closure(uint64_t *set, int state)
+{
+    /**
+        * Function Name: add_closure
+        *
+        * Purpose:
+        *    Adds an NFA state and every state reachable from it through empty edges to a set.
+        *
+        * Parameters:
+        *     uint64_t *set - The set of NFA states, one bit per state.
+        *     int state - The state to be added.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (set[state / 64] & 1ull << (state % 64))
+        return;
+    set[state / 64] |= 1ull << (state % 64);
+    for (int i = 0; i < nfa[state].empty_count; i++)
+        add_closure(set, nfa[state].empty[i]);
+}
+
+static int find_or_add_dfa_state(uint64_t sets[][GRAMMAR_SET_WORDS], const uint64_t *set)
+{
+    /**
+        * Function Name: find_or_add_dfa_state
+        *
+        * Purpose:
+        *    Returns the DFA state of a set of NFA states, creating it the first time the set is seen.
+        *
+        * Parameters:
+        *     uint64_t sets[][GRAMMAR_SET_WORDS] - The NFA state set of every DFA state so far.
+        *     const uint64_t *set - The set looked for.
+        *
+        * Return:
+        *     int - The DFA state.
+        */
+    for (int d = 0; d < dfa_count; d++)
+    {
+        if (memcmp(sets[d], set, sizeof(uint64_t) * GRAMMAR_SET_WORDS) == 0)
+            return d;
+    }
+    if (dfa_count >= GRAMMAR_MAX_DFA_STATES)
+        grammar_error("too many DFA states", "");
+    memcpy(sets[dfa_count], set, sizeof(uint64_t) * GRAMMAR_SET_WORDS);
+
+    //the earliest rule of the table wins if two rules match the same line
+    dfa_rule[dfa_count] = -1;
+    for (int s = 0; s < nfa_count; s++)
+    {
+        if ((set[s / 64] & 1ull << (s % 64)) && nfa[s].accept_rule >= 0 &&
+            (dfa_rule[dfa_count] < 0 || nfa[s].accept_rule < dfa_rule[dfa_count]))
+            dfa_rule[dfa_count] = nfa[s].accept_rule;
+    }
+    return dfa_count++;
+}
+
+static int find_or_add_action_set(const unsigned char *actions)
+{
+    /**
+        * Function Name: find_or_add_action_set
+        *
+        * Purpose:
+        *    Returns the index of a per-rule action vector, storing it the first time it is seen.
+        *
+        * Parameters:
+        *     const unsigned char *actions - The actions of every rule for one transition.
+        *
+        * Return:
+        *     int - The index of the vector in action_sets.
+        */
+    for (int a = 0; a < action_set_count; a++)
+    {
+        if (memcmp(action_sets[a], actions, RULE_COUNT) == 0)
+            return a;
+    }
+    if (action_set_count >= GRAMMAR_MAX_ACTION_SETS)
+        grammar_error("too many action sets", "");
+    memcpy(action_sets[action_set_count], actions, RULE_COUNT);
+    return action_set_count++;
+}
+
+static void build_grammar()
+{
+    /**
+        * Function Name: build_grammar
+        *
+        * Purpose:
+        *    Turns the grammar table into the token-level automaton run by grammar_parse.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Builds an NFA from the patterns and makes it deterministic with the subset construction.
+        *     - The actions of the NFA edges merged into one DFA transition are merged per rule, so rules sharing
+        *       a prefix do not see each other's actions. Within a rule, the pattern must not be ambiguous.
+        *     - Runs once per process, before the first line is parsed.
+        */
+    static uint64_t sets[GRAMMAR_MAX_DFA_STATES][GRAMMAR_SET_WORDS];
+    uint64_t start[GRAMMAR_SET_WORDS];
+    memset(start, 0, sizeof(start));
+
+    nfa_count = 0;
+    for (int r = 0; r < RULE_COUNT; r++)
+    {
+        building_rule = r;
+        PatternReader reader = {grammar_rules[r].pattern, "", 0};
+        char repetition = '\0';
+        Fragment rule = parse_alternatives(&reader, FALSE, &repetition);
+        nfa[rule.end].accept_rule = r;
+        add_closure(start, rule.start);
+    }
+
+    sign_token = TOKEN_KEYWORD + keyword_index("sign");
+    potion_token = TOKEN_KEYWORD + keyword_index("potion");
+
+    uint64_t empty[GRAMMAR_SET_WORDS];
+    memset(empty, 0, sizeof(empty));
+    dfa_count = 0;
+    action_set_count = 0;
+    find_or_add_dfa_state(sets, empty);
+    find_or_add_dfa_state(sets, start);
+
+    for (int d = 1; d < dfa_count; d++)
+    {
+        for (int c = 0; c < TOKEN_CLASS_COUNT; c++)
+        {
+            uint64_t moved[GRAMMAR_SET_WORDS];
+            memset(moved, 0, sizeof(moved));
+            unsigned char actions[RULE_COUNT];
+            memset(actions, 0, sizeof(actions));
+            for (int s = 0; s < nfa_count; s++)
+            {
+                if ((sets[d][s / 64] & 1ull << (s % 64)) && (nfa[s].classes & 1ull << c))
+                {
+                    add_closure(moved, nfa[s].next);
+                    actions[nfa[s].rule] |= nfa[s].action;
+                }
+            }
+            dfa_next[d][c] = find_or_add_dfa_state(sets, moved);
+            dfa_action_set[d][c] = find_or_add_action_set(actions);
+        }
+    }
+}
+
+static int classify_token(const char *word)
+{
+    /**
+        * Function Name: classify_token
+        *
+        * Purpose:
+        *    Gives the token class of a word of the line.
+        *
+        * Parameters:
+        *     const char *word - The word, as split by the line parser.
+        *
+        * Return:
+        *     int - The token class.
+        */
+    if (word[0] == ',' && word[1] == '\0')
+        return TOKEN_COMMA;
+    if (word[0] == '?' && word[1] == '\0')
+        return TOKEN_QUESTION_MARK;
+    if (word[0] >= '0' && word[0] <= '9')
+    {
+        //a number too large for an int is not a quantity, rather than one wrapped around by atoi()
+        int length = strlen(word);
+        Bool fits = length < 10 || (length == 10 && strcmp(word, "2147483647") <= 0);
+        return is_digit_custom(word) && fits ? TOKEN_NUMBER : TOKEN_OTHER;
+    }
+    int length = strlen(word);
+    if (word[length - 1] == '*')
+    {
+        for (int i = 0; i < length - 1; i++)
+            if (!((word[i] >= 'A' && word[i] <= 'Z') || (word[i] >= 'a' && word[i] <= 'z')))
+                return TOKEN_OTHER;
+        return TOKEN_PREFIX;
+    }
+    if (!is_alphabetic_custom(word))
+        return TOKEN_OTHER;
+
+    int keyword = keyword_index(word);
+    return keyword >= 0 ? TOKEN_KEYWORD + keyword : TOKEN_WORD;
+}
+
+void grammar_begin(LineParser *parser)
+{
+    /**
+        * Function Name: grammar_begin
+        *
+        * Purpose:
+        *    Puts the automaton of a line parser back to the start of a line.
+        *
+        * Parameters:
+        *     LineParser *parser - The parser, whose words are reset by the caller.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Builds the automaton on the first call of the process.
+        */
+    pthread_once(&grammar_once, build_grammar);
+    parser->matched = 0;
+    parser->state = 1;
+    parser->type = -1;
+}
+
+void grammar_match(LineParser *parser, int to)
+{
+    /**
+        * Function Name: grammar_match
+        *
+        * Purpose:
+        *    Runs the words of a line the automaton has not seen yet through it, as soon as they are known.
+        *
+        * Parameters:
+        *     LineParser *parser - The parser.
+        *     int to - The index after the last word to be matched.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Remembers the transition each word took, for grammar_finish.
+        *     - Stops at the first word no rule accepts, the state is 0 from then on.
+        */
+    for (int i = parser->matched; i < to && parser->state != 0; i++)
+    {
+        int token = classify_token(parser->text + parser->word_starts[i]);
+        parser->transitions[i] = dfa_action_set[parser->state][token];
+        parser->state = dfa_next[parser->state][token];
+
+        if (parser->type < 0 && i >= 2 && (token == sign_token || token == potion_token))
+            parser->type = i;
+    }
+    parser->matched = to;
+}
+
+void grammar_finish(LineParser *parser, Command *command)
+{
+    /**
+        * Function Name: grammar_finish
+        *
+        * Purpose:
+        *    Ends the match of a line and extracts its command from the words.
+        *
+        * Parameters:
+        *     LineParser *parser - The parser, every word of the line already matched.
+        *     Command *command - Receives the command, already reset by the caller.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The kind stays COMMAND_INVALID if no rule matches the whole line.
+        */
+    if (parser->state == 0 || dfa_rule[parser->state] < 0)
+        return;
+    int rule_index = dfa_rule[parser->state];
+    const GrammarRule *rule = &grammar_rules[rule_index];
+    const char *text = parser->text;
+    const int *word_starts = parser->word_starts;
+    int word_count = parser->word_count;
+    int type = parser->type;
+
+    //apply the actions of the matched rule, the transitions were taken while the words arrived
+    int quantity = 0;
+    int name_from = -1;
+    int name_to = -1;
+    int target = -1;
+    int potion_from = -1;
+    int spacing_from = -1; // the first word of the name or of a potion of the list
+    for (int i = 0; i <= word_count; i++)
+    {
+        int action = i < word_count ? action_sets[parser->transitions[i]][rule_index] : 0;
+        if (potion_from >= 0 && !(action & ACTION_POTION))
+        {
+            command_add_item_words(command, text, word_starts, potion_from, i, 1);
+            potion_from = -1;
+        }
+        if ((action & ACTION_POTION) && potion_from < 0)
+        {
+            potion_from = i;
+            if (spacing_from < 0)
+                spacing_from = i;
+        }
+        if (action & ACTION_NAME)
+        {
+            if (name_from < 0)
+                name_from = i;
+            name_to = i + 1;
+            if (spacing_from < 0)
+                spacing_from = i;
+        }
+        if (action & ACTION_QUANTITY)
+            quantity = atoi(text + word_starts[i]);
+        if (action & ACTION_COUNT)
+            command->quantity = atoi(text + word_starts[i]);
+        if (action & (ACTION_ITEM | ACTION_TROPHY))
+            command_add_item(command, text + word_starts[i], quantity);
+        if (action & ACTION_TROPHY)
+            command->trophy_count++;
+        if (action & ACTION_TARGET)
+            target = i;
+    }
+
+    if (rule->check_spacing && spacing_from >= 0)
+    {
+        //from the first potion name up to the question mark or the end of the line, words are one space apart
+        for (int i = spacing_from + 1; i < word_count; i++)
+        {
+            if (parser->spaces_before[i] > 1)
+            {
+                command_reset(command);
+                return;
+            }
+            if (text[word_starts[i]] == '?')
+                break;
+        }
+    }
+
+    command->kind = rule->kind;
+    if (rule->name_until_type)
+    {
+        command->name = command_add_words(command, text, word_starts, 2, type);
+        command->is_sign = strcmp(text + word_starts[type], "sign") == 0;
+    }
+    else if (name_from >= 0)
+        command->name = command_add_words(command, text, word_starts, name_from, name_to);
+    if (target >= 0)
+        command->target = command_add_text(command, text + word_starts[target]);
+}
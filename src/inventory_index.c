@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+THREAD_LOCAL InventoryIndex inventory_index[RANK_INVENTORY_COUNT];
+THREAD_LOCAL InventoryIndex formula_index;
+
+static const Ingredient *inventory_items(RankTable table, int *item_count)
+{
+    /**
+        * Function Name: inventory_items
+        *
+        * Purpose:
+        *    Returns the array of an inventory of the calling thread's session.
+        *
+        * Parameters:
+        *     RankTable table - The inventory, of ingredients, potions or trophies.
+        *     int *item_count - Receives the number of items of the array.
+        *
+        * Return:
+        *     const Ingredient * - The array, potions and trophies share the layout of ingredients.
+        */
+    switch (table)
+    {
+    case RANK_POTIONS:
+        *item_count = last_added_potion_index + 1;
+        return (Ingredient *)potions;
+    case RANK_TROPHIES:
+        *item_count = last_added_trophy_index + 1;
+        return (Ingredient *)trophies;
+    default:
+        *item_count = last_added_ingredient_index + 1;
+        return ingredients;
+    }
+}
+
+static int find_bucket(const InventoryIndex *index, const char *items, size_t item_size, const char *name)
+{
+    /**
+        * Function Name: find_bucket
+        *
+        * Purpose:
+        *    Probes the buckets of an index for a name.
+        *
+        * Parameters:
+        *     const InventoryIndex *index - The index, its buckets allocated.
+        *     const char *items - The array of the table, whose items name the buckets and start with a pointer to their name.
+        *     size_t item_size - The size of one item.
+        *     const char *name - The name.
+        *
+        * Return:
+        *     int - The bucket holding the position of the name, or the empty bucket where it belongs.
+        */
+    int bucket = hash_name(name) & (index->bucket_count - 1);
+    while (index->buckets[bucket] >= 0 && strcmp(*(const char *const *)(items + index->buckets[bucket] * item_size), name) != 0)
+        bucket = (bucket + 1) & (index->bucket_count - 1);
+    return bucket;
+}
+
+static int find_position(InventoryIndex *index, const void *table, size_t item_size, int item_count, const char *name)
+{
+    /**
+        * Function Name: find_position
+        *
+        * Purpose:
+        *    Files the items added to a table since the index last looked at it, then looks a name up.
+        *
+        * Parameters:
+        *     InventoryIndex *index - The index.
+        *     const void *table - The array of the table, whose items start with a pointer to their name.
+        *     size_t item_size - The size of one item.
+        *     int item_count - The number of items of the array.
+        *     const char *name - The name.
+        *
+        * Return:
+        *     int - The position of the item with the name, -1 if there is none.
+        *
+        * Side Effects:
+        *     - Starts over when the table was reordered or emptied since.
+        *     - Allocates the buckets on first use, then doubles them and refiles every item
+        *       when they are half full.
+        */
+    const char *items = table;
+    if (index->reordered || index->count > item_count)
+    {
+        index->count = 0;
+        index->reordered = FALSE;
+        if (index->buckets != NULL)
+            memset(index->buckets, -1, index->bucket_count * sizeof(int));
+    }
+    if (index->count < item_count && (index->buckets == NULL || 2 * item_count > index->bucket_count))
+    {
+        int bucket_count = index->buckets == NULL ? 64 : index->bucket_count;
+        while (2 * item_count > bucket_count)
+            bucket_count *= 2;
+        mem_free(MEM_INVENTORY_INDEX, index->buckets, index->bucket_count * sizeof(int));
+        index->buckets = mem_malloc(MEM_INVENTORY_INDEX, bucket_count * sizeof(int));
+        index->bucket_count = bucket_count;
+        memset(index->buckets, -1, bucket_count * sizeof(int));
+        index->count = 0;
+    }
+
+    for (; index->count < item_count; index->count++)
+        index->buckets[find_bucket(index, items, item_size, *(const char *const *)(items + index->count * item_size))] = index->count;
+    if (index->buckets == NULL)
+        return -1;
+    return index->buckets[find_bucket(index, items, item_size, name)];
+}
+
+int inventory_index_find(RankTable table, const char *name)
+{
+    /**
+        * Function Name: inventory_index_find
+        *
+        * Purpose:
+        *    Finds the position of a name in an inventory of the calling thread's session.
+        *
+        * Parameters:
+        *     RankTable table - The inventory, of ingredients, potions or trophies.
+        *     const char *name - The name.
+        *
+        * Return:
+        *     int - The position of the item in its array, -1 if the inventory has no item with the name.
+        *
+        * Side Effects:
+        *     - Items are appended at the end of their array, so the ones added since the last call are filed first,
+        *       which spares every place adding an item from telling the index.
+        *     - Takes O(1) expected time once the items are filed.
+        */
+    int item_count;
+    const Ingredient *items = inventory_items(table, &item_count);
+    return find_position(&inventory_index[table], items, sizeof(Ingredient), item_count, name);
+}
+
+int formula_index_find(const char *name)
+{
+    /**
+        * Function Name: formula_index_find
+        *
+        * Purpose:
+        *    Finds the position of a potion in the formulas of the calling thread's session.
+        *
+        * Parameters:
+        *     const char *name - The name of the potion.
+        *
+        * Return:
+        *     int - The position of its formula, -1 if the session learned no formula for it.
+        *
+        * Side Effects:
+        *     - Formulas are filed like the items of an inventory, on the first lookup after they are learned.
+        */
+    return find_position(&formula_index, formulas, sizeof(PotionFormula), last_added_formula_index + 1, name);
+}
+
+void inventory_index_reordered(RankTable table)
+{
+    /**
+        * Function Name: inventory_index_reordered
+        *
+        * Purpose:
+        *    Tells the index that the items of an inventory were moved, such as by sorting them by name.
+        *
+        * Parameters:
+        *     RankTable table - The inventory.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The items are filed again on the next lookup.
+        */
+    inventory_index[table].reordered = TRUE;
+}
+
+void formula_index_reordered()
+{
+    /**
+        * Function Name: formula_index_reordered
+        *
+        * Purpose:
+        *    Tells the index that the formulas were moved, such as by sorting them by name.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    formula_index.reordered = TRUE;
+}
+
+void inventory_index_free()
+{
+    /**
+        * Function Name: inventory_index_free
+        *
+        * Purpose:
+        *    Releases the calling thread's inventory and formula indexes.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The next session on the thread starts with empty indexes.
+        */
+    for (int t = 0; t < RANK_INVENTORY_COUNT; t++)
+    {
+        mem_free(MEM_INVENTORY_INDEX, inventory_index[t].buckets, inventory_index[t].bucket_count * sizeof(int));
+        memset(&inventory_index[t], 0, sizeof(InventoryIndex));
+    }
+    mem_free(MEM_INVENTORY_INDEX, formula_index.buckets, formula_index.bucket_count * sizeof(int));
+    memset(&formula_index, 0, sizeof(InventoryIndex));
+}
@@ -0,0 +1,790 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "globals.h"
+
+const KnowledgeBase *knowledge_base;
+
+static KnowledgeBase mapped_knowledge_base;
+static THREAD_LOCAL PotionFormula kb_formula_view;
+
+static int cmp_kb_number(const void *key, const void *entry)
+{
+    /**
+        * Function Name: cmp_kb_number
+        *
+        * Purpose:
+        *    Compares a name number with the name number at the start of a knowledge base entry, for bsearch.
+        *
+        * Parameters:
+        *     const void *key - The number searched for.
+        *     const void *entry - The KbFormula, KbMonster or KbItem, all start with the number of their name.
+        *
+        * Return:
+        *     int - Negative if the number comes before the entry, positive if after, zero if equal.
+        */
+    int first = *(const int *)key;
+    int second = *(const int *)entry;
+    return (first > second) - (first < second);
+}
+
+static int cmp_kb_requirement(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmp_kb_requirement
+        *
+        * Purpose:
+        *    Orders knowledge base requirements by ingredient name, then by required quantity, then by formula.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first requirement.
+        *     const void *b - Pointer to the second requirement.
+        *
+        * Return:
+        *     int - Negative if a < b, positive if a > b, zero if equal.
+        */
+    const KbRequirement *first = a;
+    const KbRequirement *second = b;
+    //names are numbered in name order
+    if (first->ingredient != second->ingredient)
+        return (first->ingredient > second->ingredient) - (first->ingredient < second->ingredient);
+    if (first->required != second->required)
+        return (first->required > second->required) - (first->required < second->required);
+    return (first->formula > second->formula) - (first->formula < second->formula);
+}
+
+static int cmp_kb_effect(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmp_kb_effect
+        *
+        * Purpose:
+        *    Orders knowledge base effects by sign or potion name, then by monster.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first effect.
+        *     const void *b - Pointer to the second effect.
+        *
+        * Return:
+        *     int - Negative if a < b, positive if a > b, zero if equal.
+        */
+    const KbEffect *first = a;
+    const KbEffect *second = b;
+    if (first->name != second->name)
+        return (first->name > second->name) - (first->name < second->name);
+    return (first->monster > second->monster) - (first->monster < second->monster);
+}
+
+static int cmp_name_pointer(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmp_name_pointer
+        *
+        * Purpose:
+        *    Orders pointers to names by name, for qsort.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first name.
+        *     const void *b - Pointer to the second name.
+        *
+        * Return:
+        *     int - Negative if a < b, positive if a > b, zero if equal.
+        */
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static int add_item_names(const char **names, int count, const Ingredient *items, int item_count)
+{
+    /**
+        * Function Name: add_item_names
+        *
+        * Purpose:
+        *    Adds the names of the ingredients of a formula, or of the signs or potions of a monster, to a list.
+        *
+        * Parameters:
+        *     const char **names - The list.
+        *     int count - The number of names in the list.
+        *     const Ingredient *items - The items, signs and potions have the same layout.
+        *     int item_count - The number of items.
+        *
+        * Return:
+        *     int - The new number of names in the list.
+        */
+    for (int i = 0; i < item_count; i++)
+        names[count++] = items[i].name;
+    return count;
+}
+
+static int name_number(const char *const *names, int count, const char *name)
+{
+    /**
+        * Function Name: name_number
+        *
+        * Purpose:
+        *    Finds the number of a name in the sorted names of a knowledge base being written.
+        *
+        * Parameters:
+        *     const char *const *names - The names, sorted and each once.
+        *     int count - The number of names.
+        *     const char *name - The name, one of them.
+        *
+        * Return:
+        *     int - The number of the name.
+        */
+    const char *const *found = bsearch(&name, names, count, sizeof(const char *), cmp_name_pointer);
+    return (int)(found - names);
+}
+
+static Bool write_kb_items(FILE *output, const char *const *names, int name_count, const Ingredient *items, int count)
+{
+    /**
+        * Function Name: write_kb_items
+        *
+        * Purpose:
+        *    Writes the ingredients of a formula, or the signs or potions of a monster, as knowledge base items.
+        *
+        * Parameters:
+        *     FILE *output - The file being written.
+        *     const char *const *names - The names of the knowledge base, sorted and each once.
+        *     int name_count - The number of names.
+        *     const Ingredient *items - The items, signs and potions have the same layout.
+        *     int count - The number of items.
+        *
+        * Return:
+        *     Bool - TRUE if every item was written, FALSE otherwise.
+        */
+    for (int i = 0; i < count; i++)
+    {
+        KbItem item = {name_number(names, name_count, items[i].name), items[i].quantity};
+        if (fwrite(&item, sizeof(KbItem), 1, output) != 1)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static Bool write_knowledge_base(FILE *output)
+{
+    /**
+        * Function Name: write_knowledge_base
+        *
+        * Purpose:
+        *    Writes the calling thread's formulas and monsters in the knowledge base layout.
+        *
+        * Parameters:
+        *     FILE *output - The file to be written.
+        *
+        * Return:
+        *     Bool - TRUE if every section was written, FALSE otherwise.
+        *
+        * Side Effects:
+        *     - Sorts the thread's formulas and monsters by name, so they can be binary searched once mapped.
+        *     - Every name of the tables is numbered in name order and front coded once in the name dictionary.
+        *     - The requirements of the formulas and the effects of the monsters are written sorted, ready to be
+        *       searched in place once mapped.
+        */
+    qsort(formulas, last_added_formula_index + 1, sizeof(PotionFormula), cmpFormula);
+    formula_index_reordered();
+    qsort(monsters, last_added_monster_index + 1, sizeof(Monster), cmpMonster);
+
+    KbHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KB_MAGIC, sizeof(header.magic));
+    header.version = KB_VERSION;
+    header.formula_count = last_added_formula_index + 1;
+    header.monster_count = last_added_monster_index + 1;
+    for (int i = 0; i < header.formula_count; i++)
+        header.ingredient_count += formulas[i].ingredient_count;
+    for (int i = 0; i < header.monster_count; i++)
+    {
+        header.sign_count += monsters[i].sign_count;
+        header.potion_count += monsters[i].potion_count;
+    }
+
+    //every name of the tables, sorted, then each kept once
+    int name_count = header.formula_count + header.monster_count + header.ingredient_count + header.sign_count + header.potion_count;
+    const char **names = malloc((name_count + 1) * sizeof(const char *));
+    name_count = 0;
+    for (int i = 0; i < header.formula_count; i++)
+    {
+        names[name_count++] = formulas[i].name;
+        name_count = add_item_names(names, name_count, formulas[i].ingredients, formulas[i].ingredient_count);
+    }
+    for (int i = 0; i < header.monster_count; i++)
+    {
+        names[name_count++] = monsters[i].name;
+        name_count = add_item_names(names, name_count, (const Ingredient *)monsters[i].signs, monsters[i].sign_count);
+        name_count = add_item_names(names, name_count, (const Ingredient *)monsters[i].potions, monsters[i].potion_count);
+    }
+    qsort(names, name_count, sizeof(const char *), cmp_name_pointer);
+    int unique = 0;
+    for (int i = 0; i < name_count; i++)
+        if (unique == 0 || strcmp(names[unique - 1], names[i]) != 0)
+            names[unique++] = names[i];
+    header.name_count = unique;
+
+    int *block_offsets = malloc((NAME_DICT_BLOCK_COUNT(unique) + 1) * sizeof(int));
+    char *blocks = name_dict_encode(names, unique, block_offsets, &header.dictionary_length);
+
+    KbFormula *kb_formulas = calloc(header.formula_count + 1, sizeof(KbFormula));
+    int first_item = 0;
+    for (int i = 0; i < header.formula_count; i++)
+    {
+        kb_formulas[i].name = name_number(names, unique, formulas[i].name);
+        kb_formulas[i].first_ingredient = first_item;
+        kb_formulas[i].ingredient_count = formulas[i].ingredient_count;
+        first_item += formulas[i].ingredient_count;
+    }
+
+    KbMonster *kb_monsters = calloc(header.monster_count + 1, sizeof(KbMonster));
+    int first_sign = 0;
+    int first_potion = 0;
+    for (int i = 0; i < header.monster_count; i++)
+    {
+        kb_monsters[i].name = name_number(names, unique, monsters[i].name);
+        kb_monsters[i].first_sign = first_sign;
+        kb_monsters[i].sign_count = monsters[i].sign_count;
+        kb_monsters[i].first_potion = first_potion;
+        kb_monsters[i].potion_count = monsters[i].potion_count;
+        first_sign += monsters[i].sign_count;
+        first_potion += monsters[i].potion_count;
+    }
+
+    //the reverse index from ingredient to formulas is sorted here once, rather than by every process mapping the file
+    KbRequirement *requirements = malloc((header.ingredient_count + 1) * sizeof(KbRequirement));
+    int requirement_count = 0;
+    for (int i = 0; i < header.formula_count; i++)
+    {
+        for (int j = 0; j < formulas[i].ingredient_count; j++)
+        {
+            requirements[requirement_count].required = formulas[i].ingredients[j].quantity;
+            requirements[requirement_count].formula = i;
+            requirements[requirement_count].ingredient = name_number(names, unique, formulas[i].ingredients[j].name);
+            requirement_count++;
+        }
+    }
+    qsort(requirements, requirement_count, sizeof(KbRequirement), cmp_kb_requirement);
+
+    //and so is the reverse index from sign or potion to monsters
+    KbEffect *effects = malloc((header.sign_count + header.potion_count + 1) * sizeof(KbEffect));
+    int effect_count = 0;
+    for (int i = 0; i < header.monster_count; i++)
+    {
+        for (int j = 0; j < monsters[i].sign_count; j++)
+        {
+            effects[effect_count].name = name_number(names, unique, monsters[i].signs[j].name);
+            effects[effect_count++].monster = i;
+        }
+        for (int j = 0; j < monsters[i].potion_count; j++)
+        {
+            effects[effect_count].name = name_number(names, unique, monsters[i].potions[j].name);
+            effects[effect_count++].monster = i;
+        }
+    }
+    qsort(effects, effect_count, sizeof(KbEffect), cmp_kb_effect);
+
+    Bool written = fwrite(&header, sizeof(header), 1, output) == 1;
+    written = written && fwrite(kb_formulas, sizeof(KbFormula), header.formula_count, output) == (size_t)header.formula_count;
+    written = written && fwrite(kb_monsters, sizeof(KbMonster), header.monster_count, output) == (size_t)header.monster_count;
+    for (int i = 0; written && i < header.formula_count; i++)
+        written = write_kb_items(output, names, unique, formulas[i].ingredients, formulas[i].ingredient_count);
+    for (int i = 0; written && i < header.monster_count; i++)
+        written = write_kb_items(output, names, unique, (const Ingredient *)monsters[i].signs, monsters[i].sign_count);
+    for (int i = 0; written && i < header.monster_count; i++)
+        written = write_kb_items(output, names, unique, (const Ingredient *)monsters[i].potions, monsters[i].potion_count);
+    written = written && fwrite(requirements, sizeof(KbRequirement), requirement_count, output) == (size_t)requirement_count;
+    written = written && fwrite(effects, sizeof(KbEffect), effect_count, output) == (size_t)effect_count;
+    written = written && fwrite(block_offsets, sizeof(int), NAME_DICT_BLOCK_COUNT(unique), output) == (size_t)NAME_DICT_BLOCK_COUNT(unique);
+    written = written && fwrite(blocks, 1, header.dictionary_length, output) == (size_t)header.dictionary_length;
+
+    free(kb_formulas);
+    free(kb_monsters);
+    free(requirements);
+    free(effects);
+    free(block_offsets);
+    free(blocks);
+    free(names);
+    return written;
+}
+
+int compile_knowledge_base(const char *input_path, const char *output_path)
+{
+    /**
+        * Function Name: compile_knowledge_base
+        *
+        * Purpose:
+        *    Learns every formula and effectiveness of a knowledge file and writes them as a binary knowledge base.
+        *
+        * Parameters:
+        *     const char *input_path - The knowledge file, lines in the LEARN sentence grammar.
+        *     const char *output_path - The knowledge base file to be written.
+        *
+        * Return:
+        *     int - 0 on success, 1 if a file could not be read or written.
+        *
+        * Side Effects:
+        *     - The LEARN sentences go through the same parser and handlers as in a session, other lines are skipped.
+        *     - Prints the number of formulas, monsters and skipped lines to stderr.
+        */
+    FILE *input = fopen(input_path, "r");
+    if (!input)
+    {
+        fprintf(stderr, "Cannot open %s\n", input_path);
+        return 1;
+    }
+
+    init_state();
+    OutputBuffer responses = {NULL, 0, 0};
+    output_buffer = &responses;
+
+    int skipped = 0;
+    while (read_command(input, &line_command, FALSE))
+    {
+        if (line_command.kind != COMMAND_LEARN_FORMULA && line_command.kind != COMMAND_LEARN_EFFECTIVENESS)
+        {
+            skipped++;
+            continue;
+        }
+        //the responses are not needed, only the learned tables
+        responses.length = 0;
+        execute_command(&line_command);
+    }
+    fclose(input);
+    output_buffer = NULL;
+    free(responses.data);
+
+    FILE *output = fopen(output_path, "wb");
+    Bool written = output != NULL && write_knowledge_base(output);
+    if (output != NULL && fclose(output) != 0)
+        written = FALSE;
+
+    if (written)
+        fprintf(stderr, "Compiled %d formulas and %d monsters into %s, %d lines skipped\n",
+                last_added_formula_index + 1, last_added_monster_index + 1, output_path, skipped);
+    else
+        fprintf(stderr, "Cannot write %s\n", output_path);
+
+    free_state();
+    return written ? 0 : 1;
+}
+
+Bool load_knowledge_base(const char *path)
+{
+    /**
+        * Function Name: load_knowledge_base
+        *
+        * Purpose:
+        *    Maps a compiled knowledge base as the base layer under every session's formulas and monsters.
+        *
+        * Parameters:
+        *     const char *path - The file written by compile_knowledge_base.
+        *
+        * Return:
+        *     Bool - TRUE if the file was mapped, FALSE if it is missing or not a knowledge base of this build.
+        *
+        * Side Effects:
+        *     - Maps the file read-only and shared, so every process using the same file shares its pages.
+        *     - The records, the reverse indexes and the front coded names are used in place, nothing is built in
+        *       memory. The names and the items presented as session tables are decoded when first used.
+        *     - Loading takes the same time whatever the size of the file, the header and the ends of the sections
+        *       are checked but the records are not read.
+        *     - Sets knowledge_base, must be called before any session thread starts.
+        */
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return FALSE;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(KbHeader))
+    {
+        fprintf(stderr, "%s is not a knowledge base\n", path);
+        close(fd);
+        return FALSE;
+    }
+
+    const char *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot map %s\n", path);
+        return FALSE;
+    }
+
+    //the sections are laid out in this build's struct layouts, so a file of another version is refused
+    const KbHeader *header = (const KbHeader *)map;
+    Bool valid = memcmp(header->magic, KB_MAGIC, sizeof(header->magic)) == 0 && header->version == KB_VERSION &&
+                 header->formula_count >= 0 && header->monster_count >= 0 && header->ingredient_count >= 0 &&
+                 header->sign_count >= 0 && header->potion_count >= 0 && header->name_count >= 0 && header->dictionary_length >= 0;
+    size_t item_count = valid ? (size_t)header->ingredient_count + header->sign_count + header->potion_count : 0;
+    if (valid)
+    {
+        size_t expected = sizeof(KbHeader) + (size_t)header->formula_count * sizeof(KbFormula) +
+                          (size_t)header->monster_count * sizeof(KbMonster) + item_count * sizeof(KbItem) +
+                          (size_t)header->ingredient_count * sizeof(KbRequirement) +
+                          ((size_t)header->sign_count + header->potion_count) * sizeof(KbEffect) +
+                          (size_t)NAME_DICT_BLOCK_COUNT(header->name_count) * sizeof(int) + (size_t)header->dictionary_length;
+        valid = expected == (size_t)info.st_size;
+    }
+    const KbFormula *kb_formulas = (const KbFormula *)(header + 1);
+    const KbMonster *kb_monsters = (const KbMonster *)(kb_formulas + (valid ? header->formula_count : 0));
+    const KbItem *items = (const KbItem *)(kb_monsters + (valid ? header->monster_count : 0));
+    const KbRequirement *requirements = (const KbRequirement *)(items + item_count);
+    int effect_count = valid ? header->sign_count + header->potion_count : 0;
+    const KbEffect *effects = (const KbEffect *)(requirements + (valid ? header->ingredient_count : 0));
+    NameDict names;
+    memset(&names, 0, sizeof(names));
+    names.block_offsets = (const int *)(effects + effect_count);
+    names.blocks = (const char *)(names.block_offsets + (valid ? NAME_DICT_BLOCK_COUNT(header->name_count) : 0));
+    names.name_count = valid ? header->name_count : 0;
+
+    //the records were checked by the compiler that wrote them, so only the ends of the sections are checked here,
+    //which catches a file cut short or laid out differently without reading every page of it
+    int formula_count = valid ? header->formula_count : 0;
+    int monster_count = valid ? header->monster_count : 0;
+    int block_count = NAME_DICT_BLOCK_COUNT(names.name_count);
+    valid = valid && (formula_count == 0 ? header->ingredient_count == 0 :
+                      kb_formulas[0].first_ingredient == 0 &&
+                      (long long)kb_formulas[formula_count - 1].first_ingredient + kb_formulas[formula_count - 1].ingredient_count == header->ingredient_count);
+    valid = valid && (monster_count == 0 ? header->sign_count == 0 && header->potion_count == 0 :
+                      kb_monsters[0].first_sign == 0 && kb_monsters[0].first_potion == 0 &&
+                      (long long)kb_monsters[monster_count - 1].first_sign + kb_monsters[monster_count - 1].sign_count == header->sign_count &&
+                      (long long)kb_monsters[monster_count - 1].first_potion + kb_monsters[monster_count - 1].potion_count == header->potion_count);
+    valid = valid && (block_count == 0 ? header->dictionary_length == 0 :
+                      names.block_offsets[0] == 0 && names.block_offsets[block_count - 1] >= 0 &&
+                      names.block_offsets[block_count - 1] < header->dictionary_length && names.blocks[header->dictionary_length - 1] == '\0');
+    if (!valid)
+    {
+        fprintf(stderr, "%s is not a knowledge base of this version\n", path);
+        munmap((void *)map, info.st_size);
+        return FALSE;
+    }
+
+    KnowledgeBase *kb = &mapped_knowledge_base;
+    kb->formula_count = header->formula_count;
+    kb->monster_count = header->monster_count;
+    kb->formulas = kb_formulas;
+    kb->monsters = kb_monsters;
+    kb->ingredients = items;
+    kb->signs = items + header->ingredient_count;
+    kb->potions = kb->signs + header->sign_count;
+    kb->names = names;
+    kb->names.decoded = calloc(NAME_DICT_BLOCK_COUNT(header->name_count) + 1, sizeof(char *));
+    kb->decoded_items = calloc(header->formula_count + 2 * (size_t)header->monster_count + 1, sizeof(Ingredient *));
+    kb->requirements = requirements;
+    kb->requirement_count = header->ingredient_count;
+    kb->effects = effects;
+    kb->effect_count = effect_count;
+    knowledge_base = kb;
+    return TRUE;
+}
+
+const char *kb_name(int name)
+{
+    /**
+        * Function Name: kb_name
+        *
+        * Purpose:
+        *    Returns a name of the knowledge base from its number.
+        *
+        * Parameters:
+        *     int name - The number of the name in the name dictionary.
+        *
+        * Return:
+        *     const char * - The name, which stays in place for the rest of the process.
+        */
+    return name_dict_name(&knowledge_base->names, name);
+}
+
+static const Ingredient *decoded_items(int slot, const KbItem *items, int count)
+{
+    /**
+        * Function Name: decoded_items
+        *
+        * Purpose:
+        *    Presents a list of knowledge base items like the items of a session table.
+        *
+        * Parameters:
+        *     int slot - Where the list is kept once decoded, a formula, or the signs or potions of a monster.
+        *     const KbItem *items - The items.
+        *     int count - The number of items.
+        *
+        * Return:
+        *     const Ingredient * - The items with their names, which stay in place for the rest of the process.
+        *
+        * Side Effects:
+        *     - Decoded on first use, threads decoding the same list at once each decode it, the first
+        *       to publish its copy wins and the others free theirs.
+        */
+    Ingredient *decoded = atomic_load_explicit(&knowledge_base->decoded_items[slot], memory_order_acquire);
+    if (decoded != NULL)
+        return decoded;
+
+    Ingredient *expected = NULL;
+    decoded = malloc((count + 1) * sizeof(Ingredient));
+    for (int i = 0; i < count; i++)
+    {
+        decoded[i].name = kb_name(items[i].name);
+        decoded[i].quantity = items[i].quantity;
+    }
+    if (!atomic_compare_exchange_strong_explicit(&knowledge_base->decoded_items[slot], &expected, decoded, memory_order_acq_rel, memory_order_acquire))
+    {
+        free(decoded);
+        decoded = expected;
+    }
+    return decoded;
+}
+
+const Sign *kb_monster_signs(const KbMonster *monster)
+{
+    /**
+        * Function Name: kb_monster_signs
+        *
+        * Purpose:
+        *    Returns the signs effective against a knowledge base monster, like those of a session monster.
+        *
+        * Parameters:
+        *     const KbMonster *monster - The monster.
+        *
+        * Return:
+        *     const Sign * - Its sign_count signs in name order, which must not be modified.
+        */
+    int position = monster - knowledge_base->monsters;
+    return (const Sign *)decoded_items(knowledge_base->formula_count + 2 * position, &knowledge_base->signs[monster->first_sign], monster->sign_count);
+}
+
+const Potion *kb_monster_potions(const KbMonster *monster)
+{
+    /**
+        * Function Name: kb_monster_potions
+        *
+        * Purpose:
+        *    Returns the potions effective against a knowledge base monster, like those of a session monster.
+        *
+        * Parameters:
+        *     const KbMonster *monster - The monster.
+        *
+        * Return:
+        *     const Potion * - Its potion_count potions in name order, which must not be modified.
+        */
+    int position = monster - knowledge_base->monsters;
+    return (const Potion *)decoded_items(knowledge_base->formula_count + 2 * position + 1, &knowledge_base->potions[monster->first_potion], monster->potion_count);
+}
+
+const KbFormula *kb_find_formula(const char *potion_name)
+{
+    /**
+        * Function Name: kb_find_formula
+        *
+        * Purpose:
+        *    Looks up a formula in the knowledge base.
+        *
+        * Parameters:
+        *     const char *potion_name - The name of the potion.
+        *
+        * Return:
+        *     const KbFormula * - The formula, NULL if not found or no knowledge base is loaded.
+        */
+    if (knowledge_base == NULL)
+        return NULL;
+    //the formulas are in name order, so in the order of the numbers of their names
+    int name = name_dict_find(&knowledge_base->names, potion_name);
+    if (name < 0)
+        return NULL;
+    return bsearch(&name, knowledge_base->formulas, knowledge_base->formula_count, sizeof(KbFormula), cmp_kb_number);
+}
+
+PotionFormula *kb_get_formula(const char *potion_name)
+{
+    /**
+        * Function Name: kb_get_formula
+        *
+        * Purpose:
+        *    Looks up a formula in the knowledge base and presents it like a formula of the session.
+        *
+        * Parameters:
+        *     const char *potion_name - The name of the potion.
+        *
+        * Return:
+        *     PotionFormula * - A read-only view of the formula, NULL if not found.
+        *
+        * Side Effects:
+        *     - The view belongs to the calling thread and is overwritten by its next call.
+        *     - The ingredients of the view are decoded once for the whole process and must not be modified.
+        */
+    const KbFormula *formula = kb_find_formula(potion_name);
+    if (formula == NULL)
+        return NULL;
+
+    int position = formula - knowledge_base->formulas;
+    kb_formula_view.name = kb_name(formula->name);
+    kb_formula_view.ingredients = (Ingredient *)decoded_items(position, &knowledge_base->ingredients[formula->first_ingredient], formula->ingredient_count);
+    kb_formula_view.ingredient_count = formula->ingredient_count;
+    kb_formula_view.ingredient_capacity = formula->ingredient_count;
+    return &kb_formula_view;
+}
+
+const KbRequirement *kb_find_requirements(const char *ingredient_name, int *count)
+{
+    /**
+        * Function Name: kb_find_requirements
+        *
+        * Purpose:
+        *    Looks up the knowledge base formulas requiring an ingredient.
+        *
+        * Parameters:
+        *     const char *ingredient_name - The name of the ingredient.
+        *     int *count - Receives the number of requirements.
+        *
+        * Return:
+        *     const KbRequirement * - The first requirement, in required quantity order, NULL if there is none.
+        */
+    *count = 0;
+    if (knowledge_base == NULL)
+        return NULL;
+    int name = name_dict_find(&knowledge_base->names, ingredient_name);
+    if (name < 0)
+        return NULL;
+
+    //the requirements of one ingredient are adjacent, the first is found by binary search
+    int low = 0;
+    int high = knowledge_base->requirement_count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (knowledge_base->requirements[middle].ingredient < name)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    int end = low;
+    while (end < knowledge_base->requirement_count && knowledge_base->requirements[end].ingredient == name)
+        end++;
+    *count = end - low;
+    return *count > 0 ? &knowledge_base->requirements[low] : NULL;
+}
+
+const KbEffect *kb_find_effects(const char *name, int *count)
+{
+    /**
+        * Function Name: kb_find_effects
+        *
+        * Purpose:
+        *    Looks up the knowledge base monsters a sign or potion is effective against.
+        *
+        * Parameters:
+        *     const char *name - The name of the sign or potion.
+        *     int *count - Receives the number of effects.
+        *
+        * Return:
+        *     const KbEffect * - The first effect, NULL if there is none.
+        */
+    *count = 0;
+    if (knowledge_base == NULL)
+        return NULL;
+    int number = name_dict_find(&knowledge_base->names, name);
+    if (number < 0)
+        return NULL;
+
+    int low = 0;
+    int high = knowledge_base->effect_count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (knowledge_base->effects[middle].name < number)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    int end = low;
+    while (end < knowledge_base->effect_count && knowledge_base->effects[end].name == number)
+        end++;
+    *count = end - low;
+    return *count > 0 ? &knowledge_base->effects[low] : NULL;
+}
+
+const KbMonster *kb_find_monster(const char *monster_name)
+{
+    /**
+        * Function Name: kb_find_monster
+        *
+        * Purpose:
+        *    Looks up a monster in the knowledge base.
+        *
+        * Parameters:
+        *     const char *monster_name - The name of the monster.
+        *
+        * Return:
+        *     const KbMonster * - The monster, NULL if not found or no knowledge base is loaded.
+        */
+    if (knowledge_base == NULL)
+        return NULL;
+    int name = name_dict_find(&knowledge_base->names, monster_name);
+    if (name < 0)
+        return NULL;
+    return bsearch(&name, knowledge_base->monsters, knowledge_base->monster_count, sizeof(KbMonster), cmp_kb_number);
+}
+
+int kb_first_monster_from(const char *name)
+{
+    /**
+        * Function Name: kb_first_monster_from
+        *
+        * Purpose:
+        *    Finds the first knowledge base monster whose name is not smaller than a name.
+        *
+        * Parameters:
+        *     const char *name - The name, a prefix finds the first monster starting with it.
+        *
+        * Return:
+        *     int - The position of the monster, the number of monsters if every name is smaller or none is loaded.
+        */
+    if (knowledge_base == NULL)
+        return 0;
+    int number = name_dict_first_from(&knowledge_base->names, name);
+    int low = 0;
+    int high = knowledge_base->monster_count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (knowledge_base->monsters[middle].name < number)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+Bool kb_knows_effectiveness(const KbMonster *monster, const char *name, Bool is_sign)
+{
+    /**
+        * Function Name: kb_knows_effectiveness
+        *
+        * Purpose:
+        *    Checks if the knowledge base already lists a sign or potion as effective against a monster.
+        *
+        * Parameters:
+        *     const KbMonster *monster - The monster, may be NULL.
+        *     const char *name - The name of the sign or potion.
+        *     Bool is_sign - TRUE for a sign, FALSE for a potion.
+        *
+        * Return:
+        *     Bool - TRUE if it is listed, FALSE otherwise.
+        */
+    if (monster == NULL)
+        return FALSE;
+    int number = name_dict_find(&knowledge_base->names, name);
+    if (number < 0)
+        return FALSE;
+
+    //the lists are in name order, as learn_effectiveness keeps them, so in the order of the numbers
+    const KbItem *effective = is_sign ? &knowledge_base->signs[monster->first_sign] : &knowledge_base->potions[monster->first_potion];
+    int count = is_sign ? monster->sign_count : monster->potion_count;
+    return bsearch(&number, effective, count, sizeof(KbItem), cmp_kb_number) != NULL;
+}
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+// kept from one line to the next, so splitting a line allocates nothing once the arrays are large enough
+static THREAD_LOCAL LineParser line_parser;
+
+static void ensure_text_capacity(LineParser *parser, int extra)
+{
+    /**
+        * Function Name: ensure_text_capacity
+        *
+        * Purpose:
+        *    Makes room for more characters in the words of the line.
+        *
+        * Parameters:
+        *     LineParser *parser - The parser.
+        *     int extra - The number of characters to be appended.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Doubles the capacity of the text until they fit.
+        */
+    if (parser->text_length + extra > parser->text_capacity)
+    {
+        while (parser->text_length + extra > parser->text_capacity)
+            parser->text_capacity = parser->text_capacity == 0 ? 256 : parser->text_capacity * 2;
+        parser->text = realloc(parser->text, parser->text_capacity);
+    }
+}
+
+static void start_word(LineParser *parser)
+{
+    /**
+        * Function Name: start_word
+        *
+        * Purpose:
+        *    Adds an empty word to the line, after the spaces read since the last one.
+        *
+        * Parameters:
+        *     LineParser *parser - The parser.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Doubles the capacity of the word arrays if they are full.
+        *     - The terminator of the word is the last character of the text until the next word starts.
+        */
+    if (parser->word_count >= parser->word_capacity)
+    {
+        parser->word_capacity = parser->word_capacity == 0 ? 64 : parser->word_capacity * 2;
+        parser->word_starts = realloc(parser->word_starts, parser->word_capacity * sizeof(int));
+        parser->spaces_before = realloc(parser->spaces_before, parser->word_capacity * sizeof(int));
+        parser->transitions = realloc(parser->transitions, parser->word_capacity);
+    }
+    ensure_text_capacity(parser, 1);
+    parser->word_starts[parser->word_count] = parser->text_length;
+    parser->text[parser->text_length++] = '\0';
+    parser->spaces_before[parser->word_count] = parser->spaces;
+    parser->spaces = 0;
+    parser->word_count++;
+    parser->word_length = 0;
+}
+
+void line_parser_begin()
+{
+    /**
+        * Function Name: line_parser_begin
+        *
+        * Purpose:
+        *    Starts a new line on the calling thread's line parser.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The words of the previous line are dropped, their arrays are kept for the next one.
+        */
+    LineParser *parser = &line_parser;
+    parser->word_count = 0;
+    parser->text_length = 0;
+    parser->word_length = -1;
+    parser->spaces = 0;
+    parser->last_solid = -1;
+    parser->solid_length = 0;
+    grammar_begin(parser);
+}
+
+void line_parser_feed(const char *chunk, int length)
+{
+    /**
+        * Function Name: line_parser_feed
+        *
+        * Purpose:
+        *    Splits the next characters of the line into words and matches those that are complete.
+        *
+        * Parameters:
+        *     const char *chunk - The characters, a newline ends the line and what follows it is ignored.
+        *     int length - The number of characters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Splits the same way as the whole line would be: spaces separate words, commas and question marks
+        *       are words of their own and the spaces and tabs at the end of the line are dropped.
+        *     - A word is matched once a later character shows it does not end the line, trailing tabs included.
+        *     - Once no rule can match the line, the rest of it is skipped and nothing more is stored.
+        */
+    LineParser *parser = &line_parser;
+    const char *end = chunk + length;
+    const char *c = chunk;
+    while (c < end && parser->state != 0 && *c != '\n')
+    {
+        if (*c == ' ')
+        {
+            parser->spaces++;
+            parser->word_length = -1;
+            c++;
+            continue;
+        }
+
+        if (*c == ',' || *c == '?')
+        {
+            start_word(parser);
+            ensure_text_capacity(parser, 1);
+            parser->text[parser->text_length - 1] = *c++;
+            parser->text[parser->text_length++] = '\0';
+            parser->word_length = -1;
+            parser->last_solid = parser->word_count - 1;
+            parser->solid_length = 1;
+            grammar_match(parser, parser->word_count - 1);
+            continue;
+        }
+
+        //the run of characters up to the next separator continues the last word or starts a new one
+        if (parser->word_length < 0)
+            start_word(parser);
+        int word = parser->word_count - 1;
+        const char *run = c;
+        int solid_length = -1;
+        for (; c < end && *c != ' ' && *c != ',' && *c != '?' && *c != '\n'; c++)
+        {
+            //tabs are part of words, but only until the line turns out to end with them
+            if (*c != '\t')
+                solid_length = parser->word_length + (int)(c - run) + 1;
+        }
+        int run_length = c - run;
+        ensure_text_capacity(parser, run_length);
+        memcpy(parser->text + parser->text_length - 1, run, run_length);
+        parser->text_length += run_length;
+        parser->text[parser->text_length - 1] = '\0';
+        parser->word_length += run_length;
+        if (solid_length >= 0)
+        {
+            parser->last_solid = word;
+            parser->solid_length = solid_length;
+            if (word > parser->matched)
+                grammar_match(parser, word);
+        }
+    }
+}
+
+void line_parser_finish(Command *command)
+{
+    /**
+        * Function Name: line_parser_finish
+        *
+        * Purpose:
+        *    Ends the line of the calling thread's line parser and turns it into a validated command.
+        *
+        * Parameters:
+        *     Command *command - Receives the command, its previous content is discarded.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Drops the spaces and tabs ending the line, then matches the words not matched yet.
+        *     - Invalid lines give a COMMAND_INVALID command.
+        */
+    LineParser *parser = &line_parser;
+    command_reset(command);
+    if (parser->state != 0)
+    {
+        parser->word_count = parser->last_solid + 1;
+        if (parser->last_solid >= 0)
+            parser->text[parser->word_starts[parser->last_solid] + parser->solid_length] = '\0';
+        grammar_match(parser, parser->word_count);
+    }
+    grammar_finish(parser, command);
+}
+
+void line_parser_free()
+{
+    /**
+        * Function Name: line_parser_free
+        *
+        * Purpose:
+        *    Releases the calling thread's line parser.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    LineParser *parser = &line_parser;
+    free(parser->text);
+    free(parser->word_starts);
+    free(parser->spaces_before);
+    free(parser->transitions);
+    memset(parser, 0, sizeof(LineParser));
+}
+
+Bool read_line_chunk(FILE *input, char *chunk, int size, Bool *continued)
+{
+    /**
+        * Function Name: read_line_chunk
+        *
+        * Purpose:
+        *    Reads a line of input, or as much of it as fits in a buffer.
+        *
+        * Parameters:
+        *     FILE *input - The input stream.
+        *     char *chunk - Receives the characters, with the newline if the line ends in the buffer.
+        *     int size - The size of the buffer.
+        *     Bool *continued - Set to TRUE if the line goes on in the next chunk.
+        *
+        * Return:
+        *     Bool - FALSE at the end of the input, when nothing was read.
+        *
+        * Side Effects:
+        *     - A full chunk looks one character ahead, so a line ending exactly at the end of the input
+        *       is not continued by an empty chunk.
+        */
+    if (!fgets(chunk, size, input))
+        return FALSE;
+    int length = strlen(chunk);
+    *continued = FALSE;
+    if (length == size - 1 && chunk[length - 1] != '\n')
+    {
+        int next = getc(input);
+        if (next != EOF)
+        {
+            ungetc(next, input);
+            *continued = TRUE;
+        }
+    }
+    return TRUE;
+}
+
+Bool read_command(FILE *input, Command *command, Bool cached)
+{
+    /**
+        * Function Name: read_command
+        *
+        * Purpose:
+        *    Reads the next line of input, whatever its length, and turns it into a validated command.
+        *
+        * Parameters:
+        *     FILE *input - The input stream.
+        *     Command *command - Receives the command, its previous content is discarded.
+        *     Bool cached - TRUE to look the line up in the calling thread's parse cache.
+        *
+        * Return:
+        *     Bool - FALSE at the end of the input, when there is no line left.
+        *
+        * Side Effects:
+        *     - A line longer than MAX_LINE_LENGTH is parsed chunk by chunk as it is read, so it is never held
+        *       whole, and it is not cached.
+        */
+    char chunk[MAX_LINE_LENGTH + 1];
+    Bool continued;
+    if (!read_line_chunk(input, chunk, sizeof(chunk), &continued))
+        return FALSE;
+    if (!continued)
+    {
+        if (cached)
+            parse_line_cached(chunk, command);
+        else
+            parse_line(chunk, command);
+        return TRUE;
+    }
+
+    line_parser_begin();
+    do
+        line_parser_feed(chunk, strlen(chunk));
+    while (continued && read_line_chunk(input, chunk, sizeof(chunk), &continued));
+    line_parser_finish(command);
+    return TRUE;
+}
@@ -3,342 +3,353 @@
 #include <string.h>
 #include "globals.h"
 
-int last_added_ingredient_index = -1;
-int last_added_potion_index = -1;
-int last_added_sign_index = -1;
-int last_added_monster_index = -1;
-int last_added_trophy_index = -1;
-int last_added_formula_index = -1;
-
-int ingredient_capacity = 2;
-int potion_capacity = 2;
-int trophy_capacity = 2;
-int monster_capacity = 2;
-int formula_capacity = 2;
-int sign_capacity = 2;
-
-Ingredient *ingredients;
-Potion *potions;
-Sign *signs;
-Monster *monsters;
-Trophy *trophies;
-PotionFormula *formulas;
-
-void execute_line(char *line)
+Bool execute_command(const Command *command)
 {
     /**
-    * Function Name: execute_line
+    * Function Name: execute_command
     *
     * Purpose:
-    *    Executes a line of input by parsing it, deciding its type and validity, 
-    *    perform the necessary action if valid, and print the result,
-    *    exits if type is EXIT.
+    *    Executes a parsed command, perform the necessary action if valid, and print the result.
     *
     * Parameters:
-    *     char *line - The line of input to be executed.
+    *     const Command *command - The command to be executed, as produced by parse_line.
     *
     * Return:
-    *     void - This function does not return a value.
+    *     Bool - FALSE if the command is EXIT and the session should end, TRUE otherwise.
     *
     * Side Effects:
     *     - Modifies the necessary global variables ingredients, potions, trophies, formulas, monsters, and signs, its indices and capacities.
     *     - Allocates and reallocates memory for ingredients, potions, trophies, formulas, monsters, and signs.
-    *     - Prints the result of the executed line.
-    *     - Exits if the type is EXIT.
-    *     - No changes if the line is invalid.
+    *     - Prints the result of the executed command to the session's output stream.
+    *     - No changes if the command is invalid.
     */
-    remove_trailing_newline(line);
-    remove_trailing_spaces(line);
+    const char *name = command_text(command, command->name);
 
-    char words[550][MAX_WORD_LEN];
-    int word_count = split_into_words(line, words);
-    LineType type = detect_type(words, word_count);
+    switch (command->kind)
+    {
+    case COMMAND_EXIT:
+        return FALSE;
 
-    if (type == SENTENCE)
+    case COMMAND_LOOT:
     {
-        if (strcmp(words[0], "Geralt") != 0)
-        {
-            printf("INVALID\n");
-            return;
-        }
-        if (strcmp(words[2], ",") == 0)
+        //loot() works on the array it is given, so make room up front, for the names it does not hold yet only
+        int new_count = plan_received_ingredients(command);
+        while (last_added_ingredient_index + new_count >= ingredient_capacity)
         {
-            printf("INVALID\n");
-            return;
-        }
-        Sentence sentence_type = detect_sentence(words);
-        if (sentence_type == -1)
-        {
-            printf("INVALID\n");
-            return;
+            ingredients = mem_realloc(MEM_INVENTORY, ingredients, ingredient_capacity * sizeof(Ingredient), 2 * ingredient_capacity * sizeof(Ingredient));
+            ingredient_capacity *= 2;
         }
+        loot(ingredients, command);
+        respond(RESPONSE_INGREDIENTS_OBTAINED, NULL);
+        break;
+    }
 
-        if (sentence_type == LOOT)
-        {
-            if (is_valid_ingredient_sentence(words, word_count))
-            {
-                int curr_index = 2;
-                while (curr_index < word_count)
-                {
-                    if (strcmp(words[curr_index], ",") == 0)
-                    {
-                        curr_index++;
-                        continue;
-                    }
-                    int quantity = atoi(words[curr_index]);
-                    if (curr_index + 1 >= word_count)
-                        break;
-                    char ingredient[MAX_WORD_LEN];
-                    strcpy(ingredient, words[curr_index + 1]);
-
-                    if (last_added_ingredient_index + 1 >= ingredient_capacity)
-                    {
-                        ingredient_capacity *= 2;
-                        ingredients = realloc(ingredients, ingredient_capacity * sizeof(Ingredient));
-                    }
-                    add_ingredient(ingredients, ingredient, quantity);
-
-                    curr_index += 2;
-                }
-                printf("Alchemy ingredients obtained\n");
-            }
-            else
-            {
-                printf("INVALID\n");
-                return;
-            }
-        }
-        else if (sentence_type == TRADE)
+    case COMMAND_TRADE:
+    {
+        //trade() works on the array it is given, so make room up front, for the names it does not hold yet only
+        int new_count = plan_received_ingredients(command);
+        while (last_added_ingredient_index + new_count >= ingredient_capacity)
         {
-            if (is_valid_trade_sentence(words, word_count))
-            {
-                Trophy *trophies_to_trade = malloc(sizeof(Trophy) * trophy_capacity);
-
-                int curr_index = 2;
-                int trade_index = 0;
-                while (curr_index < word_count && strcmp(words[curr_index], "for") != 0)
-                {
-                    int quantity = atoi(words[curr_index]);
-                    if (quantity <= 0 || curr_index + 2 >= word_count)
-                        return;
-
-                    if (strcmp(words[curr_index + 2], "trophy") != 0)
-                        return;
-
-                    strcpy(trophies_to_trade[trade_index].name, words[curr_index + 1]);
-                    trophies_to_trade[trade_index].quantity = quantity;
-                    trade_index++;
-
-                    curr_index += 3;
-
-                    if (curr_index < word_count && strcmp(words[curr_index], "for") == 0)
-                        break;
-
-                    if (curr_index >= word_count || strcmp(words[curr_index], ",") != 0)
-                        return;
-
-                    curr_index++;
-                }
-                if (curr_index >= word_count || strcmp(words[curr_index], "for") != 0)
-                    return;
-                curr_index++;
-                if (check_valid_trade(trophies, trophies_to_trade, trade_index))
-                {
-                    trade(ingredients, trophies, trophies_to_trade, trade_index, words, curr_index, word_count);
-                    printf("Trade successful\n");
-                }
-                else
-                {
-                    printf("Not enough trophies\n");
-                    return;
-                }
-                free(trophies_to_trade);
-            }
-            else
-            {
-                printf("INVALID\n");
-                return;
-            }
+            ingredients = mem_realloc(MEM_INVENTORY, ingredients, ingredient_capacity * sizeof(Ingredient), 2 * ingredient_capacity * sizeof(Ingredient));
+            ingredient_capacity *= 2;
         }
+        if (trade(ingredients, trophies, command))
+            respond(RESPONSE_TRADE_SUCCESSFUL, NULL);
+        else
+            respond(RESPONSE_NOT_ENOUGH_TROPHIES, NULL);
+        break;
+    }
 
-        if (sentence_type == BREW)
+    case COMMAND_BREW:
+        if (!has_formula(name, formulas))
         {
-            if (word_count < 3)
-            {
-                printf("INVALID\n");
-                return;
-            }
-
-            if (!is_valid_brew_sentence(words, word_count, line))
-            {
-                printf("INVALID\n");
-                return;
-            }
-
-            char potion_name[MAX_WORD_LEN] = "";
-            for (int i = 2; i < word_count; i++)
-            {
-                strcat(potion_name, words[i]);
-                if (i < word_count - 1)
-                    strcat(potion_name, " ");
-            }
-
-            if (!has_formula(potion_name, formulas))
-            {
-                printf("No formula for %s\n", potion_name);
-                return;
-            }
-
-            if (!can_brew(potion_name, ingredients, formulas))
-            {
-                printf("Not enough ingredients\n");
-                return;
-            }
-
-            if (last_added_potion_index + 1 >= potion_capacity)
-            {
-                potion_capacity *= 2;
-                potions = realloc(potions, potion_capacity * sizeof(Potion));
-            }
-
-            brew_potion(potion_name, ingredients, potions, formulas);
+            respond(RESPONSE_NO_FORMULA, name);
+            break;
         }
-        else if (sentence_type == LEARN)
+        if (!can_brew(name, ingredients, formulas))
         {
-            if (!is_valid_learn_sentence(words, word_count, line))
-            {
-                printf("INVALID\n");
-                return;
-            }
-            for (int i = 0; i < word_count - 3; i++)
-            {
-                if (strcmp(words[i], "potion") == 0 &&
-                    strcmp(words[i + 1], "consists") == 0 &&
-                    strcmp(words[i + 2], "of") == 0)
-                {
-                    if (!learn_potion_formula(words, word_count, formulas))
-                    {
-                        printf("INVALID\n");
-                    }
-                    return;
-                }
-            }
-
-            for (int i = 2; i < word_count - 4; i++)
-            {
-                if ((strcmp(words[i], "sign") == 0 || strcmp(words[i], "potion") == 0) &&
-                    strcmp(words[i + 1], "is") == 0 &&
-                    strcmp(words[i + 2], "effective") == 0 &&
-                    strcmp(words[i + 3], "against") == 0)
-                {
-                    if (!learn_effectiveness(words, word_count, monsters))
-                    {
-                        printf("INVALID\n");
-                    }
-                    return;
-                }
-            }
-
-            printf("INVALID\n");
-            return;
+            respond(RESPONSE_NOT_ENOUGH_INGREDIENTS, NULL);
+            break;
         }
-        else if (sentence_type == ENCOUNTER)
+        if (last_added_potion_index + 1 >= potion_capacity)
         {
-            if (!is_valid_encounter_sentence(words, word_count))
-            {
-                printf("INVALID\n");
-                return;
-            }
-
-            if (last_added_trophy_index + 1 >= trophy_capacity)
-            {
-                trophy_capacity *= 2;
-                trophies = realloc(trophies, trophy_capacity * sizeof(Trophy));
-            }
-
-            handle_encounter(words, word_count, monsters, potions, trophies);
+            potions = mem_realloc(MEM_POTIONS, potions, potion_capacity * sizeof(Potion), 2 * potion_capacity * sizeof(Potion));
+            potion_capacity *= 2;
         }
-    }
-    else if (type == QUESTION)
+        brew_potion(name, ingredients, potions, formulas);
+        break;
+
+    case COMMAND_BREW_BATCH:
     {
-        Question question_type = detect_question(words, word_count);
-        if (question_type == INGREDIENT)
-        {
-            handle_specific_ingredient_query(words, word_count);
-        }
-        else if (question_type == POTION)
-        {
-            handle_specific_potion_query(words, word_count, line);
-        }
-        else if (question_type == TROPHY)
+        PotionFormula *formula = get_formula(name, formulas);
+        if (formula == NULL)
         {
-            handle_specific_trophy_query(words, word_count);
+            respond(RESPONSE_NO_FORMULA, name);
+            break;
         }
-        else if (question_type == ALL_INGREDIENTS)
+        //a count is brewed in full or not at all, max brews whatever the inventory allows
+        int count = brewable_count(formula, ingredients);
+        if (command->quantity > 0 && count >= command->quantity)
+            count = command->quantity;
+        else if (command->quantity > 0)
+            count = 0;
+        if (count == 0)
         {
-            handle_all_ingredients_query();
+            respond(RESPONSE_NOT_ENOUGH_INGREDIENTS, NULL);
+            break;
         }
-        else if (question_type == ALL_POTIONS)
+        if (last_added_potion_index + 1 >= potion_capacity)
         {
-            handle_all_potions_query();
+            potions = mem_realloc(MEM_POTIONS, potions, potion_capacity * sizeof(Potion), 2 * potion_capacity * sizeof(Potion));
+            potion_capacity *= 2;
         }
-        else if (question_type == ALL_TROPHIES)
+        brew_potions(formula, count, ingredients, potions);
+        break;
+    }
+
+    case COMMAND_BREW_LIST:
+        //brew_potion_list() works on the array it is given, so make room for every potion up front
+        while (last_added_potion_index + command->item_count >= potion_capacity)
         {
-            handle_all_trophies_query();
+            potions = mem_realloc(MEM_POTIONS, potions, potion_capacity * sizeof(Potion), 2 * potion_capacity * sizeof(Potion));
+            potion_capacity *= 2;
         }
-        else if (question_type == POTION_FORMULA)
+        brew_potion_list(command, ingredients, potions, formulas);
+        break;
+
+    case COMMAND_LEARN_FORMULA:
+        ensure_formula_capacity();
+        if (!learn_potion_formula(command, formulas))
+            respond(RESPONSE_INVALID, NULL);
+        break;
+
+    case COMMAND_LEARN_EFFECTIVENESS:
+        ensure_monster_capacity();
+        if (!learn_effectiveness(command, monsters))
+            respond(RESPONSE_INVALID, NULL);
+        break;
+
+    case COMMAND_ENCOUNTER:
+        if (last_added_trophy_index + 1 >= trophy_capacity)
         {
-            handle_potion_recipe_query(words, word_count, line);
+            trophies = mem_realloc(MEM_TROPHIES, trophies, trophy_capacity * sizeof(Trophy), 2 * trophy_capacity * sizeof(Trophy));
+            trophy_capacity *= 2;
         }
-        else if (question_type == MONSTER)
+        handle_encounter(name, monsters, potions, trophies);
+        break;
+
+    case COMMAND_ENCOUNTER_BATCH:
+        if (last_added_trophy_index + 1 >= trophy_capacity)
         {
-            handle_monster_query(words, word_count);
+            trophies = mem_realloc(MEM_TROPHIES, trophies, trophy_capacity * sizeof(Trophy), 2 * trophy_capacity * sizeof(Trophy));
+            trophy_capacity *= 2;
         }
+        handle_encounters(name, command->quantity, monsters, potions, trophies);
+        break;
+
+    case COMMAND_INGREDIENT_QUERY:
+        handle_specific_ingredient_query(name);
+        break;
+    case COMMAND_POTION_QUERY:
+        handle_specific_potion_query(name);
+        break;
+    case COMMAND_TROPHY_QUERY:
+        handle_specific_trophy_query(name);
+        break;
+    case COMMAND_ALL_INGREDIENTS_QUERY:
+        handle_all_ingredients_query();
+        break;
+    case COMMAND_ALL_POTIONS_QUERY:
+        handle_all_potions_query();
+        break;
+    case COMMAND_ALL_TROPHIES_QUERY:
+        handle_all_trophies_query();
+        break;
+    case COMMAND_POTION_FORMULA_QUERY:
+        handle_potion_recipe_query(name);
+        break;
+    case COMMAND_MONSTER_QUERY:
+        handle_monster_query(name);
+        break;
+    case COMMAND_BREWABLE_QUERY:
+        handle_brewable_query();
+        break;
+    case COMMAND_USES_QUERY:
+        handle_uses_query(name);
+        break;
+    case COMMAND_EFFECTIVE_AGAINST_QUERY:
+        handle_effective_against_query(name);
+        break;
+
+    case COMMAND_TOP_INGREDIENTS_QUERY:
+        handle_top_query(RANK_INGREDIENTS, command->quantity);
+        break;
+
+    case COMMAND_TOP_POTIONS_QUERY:
+        handle_top_query(RANK_POTIONS, command->quantity);
+        break;
+
+    case COMMAND_TOP_TROPHIES_QUERY:
+        handle_top_query(RANK_TROPHIES, command->quantity);
+        break;
+
+    case COMMAND_INGREDIENTS_BELOW_QUERY:
+        handle_below_query(RANK_INGREDIENTS, command->quantity);
+        break;
+
+    case COMMAND_POTIONS_BELOW_QUERY:
+        handle_below_query(RANK_POTIONS, command->quantity);
+        break;
+
+    case COMMAND_TROPHIES_BELOW_QUERY:
+        handle_below_query(RANK_TROPHIES, command->quantity);
+        break;
+
+    //potions and trophies are laid out like ingredients
+    case COMMAND_MULTI_INGREDIENT_QUERY:
+        handle_multi_quantity_query(command, ingredients, last_added_ingredient_index + 1);
+        break;
+
+    case COMMAND_MULTI_POTION_QUERY:
+        handle_multi_quantity_query(command, (const Ingredient *)potions, last_added_potion_index + 1);
+        break;
+
+    case COMMAND_MULTI_TROPHY_QUERY:
+        handle_multi_quantity_query(command, (const Ingredient *)trophies, last_added_trophy_index + 1);
+        break;
+
+    case COMMAND_INGREDIENT_PREFIX_QUERY:
+        handle_prefix_query(RANK_INGREDIENTS, name);
+        break;
+
+    case COMMAND_POTION_PREFIX_QUERY:
+        handle_prefix_query(RANK_POTIONS, name);
+        break;
+
+    case COMMAND_TROPHY_PREFIX_QUERY:
+        handle_prefix_query(RANK_TROPHIES, name);
+        break;
+
+    case COMMAND_MONSTER_PREFIX_QUERY:
+        handle_prefix_query(RANK_MONSTERS, name);
+        break;
+
+    case COMMAND_MEMORY_QUERY:
+        handle_memory_query();
+        break;
+
+    case COMMAND_MEMORY_ALLOCATIONS_QUERY:
+        handle_memory_allocations_query();
+        break;
+
+    default:
+        respond(RESPONSE_INVALID, NULL);
+        break;
+    }
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *replay_dir = NULL;
+    const char *out_dir = NULL;
+    const char *aggregate_dir = NULL;
+    Bool pipelined = FALSE;
+    int thread_count = 0;
+    int query_count = 0;
+    const char *kb_path = NULL;
+    Bool cache_stats = FALSE;
+    Bool memory_report = FALSE;
+    Bool binary = FALSE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--replay-dir") == 0 && i + 1 < argc)
+            replay_dir = argv[++i];
+        else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc)
+            out_dir = argv[++i];
+        else if (strcmp(argv[i], "--aggregate") == 0 && i + 1 < argc)
+            aggregate_dir = argv[++i];
+        else if (strcmp(argv[i], "--kb") == 0 && i + 1 < argc)
+            kb_path = argv[++i];
+        else if (strcmp(argv[i], "--compile-kb") == 0 && i + 2 < argc)
+            return compile_knowledge_base(argv[i + 1], argv[i + 2]);
+        else if (strcmp(argv[i], "--pipeline") == 0)
+            pipelined = TRUE;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            thread_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--query-threads") == 0 && i + 1 < argc)
+            query_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--parse-cache") == 0 && i + 1 < argc)
+            parse_cache_budget = atol(argv[++i]) < 0 ? 0 : (size_t)atol(argv[i]);
+        else if (strcmp(argv[i], "--cache-stats") == 0)
+            cache_stats = TRUE;
+        else if (strcmp(argv[i], "--mem-report") == 0)
+            memory_report = TRUE;
+        else if (strcmp(argv[i], "--binary") == 0)
+            binary = TRUE;
+        else if (strcmp(argv[i], "--encode-binary") == 0)
+            return encode_text_session(stdin, stdout);
         else
         {
-            printf("INVALID\n");
+            fprintf(stderr, "Usage: %s [--kb FILE] [--replay-dir DIR --out-dir DIR | --aggregate DIR | --pipeline [--query-threads N] | --binary] [--threads N]\n"
+                            "       [--parse-cache BYTES] [--cache-stats] [--mem-report]\n"
+                            "       %s --compile-kb KNOWLEDGE_FILE FILE\n"
+                            "       %s --encode-binary < TEXT_SESSION > BINARY_SESSION\n", argv[0], argv[0], argv[0]);
+            return 1;
         }
     }
-    else if (type == EXIT)
+
+    //every mode releases its parse caches before returning, so the totals are complete at exit
+    if (cache_stats)
+        atexit(parse_cache_report);
+    //likewise every session adds its memory counters to the totals when it is freed
+    if (memory_report)
+        atexit(mem_report);
+
+    //the knowledge base is mapped once and shared by every session of the process
+    if (kb_path != NULL && !load_knowledge_base(kb_path))
+        return 1;
+
+    //every input file is replayed in a private session and the tables of all sessions are merged
+    if (aggregate_dir != NULL)
+        return aggregate_directory(aggregate_dir, thread_count);
+
+    //batch mode, every input file is replayed as its own session without prompts
+    if (replay_dir != NULL || out_dir != NULL)
     {
-        exit(0);
+        if (replay_dir == NULL || out_dir == NULL)
+        {
+            fprintf(stderr, "--replay-dir and --out-dir must be given together\n");
+            return 1;
+        }
+        return replay_directory(replay_dir, out_dir, thread_count);
     }
-}
 
-int main()
-{
-    ingredients = malloc(sizeof(Ingredient) * ingredient_capacity);
-    potions = malloc(sizeof(Potion) * potion_capacity);
-    trophies = malloc(sizeof(Trophy) * trophy_capacity);
-    formulas = malloc(sizeof(PotionFormula) * formula_capacity);
-    monsters = malloc(sizeof(Monster) * monster_capacity);
-    signs = malloc(sizeof(Sign) * sign_capacity);
-
-    char line[1025];
+    //same session as the loop below, with binary frames instead of lines and no prompts
+    if (binary)
+        return run_binary_session(stdin, stdout);
+
+    //same session as the loop below, with reading, parsing, executing and writing on their own threads
+    if (pipelined)
+        return run_pipeline(stdin, thread_count, query_count < 0 ? 0 : query_count);
+
+    init_state();
+
+    //a line of any length is one command, a line seen before on the thread is taken from its parse cache
     while (1)
     {
         printf(">> ");
         fflush(stdout);
 
-        if (!fgets(line, sizeof(line), stdin))
+        if (!read_command(stdin, &line_command, TRUE))
             break;
 
-        execute_line(line);
+        if (!execute_command(&line_command))
+            break;
     }
 
-    // FILE *file = fopen("../test-cases/input1.txt", "r");
-    // while(fgets(line, sizeof(line), file))
-    // {
-    //     execute_line(line);
-    // }
-    // fclose(file);
-
-    free(ingredients);
-    free(potions);
-    free(trophies);
-    free(formulas);
-    free(monsters);
-    free(signs);
+    free_state();
 
     return 0;
 }
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include "globals.h"
+
+THREAD_LOCAL MemStats mem_stats;
+
+static const char *subsystem_names[MEM_SUBSYSTEM_COUNT + 1] = {
+    "inventory", "potions", "trophies", "formulas", "bestiary", "temporaries", "names", "brew index", "bestiary index",
+    "rank index", "inventory index", "parse cache", "total",
+};
+
+// counters of the sessions already ended, summed over every thread, the peaks are the largest of any session,
+// the last entry is for all subsystems together
+static atomic_long total_sessions;
+static atomic_long total_allocations[MEM_SUBSYSTEM_COUNT + 1];
+static atomic_long total_live[MEM_SUBSYSTEM_COUNT + 1];
+static atomic_long total_slack[MEM_SUBSYSTEM_COUNT + 1];
+static atomic_long total_peak[MEM_SUBSYSTEM_COUNT + 1];
+
+static void account(MemSubsystem subsystem, size_t released, size_t acquired, Bool allocation)
+{
+    /**
+        * Function Name: account
+        *
+        * Purpose:
+        *    Counts a change of the memory of a subsystem of the calling thread's session.
+        *
+        * Parameters:
+        *     MemSubsystem subsystem - The subsystem.
+        *     size_t released - The bytes given back.
+        *     size_t acquired - The bytes obtained.
+        *     Bool allocation - TRUE if the change went through the allocator, FALSE for a free.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The parse cache belongs to the parsing thread rather than to the session, it is left out of the total.
+        */
+    MemCounter *counters[2] = {&mem_stats.subsystems[subsystem], &mem_stats.total};
+    for (int i = 0; i < (subsystem == MEM_PARSE_CACHE ? 1 : 2); i++)
+    {
+        counters[i]->live = counters[i]->live - released + acquired;
+        if (counters[i]->live > counters[i]->peak)
+            counters[i]->peak = counters[i]->live;
+        if (allocation)
+            counters[i]->allocations++;
+    }
+}
+
+void *mem_malloc(MemSubsystem subsystem, size_t size)
+{
+    /**
+        * Function Name: mem_malloc
+        *
+        * Purpose:
+        *    Allocates memory for a subsystem of the calling thread's session, like malloc.
+        *
+        * Parameters:
+        *     MemSubsystem subsystem - The subsystem the memory is counted under.
+        *     size_t size - The number of bytes.
+        *
+        * Return:
+        *     void * - The memory, NULL if it could not be allocated.
+        */
+    void *block = malloc(size);
+    if (block != NULL)
+        account(subsystem, 0, size, TRUE);
+    return block;
+}
+
+void *mem_calloc(MemSubsystem subsystem, size_t count, size_t size)
+{
+    /**
+        * Function Name: mem_calloc
+        *
+        * Purpose:
+        *    Allocates zeroed memory for a subsystem of the calling thread's session, like calloc.
+        *
+        * Parameters:
+        *     MemSubsystem subsystem - The subsystem the memory is counted under.
+        *     size_t count - The number of elements.
+        *     size_t size - The size of an element.
+        *
+        * Return:
+        *     void * - The memory, NULL if it could not be allocated.
+        */
+    void *block = calloc(count, size);
+    if (block != NULL)
+        account(subsystem, 0, count * size, TRUE);
+    return block;
+}
+
+void *mem_realloc(MemSubsystem subsystem, void *block, size_t old_size, size_t size)
+{
+    /**
+        * Function Name: mem_realloc
+        *
+        * Purpose:
+        *    Resizes memory of a subsystem of the calling thread's session, like realloc.
+        *
+        * Parameters:
+        *     MemSubsystem subsystem - The subsystem the memory is counted under.
+        *     void *block - The memory, NULL to allocate it.
+        *     size_t old_size - The bytes it was allocated with, 0 if block is NULL.
+        *     size_t size - The new number of bytes.
+        *
+        * Return:
+        *     void * - The resized memory, NULL if it could not be resized and block is left as it was.
+        */
+    void *resized = realloc(block, size);
+    if (resized != NULL)
+        account(subsystem, block == NULL ? 0 : old_size, size, TRUE);
+    return resized;
+}
+
+void mem_free(MemSubsystem subsystem, void *block, size_t size)
+{
+    /**
+        * Function Name: mem_free
+        *
+        * Purpose:
+        *    Frees memory of a subsystem of the calling thread's session, like free.
+        *
+        * Parameters:
+        *     MemSubsystem subsystem - The subsystem the memory was counted under.
+        *     void *block - The memory, nothing happens if it is NULL.
+        *     size_t size - The bytes it was allocated with.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (block == NULL)
+        return;
+    free(block);
+    account(subsystem, size, 0, FALSE);
+}
+
+const char *mem_subsystem_name(int subsystem)
+{
+    /**
+        * Function Name: mem_subsystem_name
+        *
+        * Purpose:
+        *    Returns the name of a subsystem in the memory reports.
+        *
+        * Parameters:
+        *     int subsystem - A MemSubsystem, or MEM_SUBSYSTEM_COUNT for all of them together.
+        *
+        * Return:
+        *     const char * - The name.
+        */
+    return subsystem_names[subsystem];
+}
+
+void mem_stats_in_use(size_t *in_use)
+{
+    /**
+        * Function Name: mem_stats_in_use
+        *
+        * Purpose:
+        *    Measures the bytes of the calling thread's tables that hold entries, the rest of their capacity is slack.
+        *
+        * Parameters:
+        *     size_t *in_use - Receives the bytes of every subsystem, then of all of them, MEM_SUBSYSTEM_COUNT + 1 values.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Walks the formulas and the monsters for the lists they own.
+        *     - Temporaries hold no entries between commands, the buffers kept for the next one are all slack.
+        *     - The names are in use for their characters and their hash slots. The indexes and the parse cache
+        *       are counted whole, their spare buckets are not told apart from their entries.
+        */
+    memset(in_use, 0, (MEM_SUBSYSTEM_COUNT + 1) * sizeof(size_t));
+    in_use[MEM_INVENTORY] = (last_added_ingredient_index + 1) * sizeof(Ingredient);
+    in_use[MEM_POTIONS] = (last_added_potion_index + 1) * sizeof(Potion);
+    in_use[MEM_TROPHIES] = (last_added_trophy_index + 1) * sizeof(Trophy);
+    in_use[MEM_FORMULAS] = (last_added_formula_index + 1) * sizeof(PotionFormula);
+    for (int i = 0; i <= last_added_formula_index; i++)
+        in_use[MEM_FORMULAS] += formulas[i].ingredient_count * sizeof(Ingredient);
+    in_use[MEM_BESTIARY] = (last_added_monster_index + 1) * sizeof(Monster) + (last_added_sign_index + 1) * sizeof(Sign);
+    for (int i = 0; i <= last_added_monster_index; i++)
+        in_use[MEM_BESTIARY] += monsters[i].sign_count * sizeof(Sign) + monsters[i].potion_count * sizeof(Potion);
+    in_use[MEM_NAMES] = name_pool.bytes + name_pool.count * sizeof(const char *);
+    for (int s = MEM_BREW_INDEX; s <= MEM_PARSE_CACHE; s++)
+        in_use[s] = mem_stats.subsystems[s].live;
+    for (int s = 0; s < MEM_PARSE_CACHE; s++)
+        in_use[MEM_SUBSYSTEM_COUNT] += in_use[s];
+}
+
+static void add_to_totals()
+{
+    /**
+        * Function Name: add_to_totals
+        *
+        * Purpose:
+        *    Adds the counters of the calling thread to the process totals reported by mem_report.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    size_t in_use[MEM_SUBSYSTEM_COUNT + 1];
+    mem_stats_in_use(in_use);
+    for (int s = 0; s <= MEM_SUBSYSTEM_COUNT; s++)
+    {
+        const MemCounter *counter = s < MEM_SUBSYSTEM_COUNT ? &mem_stats.subsystems[s] : &mem_stats.total;
+        atomic_fetch_add(&total_allocations[s], counter->allocations);
+        atomic_fetch_add(&total_live[s], (long)counter->live);
+        atomic_fetch_add(&total_slack[s], counter->live > in_use[s] ? (long)(counter->live - in_use[s]) : 0);
+        long peak = atomic_load(&total_peak[s]);
+        while (peak < (long)counter->peak && !atomic_compare_exchange_weak(&total_peak[s], &peak, (long)counter->peak))
+            ;
+    }
+}
+
+void mem_stats_end_session()
+{
+    /**
+        * Function Name: mem_stats_end_session
+        *
+        * Purpose:
+        *    Adds the counters of the calling thread's session to the process totals reported by mem_report.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The live bytes and the slack are taken as they are now, so it must be called while the session
+        *       still owns its tables. Only the first call of a session counts.
+        */
+    if (mem_stats.session_ended)
+        return;
+    mem_stats.session_ended = TRUE;
+    atomic_fetch_add(&total_sessions, 1);
+    add_to_totals();
+}
+
+void mem_stats_end_thread()
+{
+    /**
+        * Function Name: mem_stats_end_thread
+        *
+        * Purpose:
+        *    Adds the counters of a thread that runs no session, such as a parser thread, to the process totals.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Like mem_stats_end_session, it must be called before the thread frees what it counted,
+        *       and its counters are reset by mem_stats_free. No session is counted.
+        */
+    if (mem_stats.session_ended)
+        return;
+    mem_stats.session_ended = TRUE;
+    add_to_totals();
+}
+
+void mem_stats_free()
+{
+    /**
+        * Function Name: mem_stats_free
+        *
+        * Purpose:
+        *    Resets the calling thread's memory counters once its session is freed.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Tables moved out of the session before it was freed are forgotten with it.
+        */
+    memset(&mem_stats, 0, sizeof(MemStats));
+}
+
+void mem_report()
+{
+    /**
+        * Function Name: mem_report
+        *
+        * Purpose:
+        *    Prints the memory counters of every session ended so far, and the peak resident size, to stderr.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    struct rusage usage;
+    long peak_rss = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+    fprintf(stderr, "Memory: %ld sessions, %ld KiB peak resident size\n", atomic_load(&total_sessions), peak_rss);
+    for (int s = 0; s <= MEM_SUBSYSTEM_COUNT; s++)
+        fprintf(stderr, "  %-16s %ld bytes live and %ld slack at session end, %ld allocations, %ld bytes peak\n",
+                subsystem_names[s], atomic_load(&total_live[s]), atomic_load(&total_slack[s]),
+                atomic_load(&total_allocations[s]), atomic_load(&total_peak[s]));
+}
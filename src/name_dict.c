@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "globals.h"
+
+// a block is its first name in full, then for every other name the number of leading characters it shares
+// with the name before it, seven bits per byte with the high bit set on all but the last, and the rest of it
+
+static const char *read_shared_length(const char *entry, int *shared)
+{
+    /**
+        * Function Name: read_shared_length
+        *
+        * Purpose:
+        *    Reads the number of characters a name of a block shares with the name before it.
+        *
+        * Parameters:
+        *     const char *entry - The start of the name in the block.
+        *     int *shared - Receives the number of shared characters.
+        *
+        * Return:
+        *     const char * - The rest of the name, after the number.
+        */
+    const unsigned char *byte = (const unsigned char *)entry;
+    unsigned value = 0;
+    int shift = 0;
+    while (*byte & 0x80)
+    {
+        value |= (unsigned)(*byte++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *shared = (int)(value | (unsigned)*byte++ << shift);
+    return (const char *)byte;
+}
+
+static int block_name_count(const NameDict *dict, int block)
+{
+    /**
+        * Function Name: block_name_count
+        *
+        * Purpose:
+        *    Returns the number of names in a block, only the last one may be short.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary.
+        *     int block - The block.
+        *
+        * Return:
+        *     int - The number of names.
+        */
+    int count = dict->name_count - block * NAME_DICT_BLOCK_NAMES;
+    return count < NAME_DICT_BLOCK_NAMES ? count : NAME_DICT_BLOCK_NAMES;
+}
+
+char *name_dict_encode(const char *const *names, int count, int *block_offsets, int *length)
+{
+    /**
+        * Function Name: name_dict_encode
+        *
+        * Purpose:
+        *    Front codes a list of names into blocks.
+        *
+        * Parameters:
+        *     const char *const *names - The names, sorted and each once.
+        *     int count - The number of names.
+        *     int *block_offsets - Receives the offset of every block, room for NAME_DICT_BLOCK_COUNT(count) of them.
+        *     int *length - Receives the number of bytes of the blocks.
+        *
+        * Return:
+        *     char * - The blocks, to be freed by the caller.
+        */
+    int capacity = 4096;
+    char *data = malloc(capacity);
+    *length = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int shared = 0;
+        if (i % NAME_DICT_BLOCK_NAMES == 0)
+            block_offsets[i / NAME_DICT_BLOCK_NAMES] = *length;
+        else
+            while (names[i][shared] != '\0' && names[i][shared] == names[i - 1][shared])
+                shared++;
+
+        //at most five bytes for the shared length, then the rest and its terminator
+        int rest = strlen(names[i] + shared) + 1;
+        while (*length + 5 + rest > capacity)
+        {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+        if (i % NAME_DICT_BLOCK_NAMES != 0)
+        {
+            unsigned value = shared;
+            while (value >= 0x80)
+            {
+                data[(*length)++] = (char)((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            data[(*length)++] = (char)value;
+        }
+        memcpy(data + *length, names[i] + shared, rest);
+        *length += rest;
+    }
+    return data;
+}
+
+static int find_in_block(const NameDict *dict, int block, const char *name, Bool *found)
+{
+    /**
+        * Function Name: find_in_block
+        *
+        * Purpose:
+        *    Searches a block for the first name not smaller than a name, without decoding it.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary.
+        *     int block - The block, its first name not larger than the name.
+        *     const char *name - The name searched for.
+        *     Bool *found - Set to TRUE if the name is in the block.
+        *
+        * Return:
+        *     int - The number of the first name not smaller, the first of the next block if every name is smaller.
+        *
+        * Side Effects:
+        *     - Only the characters past those the name shares with the last smaller name are compared, a name
+        *       sharing more with the one before it is smaller too, and one sharing less is larger.
+        */
+    const char *entry = dict->blocks + dict->block_offsets[block];
+    int first = block * NAME_DICT_BLOCK_NAMES;
+    int matched = 0;
+    *found = FALSE;
+    for (int i = 0; i < block_name_count(dict, block); i++)
+    {
+        int shared = 0;
+        if (i > 0)
+            entry = read_shared_length(entry, &shared);
+        if (shared < matched)
+            return first + i;
+        if (shared == matched)
+        {
+            const char *rest = entry;
+            while (*rest != '\0' && *rest == name[matched])
+            {
+                rest++;
+                matched++;
+            }
+            if (*rest == name[matched])
+            {
+                *found = TRUE;
+                return first + i;
+            }
+            if ((unsigned char)*rest > (unsigned char)name[matched])
+                return first + i;
+        }
+        entry += strlen(entry) + 1;
+    }
+    return first + block_name_count(dict, block);
+}
+
+static int find_name(const NameDict *dict, const char *name, Bool *found)
+{
+    /**
+        * Function Name: find_name
+        *
+        * Purpose:
+        *    Searches a dictionary for the first name not smaller than a name.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary.
+        *     const char *name - The name searched for.
+        *     Bool *found - Set to TRUE if the name is in the dictionary.
+        *
+        * Return:
+        *     int - The number of the first name not smaller, the number of names if every name is smaller.
+        *
+        * Side Effects:
+        *     - Binary searches the first names of the blocks, which are stored in full, then scans one block.
+        */
+    int low = 0;
+    int high = NAME_DICT_BLOCK_COUNT(dict->name_count);
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (strcmp(dict->blocks + dict->block_offsets[middle], name) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    *found = FALSE;
+    //low is the first block starting after the name, so the name can only be in the one before it
+    return low == 0 ? 0 : find_in_block(dict, low - 1, name, found);
+}
+
+int name_dict_find(const NameDict *dict, const char *name)
+{
+    /**
+        * Function Name: name_dict_find
+        *
+        * Purpose:
+        *    Looks up a name in a dictionary.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary.
+        *     const char *name - The name.
+        *
+        * Return:
+        *     int - The number of the name, names are numbered in name order, -1 if not found.
+        */
+    Bool found;
+    int position = find_name(dict, name, &found);
+    return found ? position : -1;
+}
+
+int name_dict_first_from(const NameDict *dict, const char *name)
+{
+    /**
+        * Function Name: name_dict_first_from
+        *
+        * Purpose:
+        *    Returns the first name of a dictionary not smaller than a name.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary.
+        *     const char *name - The name, a prefix finds the first name starting with it.
+        *
+        * Return:
+        *     int - The number of the name, the number of names if every name is smaller.
+        */
+    Bool found;
+    return find_name(dict, name, &found);
+}
+
+static char *decode_block(const NameDict *dict, int block)
+{
+    /**
+        * Function Name: decode_block
+        *
+        * Purpose:
+        *    Decodes the names of a block.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary.
+        *     int block - The block.
+        *
+        * Return:
+        *     char * - The names back to back, each followed by its terminator.
+        *
+        * Side Effects:
+        *     - Measures the names in a first pass, so the copy is allocated once.
+        */
+    int count = block_name_count(dict, block);
+    const char *entry = dict->blocks + dict->block_offsets[block];
+    size_t size = 0;
+    int previous_length = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int shared = 0;
+        if (i > 0)
+            entry = read_shared_length(entry, &shared);
+        int rest = strlen(entry);
+        previous_length = shared + rest;
+        size += previous_length + 1;
+        entry += rest + 1;
+    }
+
+    char *names = malloc(size);
+    char *previous = names;
+    char *name = names;
+    entry = dict->blocks + dict->block_offsets[block];
+    for (int i = 0; i < count; i++)
+    {
+        int shared = 0;
+        if (i > 0)
+            entry = read_shared_length(entry, &shared);
+        int rest = strlen(entry) + 1;
+        memmove(name, previous, shared);
+        memcpy(name + shared, entry, rest);
+        entry += rest;
+        previous = name;
+        name += shared + rest;
+    }
+    return names;
+}
+
+const char *name_dict_name(const NameDict *dict, int number)
+{
+    /**
+        * Function Name: name_dict_name
+        *
+        * Purpose:
+        *    Returns a name of a dictionary from its number.
+        *
+        * Parameters:
+        *     const NameDict *dict - The dictionary, its decoded blocks allocated.
+        *     int number - The number of the name.
+        *
+        * Return:
+        *     const char * - The name, which stays in place as long as the dictionary.
+        *
+        * Side Effects:
+        *     - Decodes the block of the name on its first use and keeps it. Threads decoding the same block
+        *       at once each decode it, the first to publish its copy wins and the others free theirs.
+        */
+    int block = number / NAME_DICT_BLOCK_NAMES;
+    char *names = atomic_load_explicit(&dict->decoded[block], memory_order_acquire);
+    if (names == NULL)
+    {
+        char *expected = NULL;
+        names = decode_block(dict, block);
+        if (!atomic_compare_exchange_strong_explicit(&dict->decoded[block], &expected, names, memory_order_acq_rel, memory_order_acquire))
+        {
+            free(names);
+            names = expected;
+        }
+    }
+    for (int i = 0; i < number % NAME_DICT_BLOCK_NAMES; i++)
+        names += strlen(names) + 1;
+    return names;
+}
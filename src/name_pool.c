@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+// bytes of names per block, a longer name gets a block of its own
+#define NAME_POOL_BLOCK_SIZE 4096
+
+THREAD_LOCAL NamePool name_pool;
+
+static const char *append_name(NamePool *pool, const char *name, int length)
+{
+    /**
+        * Function Name: append_name
+        *
+        * Purpose:
+        *    Copies a name at the end of the newest block of a pool.
+        *
+        * Parameters:
+        *     NamePool *pool - The pool.
+        *     const char *name - The name.
+        *     int length - The number of characters of the name.
+        *
+        * Return:
+        *     const char * - The copy, which never moves.
+        *
+        * Side Effects:
+        *     - Starts a new block when the newest one is full, the older blocks are never touched again.
+        */
+    NamePoolBlock *block = pool->blocks;
+    if (block == NULL || block->used + length + 1 > block->size)
+    {
+        int size = length + 1 > NAME_POOL_BLOCK_SIZE ? length + 1 : NAME_POOL_BLOCK_SIZE;
+        block = mem_malloc(MEM_NAMES, sizeof(NamePoolBlock) + size);
+        block->size = size;
+        block->used = 0;
+        block->next = pool->blocks;
+        pool->blocks = block;
+    }
+    char *copy = block->text + block->used;
+    memcpy(copy, name, length + 1);
+    block->used += length + 1;
+    pool->bytes += length + 1;
+    return copy;
+}
+
+const char *name_pool_intern(const char *name)
+{
+    /**
+        * Function Name: name_pool_intern
+        *
+        * Purpose:
+        *    Returns the copy of a name kept by the calling thread's session, storing it the first time.
+        *
+        * Parameters:
+        *     const char *name - The name, of any length.
+        *
+        * Return:
+        *     const char * - The stored name, the same pointer for every call with the same name.
+        *
+        * Side Effects:
+        *     - The stored names stay in place until the pool is freed, so tables and snapshots point at them
+        *       instead of holding a copy.
+        *     - Allocates the slots on first use, then doubles them and refiles the names when half full.
+        */
+    NamePool *pool = &name_pool;
+    if (pool->slots == NULL || 2 * (pool->count + 1) > pool->slot_count)
+    {
+        int slot_count = pool->slots == NULL ? 256 : pool->slot_count * 2;
+        const char **slots = mem_calloc(MEM_NAMES, slot_count, sizeof(const char *));
+        for (int i = 0; i < pool->slot_count; i++)
+        {
+            if (pool->slots[i] == NULL)
+                continue;
+            int slot = hash_name(pool->slots[i]) & (slot_count - 1);
+            while (slots[slot] != NULL)
+                slot = (slot + 1) & (slot_count - 1);
+            slots[slot] = pool->slots[i];
+        }
+        mem_free(MEM_NAMES, pool->slots, pool->slot_count * sizeof(const char *));
+        pool->slots = slots;
+        pool->slot_count = slot_count;
+    }
+
+    int slot = hash_name(name) & (pool->slot_count - 1);
+    while (pool->slots[slot] != NULL)
+    {
+        if (strcmp(pool->slots[slot], name) == 0)
+            return pool->slots[slot];
+        slot = (slot + 1) & (pool->slot_count - 1);
+    }
+    pool->slots[slot] = append_name(pool, name, strlen(name));
+    pool->count++;
+    return pool->slots[slot];
+}
+
+void name_pool_take(NamePool *pool)
+{
+    /**
+        * Function Name: name_pool_take
+        *
+        * Purpose:
+        *    Moves the calling thread's names into a pool that outlives its session.
+        *
+        * Parameters:
+        *     NamePool *pool - Receives the names, released with name_pool_release.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - For tables or snapshots still read once the session is freed, the names they point at stay valid.
+        *     - The thread starts over with an empty pool.
+        */
+    *pool = name_pool;
+    memset(&name_pool, 0, sizeof(NamePool));
+}
+
+static void release_pool(NamePool *pool, Bool counted)
+{
+    /**
+        * Function Name: release_pool
+        *
+        * Purpose:
+        *    Frees the names of a pool.
+        *
+        * Parameters:
+        *     NamePool *pool - The pool, empty afterwards.
+        *     Bool counted - TRUE for the calling thread's pool, whose memory is counted under MEM_NAMES.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    NamePoolBlock *block = pool->blocks;
+    while (block != NULL)
+    {
+        NamePoolBlock *next = block->next;
+        if (counted)
+            mem_free(MEM_NAMES, block, sizeof(NamePoolBlock) + block->size);
+        else
+            free(block);
+        block = next;
+    }
+    if (counted)
+        mem_free(MEM_NAMES, pool->slots, pool->slot_count * sizeof(const char *));
+    else
+        free(pool->slots);
+    memset(pool, 0, sizeof(NamePool));
+}
+
+void name_pool_release(NamePool *pool)
+{
+    /**
+        * Function Name: name_pool_release
+        *
+        * Purpose:
+        *    Frees the names of a pool.
+        *
+        * Parameters:
+        *     NamePool *pool - The pool taken with name_pool_take, empty afterwards.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - A taken pool left its session's memory counters with the session, so it is freed uncounted.
+        */
+    release_pool(pool, FALSE);
+}
+
+void name_pool_free()
+{
+    /**
+        * Function Name: name_pool_free
+        *
+        * Purpose:
+        *    Releases the calling thread's names.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Every name of the session's tables is gone, so they must be freed first or no longer read.
+        */
+    release_pool(&name_pool, TRUE);
+}
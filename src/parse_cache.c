@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+size_t parse_cache_budget = PARSE_CACHE_DEFAULT_BUDGET;
+THREAD_LOCAL ParseCache parse_cache;
+
+// counters of the caches already released, summed over every thread
+static atomic_long total_hits;
+static atomic_long total_misses;
+static atomic_long total_evictions;
+
+static uint64_t hash_line(const char *line, int length)
+{
+    /**
+        * Function Name: hash_line
+        *
+        * Purpose:
+        *    Hashes the raw bytes of a line with 64-bit FNV-1a.
+        *
+        * Parameters:
+        *     const char *line - The line.
+        *     int length - The number of bytes of the line.
+        *
+        * Return:
+        *     uint64_t - The hash.
+        */
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)line[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void unlink_recency(ParseCache *cache, ParseCacheEntry *entry)
+{
+    /**
+        * Function Name: unlink_recency
+        *
+        * Purpose:
+        *    Takes an entry out of the recency list.
+        *
+        * Parameters:
+        *     ParseCache *cache - The cache holding the entry.
+        *     ParseCacheEntry *entry - The entry.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (entry->newer != NULL)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+    if (entry->older != NULL)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+}
+
+static void link_newest(ParseCache *cache, ParseCacheEntry *entry)
+{
+    /**
+        * Function Name: link_newest
+        *
+        * Purpose:
+        *    Puts an entry at the most recently used end of the recency list.
+        *
+        * Parameters:
+        *     ParseCache *cache - The cache holding the entry.
+        *     ParseCacheEntry *entry - The entry.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL)
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+    cache->newest = entry;
+}
+
+static void evict_oldest(ParseCache *cache)
+{
+    /**
+        * Function Name: evict_oldest
+        *
+        * Purpose:
+        *    Drops the least recently used entry of the cache.
+        *
+        * Parameters:
+        *     ParseCache *cache - The cache, must not be empty.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    ParseCacheEntry *entry = cache->oldest;
+    unlink_recency(cache, entry);
+
+    ParseCacheEntry **link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while (*link != entry)
+        link = &(*link)->next_in_bucket;
+    *link = entry->next_in_bucket;
+
+    cache->bytes -= entry->size;
+    cache->entry_count--;
+    cache->evictions++;
+    mem_free(MEM_PARSE_CACHE, entry, entry->size);
+}
+
+static void ensure_bucket_capacity(ParseCache *cache)
+{
+    /**
+        * Function Name: ensure_bucket_capacity
+        *
+        * Purpose:
+        *    Ensures that the hash table of the cache has at least one bucket per entry.
+        *
+        * Parameters:
+        *     ParseCache *cache - The cache.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Allocates the buckets on first use, then doubles them and rehashes the entries when they are full.
+        */
+    if (cache->buckets == NULL)
+    {
+        cache->bucket_count = 64;
+        cache->buckets = mem_calloc(MEM_PARSE_CACHE, cache->bucket_count, sizeof(ParseCacheEntry *));
+        return;
+    }
+    if (cache->entry_count < cache->bucket_count)
+        return;
+
+    int bucket_count = cache->bucket_count * 2;
+    ParseCacheEntry **buckets = mem_calloc(MEM_PARSE_CACHE, bucket_count, sizeof(ParseCacheEntry *));
+    for (ParseCacheEntry *entry = cache->newest; entry != NULL; entry = entry->older)
+    {
+        ParseCacheEntry **bucket = &buckets[entry->hash & (bucket_count - 1)];
+        entry->next_in_bucket = *bucket;
+        *bucket = entry;
+    }
+    mem_free(MEM_PARSE_CACHE, cache->buckets, cache->bucket_count * sizeof(ParseCacheEntry *));
+    cache->buckets = buckets;
+    cache->bucket_count = bucket_count;
+}
+
+static void cache_command(ParseCache *cache, uint64_t hash, const char *line, int length, const Command *command)
+{
+    /**
+        * Function Name: cache_command
+        *
+        * Purpose:
+        *    Stores the command a line was parsed into, keyed by the raw bytes of the line.
+        *
+        * Parameters:
+        *     ParseCache *cache - The cache.
+        *     uint64_t hash - The hash of the line.
+        *     const char *line - The raw line, as it was read.
+        *     int length - The number of bytes of the line.
+        *     const Command *command - The parsed command.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The entry is one allocation holding the command, its items, the line and the names.
+        *     - Evicts least recently used entries until the entry fits in the byte budget.
+        */
+    size_t size = sizeof(ParseCacheEntry) + command->item_count * sizeof(CommandItem) + length + command->text_length;
+    if (size > parse_cache_budget)
+        return;
+    while (cache->bytes + size > parse_cache_budget)
+        evict_oldest(cache);
+    ensure_bucket_capacity(cache);
+
+    ParseCacheEntry *entry = mem_malloc(MEM_PARSE_CACHE, size);
+    entry->hash = hash;
+    entry->size = size;
+    entry->line_length = length;
+    entry->record = *command;
+    entry->record.items = (CommandItem *)(entry + 1);
+    entry->record.item_capacity = command->item_count;
+    entry->line = (char *)(entry->record.items + command->item_count);
+    entry->record.text = entry->line + length;
+    entry->record.text_capacity = command->text_length;
+    if (command->item_count > 0)
+        memcpy(entry->record.items, command->items, command->item_count * sizeof(CommandItem));
+    memcpy(entry->line, line, length);
+    if (command->text_length > 0)
+        memcpy(entry->record.text, command->text, command->text_length);
+
+    ParseCacheEntry **bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    link_newest(cache, entry);
+    cache->bytes += size;
+    cache->entry_count++;
+}
+
+void parse_line_cached(const char *line, Command *command)
+{
+    /**
+        * Function Name: parse_line_cached
+        *
+        * Purpose:
+        *    Same as parse_line, but a line seen before is not parsed again.
+        *
+        * Parameters:
+        *     const char *line - The line of input to be parsed.
+        *     Command *command - Receives the parsed command, its previous content is discarded.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Looks the raw bytes of the line up in the calling thread's cache. On a hit the stored command
+        *       is copied out, and the line is neither split nor validated.
+        *     - On a miss the line is parsed and its command stored, invalid lines included.
+        *     - Lines longer than MAX_LINE_LENGTH are parsed but not stored.
+        *     - Parses every line when parse_cache_budget is 0.
+        */
+    if (parse_cache_budget == 0)
+    {
+        parse_line(line, command);
+        return;
+    }
+
+    ParseCache *cache = &parse_cache;
+    int length = strlen(line);
+    uint64_t hash = hash_line(line, length);
+    if (cache->buckets != NULL)
+    {
+        for (ParseCacheEntry *entry = cache->buckets[hash & (cache->bucket_count - 1)]; entry != NULL; entry = entry->next_in_bucket)
+        {
+            if (entry->hash == hash && entry->line_length == length && memcmp(entry->line, line, length) == 0)
+            {
+                cache->hits++;
+                unlink_recency(cache, entry);
+                link_newest(cache, entry);
+                command_copy(command, &entry->record);
+                return;
+            }
+        }
+    }
+
+    cache->misses++;
+    if (length > MAX_LINE_LENGTH)
+    {
+        parse_line(line, command);
+        return;
+    }
+    parse_line(line, command);
+    cache_command(cache, hash, line, length, command);
+}
+
+void parse_cache_free()
+{
+    /**
+        * Function Name: parse_cache_free
+        *
+        * Purpose:
+        *    Releases the calling thread's parse cache.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Adds the cache's counters to the process totals reported by parse_cache_report.
+        *     - The next parse_line_cached on the thread starts with an empty cache.
+        */
+    ParseCache *cache = &parse_cache;
+    atomic_fetch_add(&total_hits, cache->hits);
+    atomic_fetch_add(&total_misses, cache->misses);
+    atomic_fetch_add(&total_evictions, cache->evictions);
+
+    while (cache->oldest != NULL)
+    {
+        ParseCacheEntry *entry = cache->oldest;
+        cache->oldest = entry->newer;
+        mem_free(MEM_PARSE_CACHE, entry, entry->size);
+    }
+    mem_free(MEM_PARSE_CACHE, cache->buckets, cache->bucket_count * sizeof(ParseCacheEntry *));
+    memset(cache, 0, sizeof(ParseCache));
+}
+
+void parse_cache_report()
+{
+    /**
+        * Function Name: parse_cache_report
+        *
+        * Purpose:
+        *    Prints the hits, misses and evictions of every parse cache released so far to stderr.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    long hits = atomic_load(&total_hits);
+    long misses = atomic_load(&total_misses);
+    long lookups = hits + misses;
+    fprintf(stderr, "Parse cache: %ld hits, %ld misses (%.1f%% hit rate), %ld evictions, %zu byte budget per thread\n",
+            hits, misses, lookups > 0 ? 100.0 * hits / lookups : 0.0, atomic_load(&total_evictions), parse_cache_budget);
+}
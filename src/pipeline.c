@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "globals.h"
+
+#define LINE_RING_SIZE 256
+#define COMMAND_RING_SIZE 256
+#define RESPONSE_RING_SIZE 1024
+#define QUERY_RING_SIZE 256
+
+typedef struct
+{
+    char line[MAX_LINE_LENGTH + 1];
+    Bool continued; // the line is too long for one slot and goes on in the next slot of the same ring
+    Bool end;
+} LineSlot;
+
+typedef struct
+{
+    Command command;
+    Bool end;
+} CommandSlot;
+
+typedef struct
+{
+    OutputBuffer buffer;
+    Bool end;
+    atomic_int ready; // set once the buffer is complete, queries are answered after the slot is published
+} ResponseSlot;
+
+typedef struct
+{
+    Command command;
+    Snapshot *snapshot; // the version the query must see, the state right before its line
+    ResponseSlot *response;
+    Bool end;
+} QuerySlot;
+
+// line n goes through parser n % parser_count, which keeps every ring single-producer/single-consumer
+// and lets the executor restore the input order by visiting the parsers round robin
+typedef struct
+{
+    FILE *input;
+    int parser_count;
+    SpscRing *line_rings;
+    SpscRing *command_rings;
+    SpscRing response_ring;
+    atomic_int stop;
+
+    // query readers, queries go to reader n % query_count in the order they are met
+    int query_count;
+    SpscRing *query_rings;
+    SnapshotStore store;
+    atomic_long written; // lines the writer is done with, a retired snapshot is freed once every line before its retirement is written
+    NamePool names;      // the executor's names, which the snapshots point at, kept until the query readers are done
+} Pipeline;
+
+typedef struct
+{
+    Pipeline *pipeline;
+    int index;
+} StageThread;
+
+static void *reader_thread(void *arg)
+{
+    /**
+        * Function Name: reader_thread
+        *
+        * Purpose:
+        *    First stage, splits the input into lines and deals them to the parsers round robin.
+        *
+        * Parameters:
+        *     void *arg - The Pipeline.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - A line longer than a slot is sent in chunks, all to the parser of the line.
+        *     - Sends an end marker to every parser at EOF.
+        */
+    Pipeline *pipeline = arg;
+    long sequence = 0;
+
+    while (1)
+    {
+        LineSlot *slot = ring_slot_for_write(&pipeline->line_rings[sequence % pipeline->parser_count], &pipeline->stop);
+        if (slot == NULL)
+            return NULL;
+        slot->end = !read_line_chunk(pipeline->input, slot->line, sizeof(slot->line), &slot->continued);
+        ring_publish(&pipeline->line_rings[sequence % pipeline->parser_count]);
+        if (slot->end)
+            break;
+        if (!slot->continued)
+            sequence++;
+    }
+
+    //the parser of the EOF position already has its end marker, the others still need one
+    for (int i = 1; i < pipeline->parser_count; i++)
+    {
+        SpscRing *ring = &pipeline->line_rings[(sequence + i) % pipeline->parser_count];
+        LineSlot *slot = ring_slot_for_write(ring, &pipeline->stop);
+        if (slot == NULL)
+            return NULL;
+        slot->end = TRUE;
+        ring_publish(ring);
+    }
+    return NULL;
+}
+
+static void *parser_thread(void *arg)
+{
+    /**
+        * Function Name: parser_thread
+        *
+        * Purpose:
+        *    Second stage, turns lines into validated commands.
+        *
+        * Parameters:
+        *     void *arg - The StageThread.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - Tokenizing and validation need no session state, so several parsers can run side by side.
+        *     - Commands are parsed into the slots of the command ring, reusing their buffers.
+        *     - The chunks of a long line are split and matched as they arrive, its command is sent with the last one.
+        *     - Each parser has its own parse cache and line parser, released when the parser stops.
+        */
+    StageThread *parser = arg;
+    Pipeline *pipeline = parser->pipeline;
+    SpscRing *lines = &pipeline->line_rings[parser->index];
+    SpscRing *commands = &pipeline->command_rings[parser->index];
+
+    Bool streaming = FALSE;
+    while (1)
+    {
+        LineSlot *in = ring_slot_for_read(lines, &pipeline->stop);
+        if (in == NULL)
+            break;
+        if (!in->end && (streaming || in->continued))
+        {
+            //a long line is split and matched chunk by chunk, its command is written with its last chunk
+            if (!streaming)
+                line_parser_begin();
+            line_parser_feed(in->line, strlen(in->line));
+            streaming = TRUE;
+            if (in->continued)
+            {
+                ring_release(lines);
+                continue;
+            }
+        }
+        CommandSlot *out = ring_slot_for_write(commands, &pipeline->stop);
+        if (out == NULL)
+            break;
+
+        out->end = in->end;
+        if (streaming)
+            line_parser_finish(&out->command);
+        else if (!in->end)
+            parse_line_cached(in->line, &out->command);
+        streaming = FALSE;
+
+        ring_publish(commands);
+        ring_release(lines);
+        if (out->end)
+            break;
+    }
+
+    //the parser's cache is in the memory report, though the parser runs no session
+    mem_stats_end_thread();
+    parse_cache_free();
+    line_parser_free();
+    mem_stats_free();
+    return NULL;
+}
+
+static void *executor_thread(void *arg)
+{
+    /**
+        * Function Name: executor_thread
+        *
+        * Purpose:
+        *    Third stage, executes the commands in input order on its own session.
+        *
+        * Parameters:
+        *     void *arg - The Pipeline.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - The only thread that changes the session tables.
+        *     - Collects the responses of each command in a slot of the response ring.
+        *     - With query readers, publishes a snapshot before a query if the tables changed since the last one,
+        *       and hands the query to a reader instead of answering it.
+        *     - Once EOF or Exit is reached, tells the other stages to stop.
+        */
+    Pipeline *pipeline = arg;
+    init_state();
+
+    Snapshot *snapshot = NULL;
+    unsigned dirty = 0;
+    int next_reader = 0;
+
+    long sequence = 0;
+    while (1)
+    {
+        SpscRing *commands = &pipeline->command_rings[sequence % pipeline->parser_count];
+        CommandSlot *in = ring_slot_for_read(commands, NULL);
+        ResponseSlot *out = ring_slot_for_write(&pipeline->response_ring, NULL);
+
+        //both EOF and Exit end the session after one last prompt, which the writer prints for the end marker
+        out->buffer.length = 0;
+        out->end = TRUE;
+        if (!in->end && pipeline->query_count > 0 && in->command.kind >= COMMAND_INGREDIENT_QUERY)
+        {
+            if (snapshot == NULL || dirty != 0)
+            {
+                //queries before this line hold the older versions, they are done once the writer got past them
+                snapshot_reclaim(&pipeline->store, atomic_load_explicit(&pipeline->written, memory_order_acquire));
+                snapshot = snapshot_publish(&pipeline->store, dirty, sequence);
+                dirty = 0;
+            }
+
+            //the writer waits for the reader to fill the slot, so the executor can go on right away
+            out->end = FALSE;
+            atomic_store_explicit(&out->ready, 0, memory_order_relaxed);
+            ring_publish(&pipeline->response_ring);
+
+            SpscRing *queries = &pipeline->query_rings[next_reader];
+            QuerySlot *query = ring_slot_for_write(queries, NULL);
+            command_copy(&query->command, &in->command);
+            query->snapshot = snapshot;
+            query->response = out;
+            query->end = FALSE;
+            ring_publish(queries);
+            next_reader = (next_reader + 1) % pipeline->query_count;
+
+            ring_release(commands);
+            sequence++;
+            continue;
+        }
+
+        if (!in->end)
+        {
+            output_buffer = &out->buffer;
+            out->end = !execute_command(&in->command);
+            output_buffer = NULL;
+            dirty |= snapshot_dirty_tables(in->command.kind);
+        }
+
+        Bool end = out->end;
+        atomic_store_explicit(&out->ready, 1, memory_order_relaxed);
+        ring_publish(&pipeline->response_ring);
+        ring_release(commands);
+        if (end)
+            break;
+        sequence++;
+    }
+
+    for (int i = 0; i < pipeline->query_count; i++)
+    {
+        QuerySlot *query = ring_slot_for_write(&pipeline->query_rings[i], NULL);
+        query->end = TRUE;
+        ring_publish(&pipeline->query_rings[i]);
+    }
+
+    atomic_store(&pipeline->stop, 1);
+    //readers may still answer from the last snapshots, the session is counted while it still holds the names
+    mem_stats_end_session();
+    name_pool_take(&pipeline->names);
+    free_state();
+    return NULL;
+}
+
+static void *query_thread(void *arg)
+{
+    /**
+        * Function Name: query_thread
+        *
+        * Purpose:
+        *    Answers queries against the snapshot the executor gave them, next to the executor and the other readers.
+        *
+        * Parameters:
+        *     void *arg - The StageThread.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - Reads the shared snapshot tables without locks and never changes them.
+        *     - Writes the response into the slot the executor reserved for the query's line.
+        */
+    StageThread *reader = arg;
+    SpscRing *queries = &reader->pipeline->query_rings[reader->index];
+
+    while (1)
+    {
+        QuerySlot *query = ring_slot_for_read(queries, NULL);
+        if (query->end)
+            break;
+
+        snapshot_install(query->snapshot);
+        output_buffer = &query->response->buffer;
+        execute_command(&query->command);
+        output_buffer = NULL;
+
+        atomic_store_explicit(&query->response->ready, 1, memory_order_release);
+        ring_release(queries);
+    }
+    return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+    /**
+        * Function Name: writer_thread
+        *
+        * Purpose:
+        *    Last stage, writes the responses with the same prompts as the interactive loop.
+        *
+        * Parameters:
+        *     void *arg - The Pipeline.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - Writes ">> " and the responses of each line to stdout, byte for byte what the sequential loop prints.
+        */
+    Pipeline *pipeline = arg;
+    while (1)
+    {
+        ResponseSlot *slot = ring_slot_for_read(&pipeline->response_ring, NULL);
+        int spins = 0;
+        while (!atomic_load_explicit(&slot->ready, memory_order_acquire))
+            ring_wait(&spins);
+        fputs(">> ", stdout);
+        //a line without a response, such as Exit, has no buffer yet
+        if (slot->buffer.length > 0)
+            fwrite(slot->buffer.data, 1, slot->buffer.length, stdout);
+        Bool end = slot->end;
+        ring_release(&pipeline->response_ring);
+        atomic_store_explicit(&pipeline->written, atomic_load_explicit(&pipeline->written, memory_order_relaxed) + 1, memory_order_release);
+        if (end)
+            break;
+    }
+    fflush(stdout);
+    return NULL;
+}
+
+int run_pipeline(FILE *input, int parser_count, int query_count)
+{
+    /**
+        * Function Name: run_pipeline
+        *
+        * Purpose:
+        *    Executes a session with reading, parsing, executing and writing on separate threads.
+        *
+        * Parameters:
+        *     FILE *input - The lines of the session.
+        *     int parser_count - The number of parser threads, all cores but three if not positive.
+        *     int query_count - The number of query reader threads, queries are answered by the executor if 0.
+        *
+        * Return:
+        *     int - Always 0.
+        *
+        * Side Effects:
+        *     - Stages are connected by bounded lock-free single-producer/single-consumer rings.
+        *     - The output is byte for byte the same as the interactive loop fed with the same input.
+        */
+    if (parser_count <= 0)
+        parser_count = (int)sysconf(_SC_NPROCESSORS_ONLN) - 3;
+    if (parser_count < 1)
+        parser_count = 1;
+
+    Pipeline pipeline;
+    pipeline.input = input;
+    pipeline.parser_count = parser_count;
+    pipeline.line_rings = malloc(parser_count * sizeof(SpscRing));
+    pipeline.command_rings = malloc(parser_count * sizeof(SpscRing));
+    for (int i = 0; i < parser_count; i++)
+    {
+        ring_init(&pipeline.line_rings[i], sizeof(LineSlot), LINE_RING_SIZE);
+        ring_init(&pipeline.command_rings[i], sizeof(CommandSlot), COMMAND_RING_SIZE);
+    }
+    ring_init(&pipeline.response_ring, sizeof(ResponseSlot), RESPONSE_RING_SIZE);
+    atomic_init(&pipeline.stop, 0);
+
+    pipeline.query_count = query_count;
+    pipeline.query_rings = malloc(query_count * sizeof(SpscRing));
+    for (int i = 0; i < query_count; i++)
+        ring_init(&pipeline.query_rings[i], sizeof(QuerySlot), QUERY_RING_SIZE);
+    snapshot_store_init(&pipeline.store);
+    atomic_init(&pipeline.written, 0);
+
+    pthread_t reader, executor, writer;
+    pthread_t *parsers = malloc(parser_count * sizeof(pthread_t));
+    StageThread *parser_args = malloc(parser_count * sizeof(StageThread));
+    pthread_t *readers = malloc(query_count * sizeof(pthread_t));
+    StageThread *reader_args = malloc(query_count * sizeof(StageThread));
+
+    pthread_create(&writer, NULL, writer_thread, &pipeline);
+    for (int i = 0; i < query_count; i++)
+    {
+        reader_args[i].pipeline = &pipeline;
+        reader_args[i].index = i;
+        pthread_create(&readers[i], NULL, query_thread, &reader_args[i]);
+    }
+    pthread_create(&executor, NULL, executor_thread, &pipeline);
+    for (int i = 0; i < parser_count; i++)
+    {
+        parser_args[i].pipeline = &pipeline;
+        parser_args[i].index = i;
+        pthread_create(&parsers[i], NULL, parser_thread, &parser_args[i]);
+    }
+    pthread_create(&reader, NULL, reader_thread, &pipeline);
+
+    pthread_join(executor, NULL);
+    pthread_join(writer, NULL);
+    for (int i = 0; i < parser_count; i++)
+        pthread_join(parsers[i], NULL);
+    pthread_join(reader, NULL);
+    for (int i = 0; i < query_count; i++)
+        pthread_join(readers[i], NULL);
+
+    for (int i = 0; i < parser_count; i++)
+    {
+        for (int j = 0; j < COMMAND_RING_SIZE; j++)
+            command_free(&((CommandSlot *)ring_slot(&pipeline.command_rings[i], j))->command);
+        ring_free(&pipeline.line_rings[i]);
+        ring_free(&pipeline.command_rings[i]);
+    }
+    for (int j = 0; j < RESPONSE_RING_SIZE; j++)
+        free(((ResponseSlot *)ring_slot(&pipeline.response_ring, j))->buffer.data);
+    ring_free(&pipeline.response_ring);
+    for (int i = 0; i < query_count; i++)
+    {
+        for (int j = 0; j < QUERY_RING_SIZE; j++)
+            command_free(&((QuerySlot *)ring_slot(&pipeline.query_rings[i], j))->command);
+        ring_free(&pipeline.query_rings[i]);
+    }
+    snapshot_store_free(&pipeline.store);
+    name_pool_release(&pipeline.names);
+
+    free(pipeline.line_rings);
+    free(pipeline.command_rings);
+    free(parsers);
+    free(parser_args);
+    free(pipeline.query_rings);
+    free(readers);
+    free(reader_args);
+    return 0;
+}
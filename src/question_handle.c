@@ -3,7 +3,7 @@
 #include <string.h>
 #include "globals.h"
 
-void handle_specific_ingredient_query(char words[][MAX_WORD_LEN], int word_count)
+void handle_specific_ingredient_query(const char *ingredient_name)
 {
     /**
         * Function Name: handle_specific_ingredient_query
@@ -12,8 +12,7 @@ void handle_specific_ingredient_query(char words[][MAX_WORD_LEN], int word_count
         *    Handles the query for a specific ingredient and prints its quantity.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The number of words in the input line.
+        *     const char *ingredient_name - The name of the ingredient.
         *
         * Return:
         *     void - This function does not return a value.
@@ -22,8 +21,6 @@ void handle_specific_ingredient_query(char words[][MAX_WORD_LEN], int word_count
         *     - Prints the quantity of the specified ingredient.
         *     - If the ingredient is not found, prints 0.
      */
-    char ingredient_name[MAX_WORD_LEN];
-    strcpy(ingredient_name, words[2]);
     int quantity = 0;
 
     for (int i = 0; i <= last_added_ingredient_index; i++)
@@ -35,11 +32,10 @@ void handle_specific_ingredient_query(char words[][MAX_WORD_LEN], int word_count
         }
     }
 
-    printf("%d", quantity);
-    printf("\n");
+    respond_quantity(quantity);
 }
 
-void handle_specific_potion_query(char words[][MAX_WORD_LEN], int word_count, char const *line)
+void handle_specific_potion_query(const char *potion_name)
 {
     /**
         * Function Name: handle_specific_potion_query
@@ -48,9 +44,7 @@ void handle_specific_potion_query(char words[][MAX_WORD_LEN], int word_count, ch
         *    Handles the query for a specific potion and prints its quantity.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The number of words in the input line.
-        *     const char *line - The original input line.
+        *     const char *potion_name - The name of the potion, its spacing already checked by parse_line.
         *
         * Return:
         *     void - This function does not return a value.
@@ -58,29 +52,7 @@ void handle_specific_potion_query(char words[][MAX_WORD_LEN], int word_count, ch
         * Side Effects:
         *     - Prints the quantity of the specified potion.
         *     - If the potion is not found, prints 0.
-        *     - If the potion name is invalid, prints "INVALID".
      */
-    char potion_name[MAX_LINE_LENGTH] = "";
-
-    for (int i = 2; i < word_count; i++)
-    {
-        if (strcmp(words[i], "?") == 0)
-            break;
-        strcat(potion_name, words[i]);
-        if (i < word_count - 2)
-        {
-            strcat(potion_name, " ");
-        }
-    }
-    //we first construct the potion name and check if there is multiple spaces between words
-    //if not valid we print INVALID and stop
-    //else we get the quantity of the potion
-    if (!is_valid_potion_name_spacing(line, potion_name))
-    {
-        printf("INVALID\n");
-        return;
-    }
-
     int quantity = 0;
 
     for (int i = 0; i <= last_added_potion_index; i++)
@@ -92,11 +64,10 @@ void handle_specific_potion_query(char words[][MAX_WORD_LEN], int word_count, ch
         }
     }
 
-    printf("%d", quantity);
-    printf("\n");
+    respond_quantity(quantity);
 }
 
-void handle_specific_trophy_query(char words[][MAX_WORD_LEN], int word_count)
+void handle_specific_trophy_query(const char *trophy_name)
 {
     /**
         * Function Name: handle_specific_trophy_query
@@ -105,8 +76,7 @@ void handle_specific_trophy_query(char words[][MAX_WORD_LEN], int word_count)
         *    Handles the query for a specific trophy and prints its quantity.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The number of words in the input line.
+        *     const char *trophy_name - The name of the trophy.
         *
         * Return:
         *     void - This function does not return a value.
@@ -115,8 +85,6 @@ void handle_specific_trophy_query(char words[][MAX_WORD_LEN], int word_count)
         *     - Prints the quantity of the specified trophy.
         *     - If the trophy is not found, prints 0.
      */
-    char trophy_name[MAX_WORD_LEN];
-    strcpy(trophy_name, words[2]);
     int quantity = 0;
 
     for (int i = 0; i <= last_added_trophy_index; i++)
@@ -128,8 +96,7 @@ void handle_specific_trophy_query(char words[][MAX_WORD_LEN], int word_count)
         }
     }
 
-    printf("%d", quantity);
-    printf("\n");
+    respond_quantity(quantity);
 }
 
 void handle_all_ingredients_query()
@@ -152,26 +119,33 @@ void handle_all_ingredients_query()
      */
     if (last_added_ingredient_index == -1)
     {
-        printf("None\n");
+        respond(RESPONSE_NONE, NULL);
         return;
     }
 
     //since we need the ingredients in alpahabetical order we sort them using our custom ingredient comparator
     //we use qsort to sort the ingredients array
     //and print them with their quantities in the necessary format
-    qsort(ingredients, last_added_ingredient_index + 1, sizeof(Ingredient), cmpIngredient);
+    //snapshot tables are shared between threads and already published in name order
+    if (!tables_read_only)
+    {
+        qsort(ingredients, last_added_ingredient_index + 1, sizeof(Ingredient), cmpIngredient);
+        inventory_index_reordered(RANK_INGREDIENTS);
+    }
 
+    int printed = 0;
+    respond_list_begin(RESPONSE_ITEMS, FALSE);
     for (int i = 0; i <= last_added_ingredient_index; i++)
     {
         if (ingredients[i].quantity == 0)
             continue;
-        printf("%d %s", ingredients[i].quantity, ingredients[i].name);
-        if (i < last_added_ingredient_index)
-        {
-            printf(", ");
-        }
+        respond_item(ingredients[i].quantity, ingredients[i].name);
+        printed++;
     }
-    printf("\n");
+    //the text answer has always ended with a separator when the last items are out of stock
+    if (printed > 0 && ingredients[last_added_ingredient_index].quantity == 0)
+        respond_text_only(", ");
+    respond_list_end();
 }
 
 void handle_all_potions_query()
@@ -194,26 +168,33 @@ void handle_all_potions_query()
      */
     if (last_added_potion_index == -1)
     {
-        printf("None\n");
+        respond(RESPONSE_NONE, NULL);
         return;
     }
     //since we need the potions in alpahabetical order we sort them using our custom potion comparator
     //we use qsort to sort the potions array
     //and print them with their quantities in the necessary format
     //we don't do potion name check here because if the potion is already stored then its name was valid when the input was taken
-    qsort(potions, last_added_potion_index + 1, sizeof(Potion), cmpPotion);
+    //snapshot tables are shared between threads and already published in name order
+    if (!tables_read_only)
+    {
+        qsort(potions, last_added_potion_index + 1, sizeof(Potion), cmpPotion);
+        inventory_index_reordered(RANK_POTIONS);
+    }
 
+    int printed = 0;
+    respond_list_begin(RESPONSE_ITEMS, FALSE);
     for (int i = 0; i <= last_added_potion_index; i++)
     {
         if (potions[i].quantity == 0)
             continue;
-        printf("%d %s", potions[i].quantity, potions[i].name);
-        if (i < last_added_potion_index)
-        {
-            printf(", ");
-        }
+        respond_item(potions[i].quantity, potions[i].name);
+        printed++;
     }
-    printf("\n");
+    //the text answer has always ended with a separator when the last items are out of stock
+    if (printed > 0 && potions[last_added_potion_index].quantity == 0)
+        respond_text_only(", ");
+    respond_list_end();
 }
 
 void handle_all_trophies_query()
@@ -236,29 +217,36 @@ void handle_all_trophies_query()
      */
     if (last_added_trophy_index == -1)
     {
-        printf("None\n");
+        respond(RESPONSE_NONE, NULL);
         return;
     }
 
     //since we need the trophies in alpahabetical order we sort them using our custom trophy comparator
     //we use qsort to sort the trophies array
     //and print them with their quantities in the necessary format
-    qsort(trophies, last_added_trophy_index + 1, sizeof(Trophy), cmpTrophy);
+    //snapshot tables are shared between threads and already published in name order
+    if (!tables_read_only)
+    {
+        qsort(trophies, last_added_trophy_index + 1, sizeof(Trophy), cmpTrophy);
+        inventory_index_reordered(RANK_TROPHIES);
+    }
 
+    int printed = 0;
+    respond_list_begin(RESPONSE_ITEMS, FALSE);
     for (int i = 0; i <= last_added_trophy_index; i++)
     {
         if (trophies[i].quantity == 0)
             continue;
-        printf("%d %s", trophies[i].quantity, trophies[i].name);
-        if (i < last_added_trophy_index)
-        {
-            printf(", ");
-        }
+        respond_item(trophies[i].quantity, trophies[i].name);
+        printed++;
     }
-    printf("\n");
+    //the text answer has always ended with a separator when the last items are out of stock
+    if (printed > 0 && trophies[last_added_trophy_index].quantity == 0)
+        respond_text_only(", ");
+    respond_list_end();
 }
 
-void handle_monster_query(char words[][MAX_WORD_LEN], int word_count)
+void handle_monster_query(const char *monster_name)
 {
     /**
         * Function Name: handle_monster_query
@@ -267,64 +255,84 @@ void handle_monster_query(char words[][MAX_WORD_LEN], int word_count)
         *    Handles the query for a specific monster and prints the signs and potions that can be used against it.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The number of words in the input line.
+        *     const char *monster_name - The name of the monster.
         *
         * Return:
         *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - Prints the signs and potions of the specified monster in alphabetical order.
+        *     - Prints the signs and potions of the specified monster in alphabetical order, allocating nothing.
         *     - If the monster is not found, prints "No knowledge of <monster_name>".
      */
-    char monster_name[MAX_WORD_LEN];
-    strcpy(monster_name, words[4]);
 
-    for (int i = 0; i <= last_added_monster_index; i++)
+    Monster *m = NULL;
+    if (tables_read_only)
+    {
+        //snapshot monsters are published in name order
+        int position = first_name_from(monsters, last_added_monster_index + 1, sizeof(Monster), monster_name);
+        if (position <= last_added_monster_index && strcmp(monsters[position].name, monster_name) == 0)
+            m = &monsters[position];
+    }
+    else
     {
-        //we traverse the array to find the monster
-        if (strcmp(monsters[i].name, monster_name) == 0)
+        for (int i = 0; i <= last_added_monster_index; i++)
         {
-            //when we find it we create an array to store the signs and potions effective against it
-            //and compare it using our custom string comparator to print in alphabetical order
-            //we use a string comparator because no quantity exists and we only handle the names of potions and signs
-            int cnt = 0;
-            int total = monsters[i].sign_count + monsters[i].potion_count;
-            char **signs_potions = malloc(total * sizeof(char *));
-            for (int k = 0; k < total; k++)
-                signs_potions[k] = malloc(MAX_WORD_LEN);
-
-            for (int j = 0; j < monsters[i].sign_count; j++)
+            //we traverse the array to find the monster
+            if (strcmp(monsters[i].name, monster_name) == 0)
             {
-                strcpy(signs_potions[cnt], monsters[i].signs[j].name);
-                cnt++;
-            }
-            for (int j = 0; j < monsters[i].potion_count; j++)
-            {
-                strcpy(signs_potions[cnt], monsters[i].potions[j].name);
-                cnt++;
+                m = &monsters[i];
+                break;
             }
+        }
+    }
+    //the knowledge base entry and what the session learned on top of it are listed together
+    const KbMonster *known_monster = kb_find_monster(monster_name);
 
-            qsort(signs_potions, cnt, sizeof(char *), cmp);
+    if (m == NULL && known_monster == NULL)
+    {
+        respond(RESPONSE_NO_KNOWLEDGE, monster_name);
+        return;
+    }
 
-            for (int j = 0; j < cnt; j++)
-            {
-                printf("%s", signs_potions[j]);
-                if (j < cnt - 1)
-                {
-                    printf(", ");
-                }
-                free(signs_potions[j]);
-            }
-            free(signs_potions);
-            printf("\n");
-            return;
+    //the signs and the potions of the session and of the knowledge base are each kept in name order,
+    //so they are merged straight into the output without copying or sorting, signs and potions share a layout
+    const Potion *lists[4];
+    int counts[4];
+    int list_count = 0;
+    if (m != NULL)
+    {
+        lists[list_count] = (const Potion *)m->signs;
+        counts[list_count++] = m->sign_count;
+        lists[list_count] = m->potions;
+        counts[list_count++] = m->potion_count;
+    }
+    if (known_monster != NULL)
+    {
+        lists[list_count] = (const Potion *)kb_monster_signs(known_monster);
+        counts[list_count++] = known_monster->sign_count;
+        lists[list_count] = kb_monster_potions(known_monster);
+        counts[list_count++] = known_monster->potion_count;
+    }
+
+    respond_list_begin(RESPONSE_NAMES, FALSE);
+    while (TRUE)
+    {
+        int next = -1;
+        for (int l = 0; l < list_count; l++)
+        {
+            if (counts[l] > 0 && (next < 0 || strcmp(lists[l]->name, lists[next]->name) < 0))
+                next = l;
         }
+        if (next < 0)
+            break;
+        respond_name(lists[next]->name);
+        lists[next]++;
+        counts[next]--;
     }
-    printf("No knowledge of %s\n", monster_name);
+    respond_list_end();
 }
 
-void handle_potion_recipe_query(char words[][MAX_WORD_LEN], int word_count, const char *line)
+void handle_potion_recipe_query(const char *potion_name)
 {
     /**
         * Function Name: handle_potion_recipe_query
@@ -333,69 +341,520 @@ void handle_potion_recipe_query(char words[][MAX_WORD_LEN], int word_count, cons
         *    Handles the query for a potion recipe and prints the ingredients required to brew it.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The number of words in the input line.
-        *     const char *line - The original input line.
+        *     const char *potion_name - The name of the potion, its spacing already checked by parse_line.
         *
         * Return:
         *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - Prints the ingredients required to brew the specified potion in decreasing quantity order.
+        *     - Prints the ingredients required to brew the specified potion in decreasing quantity order,
+        *       with no copy or sort.
         *     - If the potion is not found, prints "No formula for <potion_name>".
-        *     - If the potion name is invalid, prints "INVALID".
      */
-    char potion_name[MAX_LINE_LENGTH] = "";
+    //we look the potion up in the session's formulas and then in the knowledge base
+    //a formula keeps its ingredients in decreasing quantity order, then alphabetical order, so they are printed as they are
+    PotionFormula *formula = get_formula(potion_name, formulas);
+    if (formula == NULL || formula->ingredient_count == 0)
+    {
+        respond(RESPONSE_NO_FORMULA, potion_name);
+        return;
+    }
+
+    respond_list_begin(RESPONSE_ITEMS, FALSE);
+    for (int j = 0; j < formula->ingredient_count; j++)
+        respond_item(formula->ingredients[j].quantity, formula->ingredients[j].name);
+    respond_list_end();
+}
+
+void handle_brewable_query()
+{
+    /**
+        * Function Name: handle_brewable_query
+        *
+        * Purpose:
+        *    Handles the query for the potions that can be brewed with the current inventory.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints the names of the brewable potions in alphabetical order.
+        *     - If no potion can be brewed, prints "None".
+     */
+    //the brew index already knows which formulas have every requirement met, so nothing is scanned here
+    //snapshot readers get the same list already copied and sorted
+    Potion *brewable = NULL;
+    int count;
+    if (tables_read_only)
+    {
+        brewable = brewable_view->items;
+        count = brewable_view->count;
+    }
+    else
+    {
+        brewable = mem_malloc(MEM_TEMPORARIES, (brew_index.brewable_count + 1) * sizeof(Potion));
+        count = brew_index_collect(brewable);
+        qsort(brewable, count, sizeof(Potion), cmpPotion);
+    }
+
+    respond_list_begin(RESPONSE_NAMES, TRUE);
+    for (int i = 0; i < count; i++)
+        respond_name(brewable[i].name);
+    respond_list_end();
+
+    if (!tables_read_only)
+        mem_free(MEM_TEMPORARIES, brewable, (brew_index.brewable_count + 1) * sizeof(Potion));
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmp_name
+        *
+        * Purpose:
+        *    Compares two names of a list of name pointers, for sorting.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first name pointer.
+        *     const void *b - Pointer to the second name pointer.
+        *
+        * Return:
+        *     int - Negative if a < b, positive if a > b, zero if equal.
+        */
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static void print_name_list(const char **names, int count)
+{
+    /**
+        * Function Name: print_name_list
+        *
+        * Purpose:
+        *    Prints names in alphabetical order, each once.
+        *
+        * Parameters:
+        *     const char **names - The names, sorted in place.
+        *     int count - The number of names.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - If there are no names, prints "None".
+        */
+    qsort(names, count, sizeof(const char *), cmp_name);
+    respond_list_begin(RESPONSE_NAMES, TRUE);
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0 && strcmp(names[i], names[i - 1]) == 0)
+            continue;
+        respond_name(names[i]);
+    }
+    respond_list_end();
+}
+
+void handle_uses_query(const char *ingredient_name)
+{
+    /**
+        * Function Name: handle_uses_query
+        *
+        * Purpose:
+        *    Handles the query for the potions whose formulas require an ingredient.
+        *
+        * Parameters:
+        *     const char *ingredient_name - The name of the ingredient.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints the names of the potions in alphabetical order.
+        *     - If no formula requires the ingredient, prints "None".
+     */
+    //the brew index and the knowledge base file every requirement under its ingredient,
+    //so only the formulas in the answer are visited
+    //snapshot readers get the session's postings already copied and sorted
+    int kb_count;
+    const KbRequirement *kb_requirements = kb_find_requirements(ingredient_name, &kb_count);
+    const BrewIngredient *entry = NULL;
+    const Posting *postings = NULL;
+    int session_count = 0;
+    if (tables_read_only)
+        postings = snapshot_find_postings(uses_view, ingredient_name, &session_count);
+    else if ((entry = brew_index_find(ingredient_name)) != NULL)
+        session_count = entry->requirement_count;
+
+    const char **names = mem_malloc(MEM_TEMPORARIES, (session_count + kb_count + 1) * sizeof(const char *));
+    int count = 0;
+    for (int i = 0; i < session_count; i++)
+        names[count++] = tables_read_only ? postings[i].owner : formulas[entry->requirements[i].formula].name;
+    for (int i = 0; i < kb_count; i++)
+        names[count++] = kb_name(knowledge_base->formulas[kb_requirements[i].formula].name);
+
+    print_name_list(names, count);
+    mem_free(MEM_TEMPORARIES, names, (session_count + kb_count + 1) * sizeof(const char *));
+}
+
+void handle_effective_against_query(const char *name)
+{
+    /**
+        * Function Name: handle_effective_against_query
+        *
+        * Purpose:
+        *    Handles the query for the monsters a sign or potion is effective against.
+        *
+        * Parameters:
+        *     const char *name - The name of the sign or potion, its spacing already checked by parse_line.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints the names of the monsters in alphabetical order.
+        *     - If the sign or potion is not effective against any known monster, prints "None".
+     */
+    //the reverse of handle_monster_query, answered from the bestiary index and the knowledge base
+    //without walking the monsters
+    int kb_count;
+    const KbEffect *kb_effects = kb_find_effects(name, &kb_count);
+    const BestiaryEntry *entry = NULL;
+    const Posting *postings = NULL;
+    int session_count = 0;
+    if (tables_read_only)
+        postings = snapshot_find_postings(effective_view, name, &session_count);
+    else if ((entry = bestiary_index_find(name)) != NULL)
+        session_count = entry->monster_count;
+
+    const char **names = mem_malloc(MEM_TEMPORARIES, (session_count + kb_count + 1) * sizeof(const char *));
+    int count = 0;
+    for (int i = 0; i < session_count; i++)
+        names[count++] = tables_read_only ? postings[i].owner : monsters[entry->monsters[i]].name;
+    for (int i = 0; i < kb_count; i++)
+        names[count++] = kb_name(knowledge_base->monsters[kb_effects[i].monster].name);
+
+    print_name_list(names, count);
+    mem_free(MEM_TEMPORARIES, names, (session_count + kb_count + 1) * sizeof(const char *));
+}
+
+void handle_top_query(RankTable table, int count)
+{
+    /**
+        * Function Name: handle_top_query
+        *
+        * Purpose:
+        *    Handles the query for the most plentiful items of an inventory.
+        *
+        * Parameters:
+        *     RankTable table - The inventory, of ingredients, potions or trophies.
+        *     int count - The number of items asked for.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints up to count items with their quantities, largest quantity first and in alphabetical order
+        *       for equal quantities.
+        *     - If nothing is in stock, prints "None".
+     */
+    //the rank index keeps the inventory in this order, so only the items printed are visited
+    //snapshot readers get the same order already copied
+    int printed = 0;
+    respond_list_begin(RESPONSE_ITEMS, TRUE);
+    if (tables_read_only)
+    {
+        const Ingredient *ranked = ranked_view[table]->items;
+        for (; printed < count && printed < ranked_view[table]->count; printed++)
+            respond_item(ranked[printed].quantity, ranked[printed].name);
+    }
+    else
+    {
+        for (const RankNode *node = rank_index_first(table); node != NULL && printed < count; node = node->next[0], printed++)
+            respond_item(node->quantity, node->name);
+    }
 
-    for (int i = 3; i < word_count - 1; i++)
+    respond_list_end();
+}
+
+void handle_below_query(RankTable table, int quantity)
+{
+    /**
+        * Function Name: handle_below_query
+        *
+        * Purpose:
+        *    Handles the query for the items of an inventory in stock with less than a quantity.
+        *
+        * Parameters:
+        *     RankTable table - The inventory, of ingredients, potions or trophies.
+        *     int quantity - The threshold.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints the items with their quantities, largest quantity first and in alphabetical order
+        *       for equal quantities.
+        *     - If no item in stock is below the threshold, prints "None".
+     */
+    //the items below the threshold are the tail of the rank order, found in O(log n)
+    respond_list_begin(RESPONSE_ITEMS, TRUE);
+    if (tables_read_only)
     {
-        strcat(potion_name, words[i]);
-        if (i < word_count - 2)
+        const Ingredient *ranked = ranked_view[table]->items;
+        int low = 0;
+        int high = ranked_view[table]->count;
+        while (low < high)
         {
-            strcat(potion_name, " ");
+            int middle = (low + high) / 2;
+            if (ranked[middle].quantity >= quantity)
+                low = middle + 1;
+            else
+                high = middle;
         }
+        for (int i = low; i < ranked_view[table]->count; i++)
+            respond_item(ranked[i].quantity, ranked[i].name);
+    }
+    else
+    {
+        for (const RankNode *node = rank_index_first_below(table, quantity); node != NULL; node = node->next[0])
+            respond_item(node->quantity, node->name);
     }
 
-    if (!is_valid_potion_name_spacing(line, potion_name))
+    respond_list_end();
+}
+
+void handle_multi_quantity_query(const Command *command, const Ingredient *items, int item_count)
+{
+    /**
+        * Function Name: handle_multi_quantity_query
+        *
+        * Purpose:
+        *    Handles the query for the quantities of several ingredients, potions or trophies at once.
+        *
+        * Parameters:
+        *     const Command *command - The query, one item per name asked for.
+        *     const Ingredient *items - The table the names are looked up in, potions and trophies share this layout.
+        *     int item_count - The number of items of the table.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints every name asked for with its quantity, in the order asked, 0 for a name not found.
+        */
+    //the names asked for go in a small hash table, so the table is scanned once for all of them
+    //instead of once per name
+    int slot_count = 4;
+    while (slot_count < 2 * command->item_count)
+        slot_count *= 2;
+    int *slots = mem_malloc(MEM_TEMPORARIES, slot_count * sizeof(int));
+    int *quantities = mem_malloc(MEM_TEMPORARIES, command->item_count * sizeof(int));
+    int *first_asked = mem_malloc(MEM_TEMPORARIES, command->item_count * sizeof(int));
+    memset(slots, -1, slot_count * sizeof(int));
+
+    for (int i = 0; i < command->item_count; i++)
     {
-        printf("INVALID\n");
-        return;
+        const char *name = command_text(command, command->items[i].name);
+        int slot = hash_name(name) & (slot_count - 1);
+        while (slots[slot] >= 0 && strcmp(command_text(command, command->items[slots[slot]].name), name) != 0)
+            slot = (slot + 1) & (slot_count - 1);
+        if (slots[slot] < 0)
+            slots[slot] = i;
+        first_asked[i] = slots[slot];
+        quantities[i] = 0;
     }
 
-    for (int i = 0; i <= last_added_formula_index; i++)
+    for (int i = 0; i < item_count; i++)
+    {
+        int slot = hash_name(items[i].name) & (slot_count - 1);
+        while (slots[slot] >= 0 && strcmp(command_text(command, command->items[slots[slot]].name), items[i].name) != 0)
+            slot = (slot + 1) & (slot_count - 1);
+        if (slots[slot] >= 0)
+            quantities[slots[slot]] = items[i].quantity;
+    }
+
+    respond_list_begin(RESPONSE_ITEMS, FALSE);
+    for (int i = 0; i < command->item_count; i++)
+        respond_item(quantities[first_asked[i]], command_text(command, command->items[i].name));
+    respond_list_end();
+
+    mem_free(MEM_TEMPORARIES, slots, slot_count * sizeof(int));
+    mem_free(MEM_TEMPORARIES, quantities, command->item_count * sizeof(int));
+    mem_free(MEM_TEMPORARIES, first_asked, command->item_count * sizeof(int));
+}
+
+void handle_prefix_query(RankTable table, const char *pattern)
+{
+    /**
+        * Function Name: handle_prefix_query
+        *
+        * Purpose:
+        *    Handles the query for the ingredients, potions, trophies or monsters whose names start with a prefix.
+        *
+        * Parameters:
+        *     RankTable table - The table.
+        *     const char *pattern - The prefix followed by '*'.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints the matching items in stock with their quantities, or the matching monsters of the session
+        *       and of the knowledge base, in alphabetical order.
+        *     - If nothing matches, prints "None".
+     */
+    //the matches are a run of the name order, found in O(log n) and walked to its end
+    //snapshot readers search their tables, which are published in name order
+    int length = strlen(pattern) - 1;
+    char *prefix = mem_malloc(MEM_TEMPORARIES, length + 1);
+    memcpy(prefix, pattern, length);
+    prefix[length] = '\0';
+
+    if (table != RANK_MONSTERS)
     {
-        //we traverse the array to find the potion
-        //when we find it we create an array to store the ingredients
-        //and compare it using our custom recipe comparator to print in decreasing quantity order, if same in alphabetical order
-        if (strcmp(formulas[i].name, potion_name) == 0)
+        respond_list_begin(RESPONSE_ITEMS, TRUE);
+        if (tables_read_only)
         {
-            if (formulas[i].ingredient_count == 0)
-            {
-                printf("No formula for %s\n", potion_name);
-                return;
-            }
+            const Ingredient *items = table == RANK_INGREDIENTS ? ingredients : table == RANK_POTIONS ? (const Ingredient *)potions : (const Ingredient *)trophies;
+            int count = 1 + (table == RANK_INGREDIENTS ? last_added_ingredient_index : table == RANK_POTIONS ? last_added_potion_index : last_added_trophy_index);
+            for (int i = first_name_from(items, count, sizeof(Ingredient), prefix); i < count && strncmp(items[i].name, prefix, length) == 0; i++)
+                if (items[i].quantity != 0)
+                    respond_item(items[i].quantity, items[i].name);
+        }
+        else
+        {
+            for (const RankNode *node = rank_index_first_from(table, prefix); node != NULL && strncmp(node->name, prefix, length) == 0; node = node->next_by_name[0])
+                if (node->quantity != 0)
+                    respond_item(node->quantity, node->name);
+        }
+        respond_list_end();
+        mem_free(MEM_TEMPORARIES, prefix, length + 1);
+        return;
+    }
 
-            Ingredient *ingredients_in_formula = malloc(formulas[i].ingredient_count * sizeof(Ingredient));
-            for (int j = 0; j < formulas[i].ingredient_count; j++)
-            {
-                strcpy(ingredients_in_formula[j].name, formulas[i].ingredients[j].name);
-                ingredients_in_formula[j].quantity = formulas[i].ingredients[j].quantity;
-            }
+    //the monsters of the session and of the knowledge base are both in name order, so they are merged
+    const RankNode *node = tables_read_only ? NULL : rank_index_first_from(RANK_MONSTERS, prefix);
+    int position = tables_read_only ? first_name_from(monsters, last_added_monster_index + 1, sizeof(Monster), prefix) : 0;
+    int kb_position = kb_first_monster_from(prefix);
+    respond_list_begin(RESPONSE_NAMES, TRUE);
+    while (1)
+    {
+        const char *session_name = NULL;
+        if (tables_read_only && position <= last_added_monster_index)
+            session_name = monsters[position].name;
+        else if (!tables_read_only && node != NULL)
+            session_name = node->name;
+        if (session_name != NULL && strncmp(session_name, prefix, length) != 0)
+            session_name = NULL;
+        const char *known_name = NULL;
+        if (knowledge_base != NULL && kb_position < knowledge_base->monster_count)
+            known_name = kb_name(knowledge_base->monsters[kb_position].name);
+        if (known_name != NULL && strncmp(known_name, prefix, length) != 0)
+            known_name = NULL;
+        if (session_name == NULL && known_name == NULL)
+            break;
 
-            qsort(ingredients_in_formula, formulas[i].ingredient_count, sizeof(Ingredient), cmpForRecipe);
+        int order = session_name == NULL ? 1 : known_name == NULL ? -1 : strcmp(session_name, known_name);
+        respond_name(order <= 0 ? session_name : known_name);
+        if (order <= 0 && tables_read_only)
+            position++;
+        else if (order <= 0)
+            node = node->next_by_name[0];
+        if (order >= 0)
+            kb_position++;
+    }
+    respond_list_end();
+    mem_free(MEM_TEMPORARIES, prefix, length + 1);
+}
 
-            for (int j = 0; j < formulas[i].ingredient_count; j++)
-            {
-                printf("%d %s", ingredients_in_formula[j].quantity, ingredients_in_formula[j].name);
-                if (j < formulas[i].ingredient_count - 1)
-                {
-                    printf(", ");
-                }
-            }
-            free(ingredients_in_formula);
-            printf("\n");
-            return;
+static void respond_memory(Bool allocations_only)
+{
+    /**
+        * Function Name: respond_memory
+        *
+        * Purpose:
+        *    Answers a question about the memory of the session with the counters of each subsystem and their total.
+        *
+        * Parameters:
+        *     Bool allocations_only - TRUE to answer only the allocations, FALSE for the bytes as well.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Answers "<count> <subsystem> <counter>" entries. The parse cache is left out, it belongs to the
+        *       thread parsing the lines and not to the session.
+        *     - Allocates nothing, so asking twice around other commands shows whether they allocated.
+        */
+    size_t in_use[MEM_SUBSYSTEM_COUNT + 1];
+    mem_stats_in_use(in_use);
+    respond_list_begin(RESPONSE_ITEMS, FALSE);
+    for (int s = 0; s <= MEM_SUBSYSTEM_COUNT; s++)
+    {
+        if (s == MEM_PARSE_CACHE)
+            continue;
+        const MemCounter *counter = s < MEM_SUBSYSTEM_COUNT ? &mem_stats.subsystems[s] : &mem_stats.total;
+        const char *name = mem_subsystem_name(s);
+        size_t slack = counter->live > in_use[s] ? counter->live - in_use[s] : 0;
+        char entry[64];
+        if (!allocations_only)
+        {
+            snprintf(entry, sizeof(entry), "%s live", name);
+            respond_item((long)counter->live, entry);
+            snprintf(entry, sizeof(entry), "%s slack", name);
+            respond_item((long)slack, entry);
+        }
+        snprintf(entry, sizeof(entry), "%s allocations", name);
+        respond_item(counter->allocations, entry);
+        if (!allocations_only)
+        {
+            snprintf(entry, sizeof(entry), "%s peak", name);
+            respond_item((long)counter->peak, entry);
         }
     }
-    printf("No formula for %s\n", potion_name);
-}
\ No newline at end of file
+    respond_list_end();
+}
+
+void handle_memory_query()
+{
+    /**
+        * Function Name: handle_memory_query
+        *
+        * Purpose:
+        *    Handles the query for the memory of the session and prints what each subsystem holds.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints, for every subsystem but the parse cache and for their total, the bytes live, the slack
+        *       beyond the entries in use, the allocations and the peak live bytes.
+        *     - The bytes depend on the size of pointers, see handle_memory_allocations_query for counts that do not.
+        */
+    respond_memory(FALSE);
+}
+
+void handle_memory_allocations_query()
+{
+    /**
+        * Function Name: handle_memory_allocations_query
+        *
+        * Purpose:
+        *    Handles the query for the allocations of the session and prints how many each subsystem made.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Prints the allocations of every subsystem but the parse cache and their total, the same on every platform.
+        */
+    respond_memory(TRUE);
+}
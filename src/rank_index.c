@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+THREAD_LOCAL RankIndex rank_index[RANK_TABLE_COUNT];
+
+static Bool ranks_before(const RankNode *node, int quantity, const char *name)
+{
+    /**
+        * Function Name: ranks_before
+        *
+        * Purpose:
+        *    Tells if an item comes before a quantity and name in the quantity order.
+        *
+        * Parameters:
+        *     const RankNode *node - The item.
+        *     int quantity - The quantity compared to.
+        *     const char *name - The name compared to.
+        *
+        * Return:
+        *     Bool - TRUE if the item has a larger quantity, or the same quantity and a smaller name.
+        */
+    if (node->quantity != quantity)
+        return node->quantity > quantity;
+    return strcmp(node->name, name) < 0;
+}
+
+static RankNode *find_predecessors(RankIndex *index, int quantity, const char *name, RankNode **update)
+{
+    /**
+        * Function Name: find_predecessors
+        *
+        * Purpose:
+        *    Searches the quantity order for a quantity and name.
+        *
+        * Parameters:
+        *     RankIndex *index - The index, its head allocated.
+        *     int quantity - The quantity searched for.
+        *     const char *name - The name searched for.
+        *     RankNode **update - Receives, for every level in use, the last node before the position.
+        *
+        * Return:
+        *     RankNode * - The first node not before the position, NULL if there is none.
+        */
+    RankNode *node = index->head;
+    for (int level = index->level - 1; level >= 0; level--)
+    {
+        while (node->next[level] != NULL && ranks_before(node->next[level], quantity, name))
+            node = node->next[level];
+        update[level] = node;
+    }
+    return node->next[0];
+}
+
+static RankNode *find_name_predecessors(RankIndex *index, const char *name, RankNode **update)
+{
+    /**
+        * Function Name: find_name_predecessors
+        *
+        * Purpose:
+        *    Searches the name order for a name.
+        *
+        * Parameters:
+        *     RankIndex *index - The index, its head allocated.
+        *     const char *name - The name searched for.
+        *     RankNode **update - Receives, for every level in use, the last node before the position.
+        *
+        * Return:
+        *     RankNode * - The first node whose name is not smaller, NULL if there is none.
+        */
+    RankNode *node = index->head;
+    for (int level = index->name_level - 1; level >= 0; level--)
+    {
+        while (node->next_by_name[level] != NULL && strcmp(node->next_by_name[level]->name, name) < 0)
+            node = node->next_by_name[level];
+        update[level] = node;
+    }
+    return node->next_by_name[0];
+}
+
+static int random_level(RankIndex *index)
+{
+    /**
+        * Function Name: random_level
+        *
+        * Purpose:
+        *    Draws the number of levels of a new node, each level a quarter as likely as the one below.
+        *
+        * Parameters:
+        *     RankIndex *index - The index, whose xorshift seed advances.
+        *
+        * Return:
+        *     int - The number of levels, from 1 to RANK_MAX_LEVEL.
+        */
+    unsigned bits = index->seed;
+    bits ^= bits << 13;
+    bits ^= bits >> 17;
+    bits ^= bits << 5;
+    index->seed = bits;
+
+    int level = 1;
+    while (level < RANK_MAX_LEVEL && (bits & 3) == 0)
+    {
+        level++;
+        bits >>= 2;
+    }
+    return level;
+}
+
+static RankNode *new_node(int level)
+{
+    /**
+        * Function Name: new_node
+        *
+        * Purpose:
+        *    Allocates a node linked on nothing yet.
+        *
+        * Parameters:
+        *     int level - The number of levels of the node in each order.
+        *
+        * Return:
+        *     RankNode * - The node, with a quantity of 0 and no name.
+        */
+    RankNode *node = mem_calloc(MEM_RANK_INDEX, 1, sizeof(RankNode) + 2 * level * sizeof(RankNode *));
+    node->level = level;
+    node->next_by_name = node->next + level;
+    return node;
+}
+
+static RankNode *find_or_add_name(RankTable table, const char *name)
+{
+    /**
+        * Function Name: find_or_add_name
+        *
+        * Purpose:
+        *    Finds the node of a name, or links a new one in the name order.
+        *
+        * Parameters:
+        *     RankTable table - The table.
+        *     const char *name - The name.
+        *
+        * Return:
+        *     RankNode * - The node, a new one has a quantity of 0 and is not in the quantity order.
+        *
+        * Side Effects:
+        *     - Allocates the head of the index on first use.
+        */
+    RankIndex *index = &rank_index[table];
+    if (index->head == NULL)
+    {
+        index->head = new_node(RANK_MAX_LEVEL);
+        index->level = 1;
+        index->name_level = 1;
+        index->seed = 2463534242u;
+    }
+
+    RankNode *update[RANK_MAX_LEVEL];
+    RankNode *node = find_name_predecessors(index, name, update);
+    if (node != NULL && strcmp(node->name, name) == 0)
+        return node;
+
+    node = new_node(random_level(index));
+    node->name = name_pool_intern(name);
+    for (; index->name_level < node->level; index->name_level++)
+        update[index->name_level] = index->head;
+    for (int level = 0; level < node->level; level++)
+    {
+        node->next_by_name[level] = update[level]->next_by_name[level];
+        update[level]->next_by_name[level] = node;
+    }
+    return node;
+}
+
+void rank_index_changed(RankTable table, const char *name, int old_quantity, int new_quantity)
+{
+    /**
+        * Function Name: rank_index_changed
+        *
+        * Purpose:
+        *    Moves an item of an inventory to the place of its new quantity in the rank index.
+        *
+        * Parameters:
+        *     RankTable table - The inventory.
+        *     const char *name - The name of the item.
+        *     int old_quantity - Its quantity before the change, 0 if it is new.
+        *     int new_quantity - Its quantity after the change.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Unlinks and relinks the item in O(log n) expected time, an item with a quantity of 0 leaves
+        *       the quantity order and stays in the name order.
+        *     - Must be called by every change of the quantity of an ingredient, potion or trophy, after the change.
+        */
+    if (old_quantity == new_quantity)
+        return;
+    RankIndex *index = &rank_index[table];
+    RankNode *update[RANK_MAX_LEVEL];
+    RankNode *node;
+    if (old_quantity != 0)
+    {
+        node = find_predecessors(index, old_quantity, name, update);
+        for (int level = 0; level < node->level; level++)
+            update[level]->next[level] = node->next[level];
+        while (index->level > 1 && index->head->next[index->level - 1] == NULL)
+            index->level--;
+        index->count--;
+    }
+    else
+        node = find_or_add_name(table, name);
+
+    node->quantity = new_quantity;
+    if (new_quantity == 0)
+        return;
+    find_predecessors(index, new_quantity, name, update);
+    for (; index->level < node->level; index->level++)
+        update[index->level] = index->head;
+    for (int level = 0; level < node->level; level++)
+    {
+        node->next[level] = update[level]->next[level];
+        update[level]->next[level] = node;
+    }
+    index->count++;
+}
+
+void rank_index_add_name(RankTable table, const char *name)
+{
+    /**
+        * Function Name: rank_index_add_name
+        *
+        * Purpose:
+        *    Adds a name to the name order of a table without a quantity, such as a new monster.
+        *
+        * Parameters:
+        *     RankTable table - The table.
+        *     const char *name - The name, nothing changes if it is already there.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    find_or_add_name(table, name);
+}
+
+const RankNode *rank_index_first(RankTable table)
+{
+    /**
+        * Function Name: rank_index_first
+        *
+        * Purpose:
+        *    Returns the most plentiful item of an inventory, the others follow it on next[0].
+        *
+        * Parameters:
+        *     RankTable table - The inventory.
+        *
+        * Return:
+        *     const RankNode * - The item, NULL if nothing is in stock.
+        */
+    return rank_index[table].head == NULL ? NULL : rank_index[table].head->next[0];
+}
+
+const RankNode *rank_index_first_below(RankTable table, int quantity)
+{
+    /**
+        * Function Name: rank_index_first_below
+        *
+        * Purpose:
+        *    Returns the first item of an inventory with less than a quantity, the others follow it on next[0].
+        *
+        * Parameters:
+        *     RankTable table - The inventory.
+        *     int quantity - The threshold.
+        *
+        * Return:
+        *     const RankNode * - The item, NULL if every item in stock has at least the quantity.
+        *
+        * Side Effects:
+        *     - Takes O(log n) expected time.
+        */
+    const RankIndex *index = &rank_index[table];
+    if (index->head == NULL)
+        return NULL;
+    const RankNode *node = index->head;
+    for (int level = index->level - 1; level >= 0; level--)
+        while (node->next[level] != NULL && node->next[level]->quantity >= quantity)
+            node = node->next[level];
+    return node->next[0];
+}
+
+const RankNode *rank_index_first_from(RankTable table, const char *name)
+{
+    /**
+        * Function Name: rank_index_first_from
+        *
+        * Purpose:
+        *    Returns the first name of a table not smaller than a name, the others follow it on next_by_name[0].
+        *
+        * Parameters:
+        *     RankTable table - The table.
+        *     const char *name - The name, a prefix finds the first name starting with it.
+        *
+        * Return:
+        *     const RankNode * - The item, NULL if every name is smaller, with a quantity of 0 if it is out of stock.
+        *
+        * Side Effects:
+        *     - Takes O(log n) expected time.
+        */
+    RankIndex *index = &rank_index[table];
+    if (index->head == NULL)
+        return NULL;
+    RankNode *update[RANK_MAX_LEVEL];
+    return find_name_predecessors(index, name, update);
+}
+
+int rank_index_collect(RankTable table, Ingredient *ranked)
+{
+    /**
+        * Function Name: rank_index_collect
+        *
+        * Purpose:
+        *    Copies the names and quantities of an inventory in quantity order.
+        *
+        * Parameters:
+        *     RankTable table - The inventory.
+        *     Ingredient *ranked - Receives the items, room for rank_index[table].count of them.
+        *
+        * Return:
+        *     int - The number of items copied.
+        */
+    int count = 0;
+    for (const RankNode *node = rank_index_first(table); node != NULL; node = node->next[0])
+    {
+        ranked[count].name = node->name;
+        ranked[count].quantity = node->quantity;
+        count++;
+    }
+    return count;
+}
+
+void rank_index_free()
+{
+    /**
+        * Function Name: rank_index_free
+        *
+        * Purpose:
+        *    Releases the calling thread's rank indexes.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The next session on the thread starts with empty indexes.
+        */
+    for (int t = 0; t < RANK_TABLE_COUNT; t++)
+    {
+        //every node is in the name order, out of stock or not
+        RankNode *node = rank_index[t].head;
+        while (node != NULL)
+        {
+            RankNode *next = node->next_by_name[0];
+            mem_free(MEM_RANK_INDEX, node, sizeof(RankNode) + 2 * node->level * sizeof(RankNode *));
+            node = next;
+        }
+        memset(&rank_index[t], 0, sizeof(RankIndex));
+    }
+}
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "globals.h"
+
+typedef struct
+{
+    const char *input_dir;
+    const char *output_dir;
+    ReplayFile *files;
+    int file_count;
+    atomic_int next_file;
+    atomic_long total_lines;
+    atomic_int failed_files;
+} ReplayJob;
+
+static int cmp_replay_file(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmp_replay_file
+        *
+        * Purpose:
+        *    Compares two replay files so that the largest file comes first.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first file.
+        *     const void *b - Pointer to the second file.
+        *
+        * Return:
+        *     int - Negative if a is larger than b, positive if smaller, otherwise the name order.
+        *
+        * Side Effects:
+        *     - The function does not modify the input files.
+        *     - Starting the large sessions first keeps every thread busy until the end of the replay.
+     */
+    const ReplayFile *fa = a;
+    const ReplayFile *fb = b;
+    if (fa->size != fb->size)
+        return fa->size > fb->size ? -1 : 1;
+    return strcmp(fa->name, fb->name);
+}
+
+long replay_session(FILE *input)
+{
+    /**
+        * Function Name: replay_session
+        *
+        * Purpose:
+        *    Executes every line of a session log on the calling thread's session.
+        *
+        * Parameters:
+        *     FILE *input - The session log to be replayed.
+        *
+        * Return:
+        *     long - The number of lines executed.
+        *
+        * Side Effects:
+        *     - Modifies the calling thread's tables and prints the responses to its output stream.
+        *     - Prompts are not written, the output has one response per line like the expected outputs.
+        *     - Stops at EOF or at the first Exit line.
+     */
+    long line_count = 0;
+    while (read_command(input, &line_command, TRUE))
+    {
+        line_count++;
+        if (!execute_command(&line_command))
+            break;
+    }
+    return line_count;
+}
+
+static long replay_file(const char *input_path, const char *output_path)
+{
+    /**
+        * Function Name: replay_file
+        *
+        * Purpose:
+        *    Replays one session log on the calling thread and writes its responses to a file.
+        *
+        * Parameters:
+        *     const char *input_path - The session log to be replayed.
+        *     const char *output_path - The file that receives the responses.
+        *
+        * Return:
+        *     long - The number of lines replayed, or -1 if one of the files could not be opened.
+        *
+        * Side Effects:
+        *     - Starts and frees a fresh session on the calling thread, other sessions are not affected.
+     */
+    FILE *input = fopen(input_path, "r");
+    if (!input)
+        return -1;
+    FILE *output = fopen(output_path, "w");
+    if (!output)
+    {
+        fclose(input);
+        return -1;
+    }
+
+    init_state();
+    output_stream = output;
+    long line_count = replay_session(input);
+    output_stream = NULL;
+    free_state();
+
+    fclose(input);
+    fclose(output);
+    return line_count;
+}
+
+int list_session_logs(DIR *dir, const char *dir_path, ReplayFile **files)
+{
+    /**
+        * Function Name: list_session_logs
+        *
+        * Purpose:
+        *    Collects the input* session logs of a directory, largest first.
+        *
+        * Parameters:
+        *     DIR *dir - The opened directory.
+        *     const char *dir_path - The path of the directory.
+        *     ReplayFile **files - Receives the allocated array of files, freed by the caller.
+        *
+        * Return:
+        *     int - The number of session logs found.
+        *
+        * Side Effects:
+        *     - Only regular files whose names start with "input" are listed, the same rule as the grader.
+        *     - Allocates the returned array.
+     */
+    int file_count = 0;
+    int file_capacity = 16;
+    *files = malloc(file_capacity * sizeof(ReplayFile));
+
+    struct dirent *entry;
+    char path[4096];
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, "input", strlen("input")) != 0 || strlen(entry->d_name) >= sizeof((*files)[0].name))
+            continue;
+
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+        if (file_count >= file_capacity)
+        {
+            file_capacity *= 2;
+            *files = realloc(*files, file_capacity * sizeof(ReplayFile));
+        }
+        strcpy((*files)[file_count].name, entry->d_name);
+        (*files)[file_count].size = st.st_size;
+        file_count++;
+    }
+
+    qsort(*files, file_count, sizeof(ReplayFile), cmp_replay_file);
+    return file_count;
+}
+
+static void *replay_worker(void *arg)
+{
+    /**
+        * Function Name: replay_worker
+        *
+        * Purpose:
+        *    Thread body of the replay pool, takes files from the job until none are left.
+        *
+        * Parameters:
+        *     void *arg - The shared ReplayJob.
+        *
+        * Return:
+        *     void * - Always NULL.
+        *
+        * Side Effects:
+        *     - Replays every file it takes as an independent session.
+        *     - Adds the replayed line counts and failures to the job's counters.
+     */
+    ReplayJob *job = arg;
+    char input_path[4096];
+    char output_path[4096];
+
+    while (1)
+    {
+        int index = atomic_fetch_add(&job->next_file, 1);
+        if (index >= job->file_count)
+            break;
+
+        //the output of inputN.txt is named outputN.txt, the same pairing as the test-cases folder
+        const char *name = job->files[index].name;
+        snprintf(input_path, sizeof(input_path), "%s/%s", job->input_dir, name);
+        snprintf(output_path, sizeof(output_path), "%s/output%s", job->output_dir, name + strlen("input"));
+
+        long line_count = replay_file(input_path, output_path);
+        if (line_count < 0)
+        {
+            fprintf(stderr, "Could not replay %s\n", input_path);
+            atomic_fetch_add(&job->failed_files, 1);
+            continue;
+        }
+        atomic_fetch_add(&job->total_lines, line_count);
+    }
+    return NULL;
+}
+
+int replay_directory(const char *input_dir, const char *output_dir, int thread_count)
+{
+    /**
+        * Function Name: replay_directory
+        *
+        * Purpose:
+        *    Replays every input file of a directory as an independent session on a pool of threads.
+        *
+        * Parameters:
+        *     const char *input_dir - The directory holding the input*.txt session logs.
+        *     const char *output_dir - The directory that receives an output*.txt file per session.
+        *     int thread_count - The number of worker threads, one per online core if not positive.
+        *
+        * Return:
+        *     int - 0 on success, 1 if a directory or a file could not be processed.
+        *
+        * Side Effects:
+        *     - Creates output_dir if it does not exist.
+        *     - Prints the number of sessions, lines and the aggregate lines/sec to stderr.
+     */
+    DIR *dir = opendir(input_dir);
+    if (!dir)
+    {
+        fprintf(stderr, "Could not open %s\n", input_dir);
+        return 1;
+    }
+    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Could not create %s\n", output_dir);
+        closedir(dir);
+        return 1;
+    }
+
+    ReplayJob job;
+    job.input_dir = input_dir;
+    job.output_dir = output_dir;
+    job.file_count = list_session_logs(dir, input_dir, &job.files);
+    atomic_init(&job.next_file, 0);
+    atomic_init(&job.total_lines, 0);
+    atomic_init(&job.failed_files, 0);
+    closedir(dir);
+
+    if (thread_count <= 0)
+        thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count > job.file_count)
+        thread_count = job.file_count;
+    if (thread_count < 1)
+        thread_count = 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+    for (int i = 0; i < thread_count; i++)
+        pthread_create(&threads[i], NULL, replay_worker, &job);
+    for (int i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    long total_lines = atomic_load(&job.total_lines);
+
+    fprintf(stderr, "Replayed %d sessions, %ld lines on %d threads in %.3f s (%.0f lines/sec)\n",
+            job.file_count - atomic_load(&job.failed_files), total_lines, thread_count, seconds,
+            seconds > 0 ? total_lines / seconds : 0.0);
+
+    free(threads);
+    free(job.files);
+    return atomic_load(&job.failed_files) == 0 ? 0 : 1;
+}
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+// the text of the answers made of a fixed part, the ones ending with a space are followed by a name
+static const char *const response_texts[] = {
+    [RESPONSE_INVALID] = "INVALID",
+    [RESPONSE_INGREDIENTS_OBTAINED] = "Alchemy ingredients obtained",
+    [RESPONSE_NOT_ENOUGH_TROPHIES] = "Not enough trophies",
+    [RESPONSE_TRADE_SUCCESSFUL] = "Trade successful",
+    [RESPONSE_NO_FORMULA] = "No formula for ",
+    [RESPONSE_NOT_ENOUGH_INGREDIENTS] = "Not enough ingredients",
+    [RESPONSE_POTION_BREWED] = "Alchemy item created: ",
+    [RESPONSE_FORMULA_KNOWN] = "Already known formula",
+    [RESPONSE_FORMULA_LEARNED] = "New alchemy formula obtained: ",
+    [RESPONSE_EFFECTIVENESS_KNOWN] = "Already known effectiveness",
+    [RESPONSE_BESTIARY_UPDATED] = "Bestiary entry updated: ",
+    [RESPONSE_BESTIARY_ADDED] = "New bestiary entry added: ",
+    [RESPONSE_UNPREPARED] = "Geralt is unprepared and barely escapes with his life",
+    [RESPONSE_MONSTER_DEFEATED] = "Geralt defeats ",
+    [RESPONSE_NO_KNOWLEDGE] = "No knowledge of ",
+    [RESPONSE_NONE] = "None",
+};
+
+// the list being answered on this thread, its binary frame is started by its first entry
+typedef struct
+{
+    BinaryResponse code;
+    Bool none_if_empty;
+    int entries;
+    int frame_position;
+} ResponseList;
+
+THREAD_LOCAL OutputBuffer *response_frames;
+static THREAD_LOCAL ResponseList response_list;
+
+static int begin_frame(BinaryResponse code)
+{
+    /**
+        * Function Name: begin_frame
+        *
+        * Purpose:
+        *    Starts a response frame in the session's response_frames.
+        *
+        * Parameters:
+        *     BinaryResponse code - The code of the response.
+        *
+        * Return:
+        *     int - The position of the frame, for end_frame.
+        */
+    int frame_position = response_frames->length;
+    append_u32(response_frames, 0);
+    append_u8(response_frames, code);
+    return frame_position;
+}
+
+static void end_frame(int frame_position)
+{
+    /**
+        * Function Name: end_frame
+        *
+        * Purpose:
+        *    Writes the payload length of a finished response frame in front of it.
+        *
+        * Parameters:
+        *     int frame_position - The position returned by begin_frame.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    uint32_t frame_length = response_frames->length - frame_position - 4;
+    for (int i = 0; i < 4; i++)
+        response_frames->data[frame_position + i] = (frame_length >> (8 * i)) & 0xff;
+}
+
+void respond_one_of(BinaryResponse code, const char *name, Bool last)
+{
+    /**
+        * Function Name: respond_one_of
+        *
+        * Purpose:
+        *    Answers a command with one of the fixed answers, as one of the answers of a brew list.
+        *
+        * Parameters:
+        *     BinaryResponse code - The answer, one with a fixed text.
+        *     const char *name - The name following the text, NULL for the answers without one.
+        *     Bool last - TRUE if it is the last answer of the command.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Binary sessions get a frame per answer. Text answers share one line, separated by ", ".
+        */
+    if (response_frames != NULL)
+    {
+        int frame_position = begin_frame(code);
+        if (name != NULL)
+            append_name_field(response_frames, name, strlen(name));
+        end_frame(frame_position);
+        return;
+    }
+    print_output("%s%s%s", response_texts[code], name != NULL ? name : "", last ? "\n" : ", ");
+}
+
+void respond(BinaryResponse code, const char *name)
+{
+    /**
+        * Function Name: respond
+        *
+        * Purpose:
+        *    Answers a command with one of the fixed answers.
+        *
+        * Parameters:
+        *     BinaryResponse code - The answer, one with a fixed text.
+        *     const char *name - The name following the text, NULL for the answers without one.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    respond_one_of(code, name, TRUE);
+}
+
+void respond_quantity(int quantity)
+{
+    /**
+        * Function Name: respond_quantity
+        *
+        * Purpose:
+        *    Answers a question with a quantity.
+        *
+        * Parameters:
+        *     int quantity - The quantity.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (response_frames != NULL)
+    {
+        int frame_position = begin_frame(RESPONSE_QUANTITY);
+        append_u32(response_frames, (uint32_t)quantity);
+        end_frame(frame_position);
+        return;
+    }
+    print_output("%d\n", quantity);
+}
+
+void respond_brewed(int count, const char *name)
+{
+    /**
+        * Function Name: respond_brewed
+        *
+        * Purpose:
+        *    Answers a batch brew with the number of potions created.
+        *
+        * Parameters:
+        *     int count - The number of potions, at least 1.
+        *     const char *name - The potion.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (count == 1)
+    {
+        respond(RESPONSE_POTION_BREWED, name);
+        return;
+    }
+    if (response_frames != NULL)
+    {
+        int frame_position = begin_frame(RESPONSE_POTIONS_BREWED);
+        append_u32(response_frames, (uint32_t)count);
+        append_name_field(response_frames, name, strlen(name));
+        end_frame(frame_position);
+        return;
+    }
+    print_output("Alchemy items created: %d %s\n", count, name);
+}
+
+void respond_encounters(int won, int escaped, const char *name)
+{
+    /**
+        * Function Name: respond_encounters
+        *
+        * Purpose:
+        *    Answers a number of encounters with the fights won and the escapes.
+        *
+        * Parameters:
+        *     int won - The fights won.
+        *     int escaped - The times Geralt escaped.
+        *     const char *name - The monster.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The monster is only named when a fight was won, in both forms.
+        */
+    if (response_frames != NULL)
+    {
+        int frame_position = begin_frame(RESPONSE_ENCOUNTERS);
+        append_u32(response_frames, (uint32_t)won);
+        append_u32(response_frames, (uint32_t)escaped);
+        append_name_field(response_frames, name, won > 0 ? strlen(name) : 0);
+        end_frame(frame_position);
+        return;
+    }
+    if (won == 0)
+        print_output("Geralt is unprepared and barely escapes with his life %d time%s\n", escaped, escaped == 1 ? "" : "s");
+    else if (escaped == 0)
+        print_output("Geralt defeats %d %s\n", won, name);
+    else
+        print_output("Geralt defeats %d %s and barely escapes with his life %d time%s\n", won, name, escaped, escaped == 1 ? "" : "s");
+}
+
+void respond_list_begin(BinaryResponse code, Bool none_if_empty)
+{
+    /**
+        * Function Name: respond_list_begin
+        *
+        * Purpose:
+        *    Starts answering a question with a list, its entries follow with respond_item or respond_name.
+        *
+        * Parameters:
+        *     BinaryResponse code - RESPONSE_ITEMS for quantities and names, RESPONSE_NAMES for bare names.
+        *     Bool none_if_empty - TRUE to answer "None" if the list ends without entries.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    response_list.code = code;
+    response_list.none_if_empty = none_if_empty;
+    response_list.entries = 0;
+}
+
+static void begin_entry()
+{
+    /**
+        * Function Name: begin_entry
+        *
+        * Purpose:
+        *    Starts the next entry of the list being answered.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The first entry starts the binary frame and its 32-bit count, the others follow a ", " in text.
+        */
+    if (response_frames != NULL && response_list.entries == 0)
+    {
+        response_list.frame_position = begin_frame(response_list.code);
+        append_u32(response_frames, 0);
+    }
+    else if (response_frames == NULL && response_list.entries > 0)
+        print_output(", ");
+    response_list.entries++;
+}
+
+void respond_item(long quantity, const char *name)
+{
+    /**
+        * Function Name: respond_item
+        *
+        * Purpose:
+        *    Adds a quantity and a name to the list being answered.
+        *
+        * Parameters:
+        *     long quantity - The quantity, a 32-bit field in binary frames.
+        *     const char *name - The name.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    begin_entry();
+    if (response_frames != NULL)
+    {
+        append_u32(response_frames, (uint32_t)quantity);
+        append_name_field(response_frames, name, strlen(name));
+        return;
+    }
+    print_output("%ld %s", quantity, name);
+}
+
+void respond_name(const char *name)
+{
+    /**
+        * Function Name: respond_name
+        *
+        * Purpose:
+        *    Adds a name to the list being answered.
+        *
+        * Parameters:
+        *     const char *name - The name.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    begin_entry();
+    if (response_frames != NULL)
+    {
+        append_name_field(response_frames, name, strlen(name));
+        return;
+    }
+    print_output("%s", name);
+}
+
+void respond_text_only(const char *text)
+{
+    /**
+        * Function Name: respond_text_only
+        *
+        * Purpose:
+        *    Adds characters to the text answer that binary responses have no field for.
+        *
+        * Parameters:
+        *     const char *text - The characters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (response_frames == NULL)
+        print_output("%s", text);
+}
+
+void respond_list_end()
+{
+    /**
+        * Function Name: respond_list_end
+        *
+        * Purpose:
+        *    Ends the list being answered.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - A list without entries is answered "None" if it was begun so, otherwise as an empty list.
+        */
+    if (response_list.entries == 0 && response_list.none_if_empty)
+    {
+        respond(RESPONSE_NONE, NULL);
+        return;
+    }
+    if (response_frames == NULL)
+    {
+        print_output("\n");
+        return;
+    }
+    if (response_list.entries == 0)
+    {
+        response_list.frame_position = begin_frame(response_list.code);
+        append_u32(response_frames, 0);
+    }
+    for (int i = 0; i < 4; i++)
+        response_frames->data[response_list.frame_position + 5 + i] = (response_list.entries >> (8 * i)) & 0xff;
+    end_frame(response_list.frame_position);
+}
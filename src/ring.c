@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "globals.h"
+
+void ring_init(SpscRing *ring, size_t slot_size, size_t capacity)
+{
+    /**
+        * Function Name: ring_init
+        *
+        * Purpose:
+        *    Creates an empty bounded single-producer/single-consumer ring.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring to be created.
+        *     size_t slot_size - The size of one slot in bytes.
+        *     size_t capacity - The number of slots, must be a power of two.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Allocates the zero filled slots, so slot structs start with empty buffers.
+        */
+    ring->slots = calloc(capacity, slot_size);
+    ring->slot_size = slot_size;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+void ring_free(SpscRing *ring)
+{
+    /**
+        * Function Name: ring_free
+        *
+        * Purpose:
+        *    Releases the slots of a ring, buffers owned by the slots must be released before.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring to be released.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+void *ring_slot(SpscRing *ring, size_t index)
+{
+    /**
+        * Function Name: ring_slot
+        *
+        * Purpose:
+        *    Returns a slot by its position in the ring, to set up or release what the slots own.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring.
+        *     size_t index - The position of the slot, from 0 to capacity - 1.
+        *
+        * Return:
+        *     void * - The slot.
+        */
+    return ring->slots + index * ring->slot_size;
+}
+
+void ring_wait(int *spins)
+{
+    /**
+        * Function Name: ring_wait
+        *
+        * Purpose:
+        *    Backs off while the other side of a ring, or another stage, catches up.
+        *
+        * Parameters:
+        *     int *spins - The number of times the caller has waited so far.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Busy waits for a short while, then yields the core so a sleeping peer on the same core can run.
+        */
+    if (++(*spins) < 64)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+        return;
+    }
+    sched_yield();
+}
+
+void *ring_slot_for_write(SpscRing *ring, atomic_int *stop)
+{
+    /**
+        * Function Name: ring_slot_for_write
+        *
+        * Purpose:
+        *    Waits for a free slot, for the producer side only.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring.
+        *     atomic_int *stop - Gives up waiting once it becomes non-zero, may be NULL.
+        *
+        * Return:
+        *     void * - The slot to be filled and then passed on with ring_publish, NULL if stopped.
+        */
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int spins = 0;
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask)
+    {
+        if (stop != NULL && atomic_load_explicit(stop, memory_order_relaxed))
+            return NULL;
+        ring_wait(&spins);
+    }
+    return ring_slot(ring, head & ring->mask);
+}
+
+void ring_publish(SpscRing *ring)
+{
+    /**
+        * Function Name: ring_publish
+        *
+        * Purpose:
+        *    Hands the slot returned by ring_slot_for_write to the consumer.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The release store makes everything written to the slot visible to the consumer.
+        */
+    atomic_store_explicit(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+void *ring_slot_for_read(SpscRing *ring, atomic_int *stop)
+{
+    /**
+        * Function Name: ring_slot_for_read
+        *
+        * Purpose:
+        *    Waits for a published slot, for the consumer side only.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring.
+        *     atomic_int *stop - Gives up waiting once it becomes non-zero, may be NULL.
+        *
+        * Return:
+        *     void * - The oldest published slot, to be handed back with ring_release, NULL if stopped.
+        */
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    int spins = 0;
+    while (atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+    {
+        if (stop != NULL && atomic_load_explicit(stop, memory_order_relaxed))
+            return NULL;
+        ring_wait(&spins);
+    }
+    return ring_slot(ring, tail & ring->mask);
+}
+
+void ring_release(SpscRing *ring)
+{
+    /**
+        * Function Name: ring_release
+        *
+        * Purpose:
+        *    Gives the slot returned by ring_slot_for_read back to the producer.
+        *
+        * Parameters:
+        *     SpscRing *ring - The ring.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - The slot's buffers stay with the slot and are reused by the producer.
+        */
+    atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->tail, memory_order_relaxed) + 1, memory_order_release);
+}
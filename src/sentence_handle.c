@@ -1,352 +1,251 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "globals.h"
 
-Bool is_valid_ingredient_sentence(char words[][MAX_WORD_LEN], int word_count)
+// a distinct name of a LOOT or TRADE list, the items repeating it are coalesced into its first one
+typedef struct
+{
+    int item;           // the first item of the command with the name
+    long long quantity; // the quantity of all the items with the name
+    int slot;           // the position of the name in the inventory, -1 if it is not there
+} PlannedItem;
+
+// kept from one line to the next, so planning a list allocates nothing once they are large enough
+static THREAD_LOCAL PlannedItem *planned_items;
+static THREAD_LOCAL int planned_item_capacity;
+static THREAD_LOCAL int *plan_buckets;
+static THREAD_LOCAL int plan_bucket_capacity;
+// the ingredients planned by plan_received_ingredients, the first entries of planned_items
+static THREAD_LOCAL int received_entry_count;
+
+static int plan_bucket(const Command *command, const char *name, int bucket_count)
 {
     /**
-        * Function Name: is_valid_ingredient_sentence
+        * Function Name: plan_bucket
         *
         * Purpose:
-        *    Validates the format of an ingredient sentence.
+        *    Finds the bucket of a name in the hash table of the list being planned.
         *
-        * Return:
-        *     Bool - Returns TRUE if the format is valid, FALSE otherwise.
+        * Parameters:
+        *     const Command *command - The LOOT or TRADE, whose items name the entries.
+        *     const char *name - The name.
+        *     int bucket_count - The number of buckets in use, a power of two.
         *
-        * Side Effects:
-        *     - Checks the format of the sentence to ensure it follows the expected structure of 
-        *       <ingredient_list> ::= <quantity> <ingredient> | <quantity> <ingredient> "," <ingredient_list>
-        *     - The function assumes that the first two words are "Geralt" and "loots".
-        *     - The function checks if the quantities are positive integers and if the ingredient names are alphabetic
-        *       using the fact that all ingredients have one word names in a cyclic manner.
-        *     - The function checks if the quantities have trailing zeros.
-        *     - The function also checks if the last word is not a comma.
-        *     - The function does not modify any global variables or data structures.
+        * Return:
+        *     int - The bucket holding the entry of the name, or the empty bucket where it belongs.
         */
-    int curr_index = 2;
-
-    while (curr_index < word_count)
-    {
-        //we know that following three indices should follow the form of [quantity, ingredient, "",""]
-        //so by increasing curr_index by 2 we can check if the next word is a comma, 
-        // and by increasing 1 again we will go to the next 3-word block
-        if (!is_digit_custom(words[curr_index]))
-            return FALSE;
-        if (!is_alphabetic_custom(words[curr_index + 1]))
-            return FALSE;
-        int quantity = atoi(words[curr_index]);
-        char ingredient_name[MAX_WORD_LEN];
-        strcpy(ingredient_name, words[curr_index + 1]);
-        if (quantity <= 0)
-            return FALSE;
-
-        curr_index += 2;
-
-        if (curr_index >= word_count)
-            break;
-
-        if (strcmp(words[curr_index], ",") != 0)
-            return FALSE;
-
-        curr_index++;
-    }
-
-    if (strcmp(words[word_count - 1], ",") == 0)
-        return FALSE;
-
-    return TRUE;
+    int bucket = hash_name(name) & (bucket_count - 1);
+    while (plan_buckets[bucket] >= 0 &&
+           strcmp(command_text(command, command->items[planned_items[plan_buckets[bucket]].item].name), name) != 0)
+        bucket = (bucket + 1) & (bucket_count - 1);
+    return bucket;
 }
 
-void add_ingredient(Ingredient *ingredients, char *name, int quantity)
+static int plan_items(const Command *command, int from, int to, RankTable inventory, int first_entry)
 {
     /**
-        * Function Name: add_ingredient
+        * Function Name: plan_items
         *
         * Purpose:
-        *    Adds an ingredient to the ingredients array or updates its quantity if it already exists.
+        *    Coalesces items of a LOOT or TRADE by name and finds each name in an inventory.
         *
         * Parameters:
-        *     Ingredient *ingredients - The array of ingredients.
-        *     char *name - The name of the ingredient to be added or updated.
-        *     int quantity - The quantity of the ingredient to be added or updated.
+        *     const Command *command - The LOOT or TRADE.
+        *     int from - The first item to plan.
+        *     int to - The item after the last one to plan.
+        *     RankTable inventory - The inventory the names are looked up in, of trophies or ingredients.
+        *     int first_entry - Where the entries start in planned_items, the ones before it are left as they are.
         *
         * Return:
-        *     void - This function does not return a value.
+        *     int - The number of distinct names, their entries follow first_entry in planned_items, in the order
+        *           they first appear in the command.
         *
         * Side Effects:
-        *     - Modifies the ingredients array by adding a new ingredient or updating the quantity of an existing one.
-        *     - The function does allocate the ingredients array if it is full.
-        *     - The function does not print any output.
+        *     - Grows the entries and the buckets by doubling when the list has more names than ever before.
+        *     - Every distinct name is looked up once in the inventory index.
         */
-    for (int i = 0; i <= last_added_ingredient_index; i++)
+    int item_count = to - from;
+    int bucket_count = 4;
+    while (bucket_count < 2 * item_count)
+        bucket_count *= 2;
+    if (first_entry + item_count > planned_item_capacity)
+    {
+        int old_capacity = planned_item_capacity;
+        while (first_entry + item_count > planned_item_capacity)
+            planned_item_capacity = planned_item_capacity == 0 ? 8 : planned_item_capacity * 2;
+        planned_items = mem_realloc(MEM_TEMPORARIES, planned_items, old_capacity * sizeof(PlannedItem),
+                                    planned_item_capacity * sizeof(PlannedItem));
+    }
+    if (bucket_count > plan_bucket_capacity)
+    {
+        plan_buckets = mem_realloc(MEM_TEMPORARIES, plan_buckets, plan_bucket_capacity * sizeof(int), bucket_count * sizeof(int));
+        plan_bucket_capacity = bucket_count;
+    }
+    memset(plan_buckets, -1, bucket_count * sizeof(int));
+
+    int entry_count = first_entry;
+    for (int i = from; i < to; i++)
     {
-        if (strcmp(ingredients[i].name, name) == 0)
+        int bucket = plan_bucket(command, command_text(command, command->items[i].name), bucket_count);
+        if (plan_buckets[bucket] < 0)
         {
-            // If the ingredient already exists, update its quantity and return
-            ingredients[i].quantity += quantity;
-            return;
+            plan_buckets[bucket] = entry_count;
+            planned_items[entry_count].item = i;
+            planned_items[entry_count].quantity = 0;
+            planned_items[entry_count].slot = inventory_index_find(inventory, command_text(command, command->items[i].name));
+            entry_count++;
         }
+        planned_items[plan_buckets[bucket]].quantity += command->items[i].quantity;
     }
-    // If the ingredient does not exist, add it to the array
-    // Ensure there is enough capacity in the ingredients array
-    ensure_ingredient_capacity();
-    last_added_ingredient_index++;
-    strcpy(ingredients[last_added_ingredient_index].name, name);
-    ingredients[last_added_ingredient_index].quantity = quantity;
+    return entry_count - first_entry;
 }
 
-Bool is_valid_trade_sentence(char words[][MAX_WORD_LEN], int word_count)
+int plan_received_ingredients(const Command *command)
 {
     /**
-        * Function Name: is_valid_trade_sentence
+        * Function Name: plan_received_ingredients
         *
         * Purpose:
-        *    Validates the format of a trade sentence.
+        *    Coalesces the ingredients a LOOT or TRADE receives by name, before the inventory is made room for.
+        *
+        * Parameters:
+        *     const Command *command - The LOOT or TRADE, the ingredients are its items after the trophies.
         *
         * Return:
-        *     Bool - Returns TRUE if the format is valid, FALSE otherwise.
+        *     int - The number of distinct ingredients that are not in the inventory yet.
         *
         * Side Effects:
-        *     - Checks the format of the sentence to ensure it follows the expected structure of 
-        *       <trophy_list> "for" <ingredient_list>
-        *     - The function assumes that the first two words are "Geralt" and "trades".
-        *     - The function checks if the quantities are positive integers and if the trophy names are alphabetic
-        *       using the fact that all trophies have one word names in a cyclic manner.
-        *     - The function checks if the quantities have trailing zeros.
-        *     - The function also checks if the last word is not a comma.
-        *     - The function does not modify any global variables or data structures.
+        *     - The plan is kept for the loot or trade of the same command that follows.
         */
-    int curr_index = 2;
-    int trophy_count = 0;
-    while (curr_index < word_count && strcmp(words[curr_index], "for") != 0)
-    {
-        if (!is_digit_custom(words[curr_index]))
-            return FALSE;
-        if (!is_alphabetic_custom(words[curr_index + 1]))
-            return FALSE;
-        int quantity = atoi(words[curr_index]);
-        if (quantity <= 0 || curr_index + 2 >= word_count)
-            return FALSE;
-
-        if (strcmp(words[curr_index + 2], "trophy") != 0)
-            return FALSE;
-
-        curr_index += 3;
-        trophy_count++;
-
-        if (curr_index < word_count && strcmp(words[curr_index], "for") == 0)
-            break;
-
-        if (curr_index >= word_count || strcmp(words[curr_index], ",") != 0)
-            return FALSE;
-
-        curr_index++;
-    }
-
-    if (curr_index >= word_count || strcmp(words[curr_index], "for") != 0)
-        return FALSE;
-
-    if (trophy_count == 1 && strcmp(words[curr_index - 1], ",") == 0)
-        return FALSE;
-
-    curr_index++;
-
-    while (curr_index < word_count)
-    {
-        if (curr_index + 1 >= word_count)
-            return FALSE;
-        if (!is_digit_custom(words[curr_index]))
-            return FALSE;
-        if (!is_alphabetic_custom(words[curr_index + 1]))
-            return FALSE;
-
-        int quantity = atoi(words[curr_index]);
-        if (quantity <= 0)
-            return FALSE;
-
-        curr_index += 2;
-
-        if (curr_index >= word_count)
-            break;
-
-        if (strcmp(words[curr_index], ",") != 0)
-            return FALSE;
-
-        curr_index++;
-    }
-
-    return TRUE;
+    received_entry_count = plan_items(command, command->trophy_count, command->item_count, RANK_INGREDIENTS, 0);
+    int new_count = 0;
+    for (int i = 0; i < received_entry_count; i++)
+        if (planned_items[i].slot < 0)
+            new_count++;
+    return new_count;
 }
 
-Bool check_valid_trade(Trophy *trophies, Trophy *trophies_to_trade, int trade_index)
+static void receive_ingredients(Ingredient *ingredients, const Command *command)
 {
     /**
-        * Function Name: check_valid_trade
+        * Function Name: receive_ingredients
         *
         * Purpose:
-        *    Checks if the trade is valid by comparing the quantities of trophies to be traded with the available trophies.
+        *    Adds the ingredients planned by plan_received_ingredients to the inventory in one batch.
         *
         * Parameters:
-        *     Trophy *trophies - The array of available trophies.
-        *     Trophy *trophies_to_trade - The array of trophies to be traded.
-        *     int trade_index - The number of trophies to be traded.
+        *     Ingredient *ingredients - The array of ingredients, with room for every new ingredient of the plan.
+        *     const Command *command - The LOOT or TRADE that was planned.
         *
         * Return:
-        *     Bool - Returns TRUE if the trade is valid, FALSE otherwise.
+        *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - Checks if the quantities of trophies to be traded are less than or equal to the available trophies.
-        *     - The function does not modify any global variables or data structures.
+        *     - New ingredients are appended in the order they first appear in the list.
+        *     - The brew and rank indexes are told the new quantity of every distinct ingredient once.
         */
-    for (int i = 0; i < trade_index; i++)
+    for (int i = 0; i < received_entry_count; i++)
     {
-        int found = FALSE;
-        for (int j = 0; j <= last_added_trophy_index; j++)
+        int quantity = (int)planned_items[i].quantity;
+        int slot = planned_items[i].slot;
+        if (slot < 0)
         {
-            if (strcmp(trophies_to_trade[i].name, trophies[j].name) == 0)
-            {
-                // We can break the loop here since we found the matching trophy
-                // and we can check the quantity
-                // If the quantity to trade is less than or equal to the available quantity
-                // we can proceed with the trade
-                // If not, the trade is invalid
-                if (trophies_to_trade[i].quantity <= trophies[j].quantity)
-                {
-                    found = TRUE;
-                    break;
-                }
-                else
-                {
-                    return FALSE;
-                }
-            }
-        }
-        // If we didn't find the trophy in the available trophies, the trade is invalid
-        // so we return FALSE
-        if (!found)
-        {
-            return FALSE;
+            slot = ++last_added_ingredient_index;
+            ingredients[slot].name = name_pool_intern(command_text(command, command->items[planned_items[i].item].name));
+            ingredients[slot].quantity = 0;
         }
+        ingredients[slot].quantity += quantity;
+        brew_index_ingredient_changed(ingredients[slot].name, ingredients[slot].quantity);
+        rank_index_changed(RANK_INGREDIENTS, ingredients[slot].name, ingredients[slot].quantity - quantity, ingredients[slot].quantity);
     }
-    return TRUE;
 }
 
-void trade(Ingredient *ingredients, Trophy *trophies, Trophy *trophies_to_trade, int num_trophies_to_trade, char words[][MAX_WORD_LEN], int curr_index, int word_count)
+Bool trade(Ingredient *ingredients, Trophy *trophies, const Command *command)
 {
     /**
         * Function Name: trade
         *
         * Purpose:
-        *    Performs the trade operation by updating the quantities of ingredients and trophies.
+        *    Performs the trade operation if Geralt has every trophy it gives, all of it or nothing.
         *
         * Parameters:
-        *     Ingredient *ingredients - The array of ingredients.
+        *     Ingredient *ingredients - The array of ingredients, with room for every new ingredient of the plan.
         *     Trophy *trophies - The array of trophies.
-        *     Trophy *trophies_to_trade - The array of trophies to be traded.
-        *     int num_trophies_to_trade - The number of trophies to be traded.
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int curr_index - The current index in the words array.
-        *     int word_count - The total number of words in the input line.
+        *     const Command *command - The parsed TRADE, trophies given first and the ingredients received after them,
+        *                              planned by plan_received_ingredients.
         *
         * Return:
-        *     void - This function does not return a value.
+        *     Bool - TRUE if the trade was made, FALSE if there are not enough trophies and nothing changed.
         *
         * Side Effects:
+        *     - A name given several times is checked and taken once for its total quantity,
+        *       an ingredient received several times is added once.
         *     - Modifies the ingredients and trophies arrays by updating their quantities based on the trade operation.
         */
-    while (curr_index < word_count)
+    //the trophies are planned after the ingredients, whose plan is kept for receive_ingredients
+    int first = received_entry_count;
+    int end = first + plan_items(command, 0, command->trophy_count, RANK_TROPHIES, first);
+    for (int i = first; i < end; i++)
     {
-        if (curr_index + 1 >= word_count)
-            return;
-
-        int quantity = atoi(words[curr_index]);
-        char ingredient_name[MAX_WORD_LEN];
-        strcpy(ingredient_name, words[curr_index + 1]);
-
-        int found = 0;
-        for (int i = 0; i <= last_added_ingredient_index; i++)
-        {
-            if (strcmp(ingredients[i].name, ingredient_name) == 0)
-            {
-                // If the ingredient already exists, update its quantity and return
-                ingredients[i].quantity += quantity;
-                found = 1;
-                break;
-            }
-        }
-        // If the ingredient does not exist, add it to the array
-        // Ensure there is enough capacity in the ingredients array
-        if (!found)
-        {
-            ensure_ingredient_capacity();
-            last_added_ingredient_index++;
-            strcpy(ingredients[last_added_ingredient_index].name, ingredient_name);
-            ingredients[last_added_ingredient_index].quantity = quantity;
-        }
-
-        curr_index += 2;
-
-        if (curr_index >= word_count)
-            break;
-
-        if (strcmp(words[curr_index], ",") == 0)
-            curr_index++;
+        if (planned_items[i].slot < 0 || planned_items[i].quantity > trophies[planned_items[i].slot].quantity)
+            return FALSE;
     }
-
-    for (int i = 0; i < num_trophies_to_trade; i++)
+    for (int i = first; i < end; i++)
     {
-        for (int j = 0; j <= last_added_trophy_index; j++)
-        {
-            //Decrease the quantity of the trophy in the trophies array
-            //we don't check if the trophy exists in the trophies array
-            //because we already checked it in the check_valid_trade function
-            if (strcmp(trophies[j].name, trophies_to_trade[i].name) == 0)
-            {
-                trophies[j].quantity -= trophies_to_trade[i].quantity;
-            }
-        }
+        Trophy *trophy = &trophies[planned_items[i].slot];
+        int quantity = trophy->quantity - (int)planned_items[i].quantity;
+        rank_index_changed(RANK_TROPHIES, trophy->name, trophy->quantity, quantity);
+        trophy->quantity = quantity;
     }
+
+    receive_ingredients(ingredients, command);
+    return TRUE;
 }
 
-Bool is_valid_brew_sentence(char words[][MAX_WORD_LEN], int word_count, const char *line)
+void loot(Ingredient *ingredients, const Command *command)
 {
     /**
-        * Function Name: is_valid_brew_sentence
+        * Function Name: loot
         *
         * Purpose:
-        *    Validates the format of a brew sentence.
+        *    Adds the ingredients of a LOOT to the inventory.
+        *
+        * Parameters:
+        *     Ingredient *ingredients - The array of ingredients, with room for every new ingredient of the plan.
+        *     const Command *command - The parsed LOOT, planned by plan_received_ingredients.
         *
         * Return:
-        *     Bool - Returns TRUE if the format is valid, FALSE otherwise.
+        *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - The function assumes that the first two words are "Geralt" and "brews".
-        *     - The function checks if the potion name is valid
-        *     - The function checks if the potion name is alphabetic and if the ingredient names are alphabetic
-        *       using the fact that all ingredients have one word names in a cyclic manner.
-        *     - The function checks if the potion name has trailing spaces.
-        *     - The function does not modify any global variables or data structures.
+        *     - An ingredient listed several times is added once, for its total quantity.
+        *     - Modifies the ingredients array and tells the brew and rank indexes once per distinct ingredient.
         */
-    if (word_count < 3)
-        return FALSE;
-
-    for (int i = 2; i < word_count; i++)
-    {
-        if (!is_alphabetic_custom(words[i]))
-            return FALSE;
-    }
-    char potion_name[MAX_LINE_LENGTH] = "";
-    for (int i = 2; i < word_count; i++)
-    {
-        strcat(potion_name, words[i]);
-        if (i < word_count - 1)
-            strcat(potion_name, " ");
-    }
+    receive_ingredients(ingredients, command);
+}
 
-    if (!is_valid_potion_name_spacing(line, potion_name))
-        return FALSE;
-    return TRUE;
+void item_plan_free()
+{
+    /**
+        * Function Name: item_plan_free
+        *
+        * Purpose:
+        *    Releases the calling thread's buffers for planning LOOT and TRADE lists.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    mem_free(MEM_TEMPORARIES, planned_items, planned_item_capacity * sizeof(PlannedItem));
+    mem_free(MEM_TEMPORARIES, plan_buckets, plan_bucket_capacity * sizeof(int));
+    planned_items = NULL;
+    plan_buckets = NULL;
+    planned_item_capacity = 0;
+    plan_bucket_capacity = 0;
 }
 
 PotionFormula *get_formula(const char *potion_name, PotionFormula *formulas)
@@ -365,17 +264,25 @@ PotionFormula *get_formula(const char *potion_name, PotionFormula *formulas)
         *     PotionFormula* - A pointer to the potion formula if found, NULL otherwise.
         *
         * Side Effects:
-        *     - Searches for the potion formula in the formulas array based on the potion name.
-        *     - The function does not modify any global variables or data structures.
+        *     - Searches for the potion formula in the formulas array based on the potion name,
+        *       then in the knowledge base, whose formulas are returned as a read-only view.
+        *     - The session's formulas are found in O(1) through the formula index, or by binary search
+        *       in a snapshot, whose formulas are published in name order.
         */
-    for (int i = 0; i <= last_added_formula_index; i++)
+    if (tables_read_only)
     {
-        if (strcmp(formulas[i].name, potion_name) == 0)
-        {
-            return &formulas[i];
-        }
+        int position = first_name_from(formulas, last_added_formula_index + 1, sizeof(PotionFormula), potion_name);
+        if (position <= last_added_formula_index && strcmp(formulas[position].name, potion_name) == 0)
+            return &formulas[position];
     }
-    return NULL;
+    else
+    {
+        int position = formula_index_find(potion_name);
+        if (position >= 0)
+            return &formulas[position];
+    }
+    //formulas of the knowledge base are already known, so they are never learned into the session too
+    return kb_get_formula(potion_name);
 }
 
 Bool has_formula(const char *potion_name, PotionFormula *formulas)
@@ -417,36 +324,11 @@ Bool can_brew(const char *potion_name, Ingredient *inventory, PotionFormula *for
         *     Bool - Returns TRUE if the potion can be brewed, FALSE otherwise.
         *
         * Side Effects:
-        *     - Checks if all required ingredients for the potion formula are available in sufficient quantities in the inventory.
+        *     - Same check as a batch brew of one, through brewable_count.
         *     - The function does not modify any global variables or data structures.
         */
-    // Check if the potion formula exists
     PotionFormula *formula = get_formula(potion_name, formulas);
-    if (formula == NULL)
-        return FALSE;
-
-    for (int i = 0; i < formula->ingredient_count; i++)
-    {
-        int found = FALSE;
-        for (int j = 0; j <= last_added_ingredient_index; j++)
-        {
-            // Check if the ingredient exists in the inventory and has sufficient quantity
-            // If the ingredient is found in the inventory and its quantity is sufficient
-            // we can break the loop and check the next ingredient
-            // If the ingredient is not found in the inventory or its quantity is insufficient
-            // we can return FALSE
-            if (strcmp(inventory[j].name, formula->ingredients[i].name) == 0 &&
-                inventory[j].quantity >= formula->ingredients[i].quantity)
-            {
-                found = TRUE;
-                break;
-            }
-        }
-        if (!found)
-            return FALSE;
-    }
-    // If all required ingredients are found in sufficient quantities, return TRUE
-    return TRUE;
+    return formula != NULL && brewable_count(formula, inventory) > 0;
 }
 
 void brew_potion(const char *potion_name, Ingredient *inventory, Potion *potions, PotionFormula *formulas)
@@ -458,7 +340,7 @@ void brew_potion(const char *potion_name, Ingredient *inventory, Potion *potions
         *    Brews a potion by checking if the required ingredients are available and updating the inventory and potions array.
         *
         * Parameters:
-        *     const char *potion_name - The name of the potion to be brewed.
+        *     const char *potion_name - The name of the potion to be brewed, can_brew must have allowed it.
         *     Ingredient *inventory - The array of available ingredients in the inventory.
         *     Potion *potions - The array of brewed potions.
         *     PotionFormula *formulas - The array of potion formulas.
@@ -467,194 +349,275 @@ void brew_potion(const char *potion_name, Ingredient *inventory, Potion *potions
         *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - Modifies the inventory and potions arrays by updating their quantities based on the brewed potion.
+        *     - Same as brew_potions with a count of one.
         */
-    // Check if the potion can be brewed
     PotionFormula *formula = get_formula(potion_name, formulas);
     if (formula == NULL)
         return;
+    brew_potions(formula, 1, inventory, potions);
+}
 
-    for (int i = 0; i < formula->ingredient_count; i++)
+int brewable_count(const PotionFormula *formula, const Ingredient *inventory)
+{
+    /**
+        * Function Name: brewable_count
+        *
+        * Purpose:
+        *    Computes how many potions of a formula the inventory is enough for.
+        *
+        * Parameters:
+        *     const PotionFormula *formula - The formula of the potion.
+        *     const Ingredient *inventory - The array of available ingredients in the inventory.
+        *
+        * Return:
+        *     int - The minimum over the formula's distinct ingredients of the quantity in stock divided by the
+        *           quantity required.
+        *
+        * Side Effects:
+        *     - An ingredient listed several times in the formula is required for the sum of its quantities,
+        *       so the count never takes more than the stock.
+        *     - Every distinct ingredient is found through the inventory index.
+        *     - The function does not modify any global variables or data structures.
+        */
+    int count = -1;
+    for (int i = 0; i < formula->ingredient_count && count != 0; i++)
     {
-        //we don't check if the ingredient exists in the inventory
-        //because we already checked it in the can_brew function
-        //and we know that the quantity is sufficient
-        //so we just decrease the quantity of the ingredient in the inventory
-        for (int j = 0; j <= last_added_ingredient_index; j++)
+        const char *name = formula->ingredients[i].name;
+        Bool listed_before = FALSE;
+        for (int k = 0; k < i && !listed_before; k++)
+            listed_before = strcmp(formula->ingredients[k].name, name) == 0;
+        if (listed_before)
+            continue;
+
+        long long required = formula->ingredients[i].quantity;
+        for (int k = i + 1; k < formula->ingredient_count; k++)
         {
-            if (strcmp(inventory[j].name, formula->ingredients[i].name) == 0)
-            {
-                inventory[j].quantity -= formula->ingredients[i].quantity;
-            }
+            if (strcmp(formula->ingredients[k].name, name) == 0)
+                required += formula->ingredients[k].quantity;
         }
+        int slot = inventory_index_find(RANK_INGREDIENTS, name);
+        int in_stock = slot >= 0 ? inventory[slot].quantity : 0;
+        int enough_for = in_stock > 0 ? (int)(in_stock / required) : 0;
+        if (count < 0 || enough_for < count)
+            count = enough_for;
     }
-
-    add_potion(potions, potion_name);
-    printf("Alchemy item created: %s\n", potion_name);
+    return count < 0 ? 0 : count;
 }
 
-void add_potion(Potion *potions, const char *name)
+void brew_potions(const PotionFormula *formula, int count, Ingredient *inventory, Potion *potions)
 {
     /**
-        * Function Name: add_potion
+        * Function Name: brew_potions
         *
         * Purpose:
-        *    Adds a potion to the potions array or updates its quantity if it already exists.
+        *    Brews several potions of a formula at once.
         *
         * Parameters:
-        *     Potion *potions - The array of potions.
-        *     const char *name - The name of the potion to be added or updated.
+        *     const PotionFormula *formula - The formula of the potion.
+        *     int count - The number of potions, at most what brewable_count allows.
+        *     Ingredient *inventory - The array of available ingredients in the inventory.
+        *     Potion *potions - The array of brewed potions.
         *
         * Return:
         *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - Modifies the potions array by adding a new potion or updating the quantity of an existing one.
-        *     - The function does allocate the potions array if it is full.
+        *     - Takes count times each required quantity out of the inventory in a single subtraction, count being at
+        *       most what brewable_count allows none of them goes below zero.
+        *     - Adds count to the potion's quantity and prints how many were created.
         */
-    // Check if the potion already exists in the potions array
-    // If it does, increase its quantity and return
-    for (int i = 0; i <= last_added_potion_index; i++)
+    for (int i = 0; i < formula->ingredient_count; i++)
     {
-        if (strcmp(potions[i].name, name) == 0)
-        {
-            potions[i].quantity++;
-            return;
-        }
+        int slot = inventory_index_find(RANK_INGREDIENTS, formula->ingredients[i].name);
+        int used = count * formula->ingredients[i].quantity;
+        inventory[slot].quantity -= used;
+        brew_index_ingredient_changed(inventory[slot].name, inventory[slot].quantity);
+        rank_index_changed(RANK_INGREDIENTS, inventory[slot].name, inventory[slot].quantity + used, inventory[slot].quantity);
     }
-    // If the potion does not exist, add it to the array
-    // Ensure there is enough capacity in the potions array
-    ensure_potion_capacity();
-    last_added_potion_index++;
-    strcpy(potions[last_added_potion_index].name, name);
-    potions[last_added_potion_index].quantity = 1;
+
+    add_potions(potions, formula->name, count);
+    respond_brewed(count, formula->name);
 }
 
-Bool is_valid_learn_sentence(char words[][MAX_WORD_LEN], int word_count, const char *line)
+void brew_potion_list(const Command *command, Ingredient *inventory, Potion *potions, PotionFormula *formulas)
 {
     /**
-        * Function Name: is_valid_learn_sentence
+        * Function Name: brew_potion_list
         *
         * Purpose:
-        *    Validates the format of a learn sentence.
+        *    Brews a list of potions in order, each one as if it was brewed on its own line.
+        *
+        * Parameters:
+        *     const Command *command - The brew list, one item per potion.
+        *     Ingredient *inventory - The array of available ingredients in the inventory.
+        *     Potion *potions - The array of brewed potions, must have room for every potion of the list.
+        *     PotionFormula *formulas - The array of potion formulas.
         *
         * Return:
-        *     Bool - Returns TRUE if the format is valid, FALSE otherwise.
+        *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - The function assumes that the first two words are "Geralt" and "learns".
-        *     - The function checks if the potion name is valid
-        *     - The function checks if the potion name is alphabetic and if the ingredient names are alphabetic
-        *       using the fact that all ingredients have one word names in a cyclic manner.
-        *     - The function checks if the potion name has trailing spaces.
-        *     - The function does not modify any global variables or data structures.
+        *     - Resolves every formula and every required ingredient to its inventory slot once, through the
+        *       inventory index, and sums the requirements per distinct slot. When the sums are in stock every potion
+        *       is brewed without further checks, otherwise each potion is checked with brewable_count in turn.
+        *     - Prints one response per potion, the same as BREW would, on a single line separated by ", ".
         */
-    if (word_count < 5)
-        return FALSE;
-
-    if (word_count == 8 && strcmp(words[3], "sign") == 0)
+    int potion_count = command->item_count;
+    //formulas of the knowledge base are a view overwritten by the next lookup, so they are copied
+    PotionFormula *resolved = mem_malloc(MEM_TEMPORARIES, potion_count * sizeof(PotionFormula));
+    Bool *known = mem_malloc(MEM_TEMPORARIES, potion_count * sizeof(Bool));
+    int entry_count = 0;
+    for (int i = 0; i < potion_count; i++)
     {
-        //this structure gives a learn a sign against a monster
-        if (!is_alphabetic_custom(words[2]))
-            return FALSE;
-        if (strcmp(words[4], "is") != 0 ||
-            strcmp(words[5], "effective") != 0 ||
-            strcmp(words[6], "against") != 0)
-            return FALSE;
-        if (!is_alphabetic_custom(words[7]))
-            return FALSE;
-        return TRUE;
+        PotionFormula *formula = get_formula(command_text(command, command->items[i].name), formulas);
+        known[i] = formula != NULL;
+        if (formula != NULL)
+        {
+            resolved[i] = *formula;
+            entry_count += formula->ingredient_count;
+        }
     }
 
-    int potion_idx = -1;
-    for (int i = 2; i < word_count; i++)
+    //the requirements are summed per distinct ingredient, found through a hash table of their inventory slots
+    int bucket_count = 4;
+    while (bucket_count < 2 * entry_count)
+        bucket_count *= 2;
+    int *slots = mem_malloc(MEM_TEMPORARIES, (entry_count + 1) * sizeof(int));
+    int *required_slots = mem_malloc(MEM_TEMPORARIES, (entry_count + 1) * sizeof(int));
+    long long *required = mem_malloc(MEM_TEMPORARIES, (entry_count + 1) * sizeof(long long));
+    int *buckets = mem_malloc(MEM_TEMPORARIES, bucket_count * sizeof(int));
+    memset(buckets, -1, bucket_count * sizeof(int));
+    int required_count = 0;
+    Bool all_in_stock = TRUE;
+    int entry = 0;
+    for (int i = 0; i < potion_count; i++)
     {
-        if (strcmp(words[i], "potion") == 0)
+        if (!known[i])
         {
-            potion_idx = i;
-            break;
+            all_in_stock = FALSE;
+            continue;
+        }
+        for (int k = 0; k < resolved[i].ingredient_count; k++, entry++)
+        {
+            slots[entry] = inventory_index_find(RANK_INGREDIENTS, resolved[i].ingredients[k].name);
+            if (slots[entry] < 0)
+            {
+                all_in_stock = FALSE;
+                continue;
+            }
+            int bucket = (unsigned)slots[entry] * 2654435761u & (bucket_count - 1);
+            while (buckets[bucket] >= 0 && required_slots[buckets[bucket]] != slots[entry])
+                bucket = (bucket + 1) & (bucket_count - 1);
+            if (buckets[bucket] < 0)
+            {
+                buckets[bucket] = required_count;
+                required_slots[required_count] = slots[entry];
+                required[required_count++] = 0;
+            }
+            required[buckets[bucket]] += resolved[i].ingredients[k].quantity;
         }
     }
-    if (potion_idx == -1)
-        return FALSE;
+    for (int j = 0; j < required_count && all_in_stock; j++)
+        all_in_stock = required[j] <= inventory[required_slots[j]].quantity;
 
-    if (potion_idx == 2)
-        return FALSE;
-
-    for (int i = 2; i < potion_idx; i++)
+    entry = 0;
+    for (int i = 0; i < potion_count; i++)
     {
-        if (!is_alphabetic_custom(words[i]))
-            return FALSE;
+        const char *name = command_text(command, command->items[i].name);
+        Bool last = i == potion_count - 1;
+        if (!known[i])
+        {
+            respond_one_of(RESPONSE_NO_FORMULA, name, last);
+            continue;
+        }
+        int first = entry;
+        entry += resolved[i].ingredient_count;
+        //the same check as BREW, an ingredient listed twice in the formula is required for both quantities
+        if (!all_in_stock && brewable_count(&resolved[i], inventory) == 0)
+        {
+            respond_one_of(RESPONSE_NOT_ENOUGH_INGREDIENTS, NULL, last);
+            continue;
+        }
+        for (int k = first; k < entry; k++)
+        {
+            inventory[slots[k]].quantity -= resolved[i].ingredients[k - first].quantity;
+            brew_index_ingredient_changed(inventory[slots[k]].name, inventory[slots[k]].quantity);
+            rank_index_changed(RANK_INGREDIENTS, inventory[slots[k]].name, inventory[slots[k]].quantity + resolved[i].ingredients[k - first].quantity, inventory[slots[k]].quantity);
+        }
+        add_potion(potions, name);
+        respond_one_of(RESPONSE_POTION_BREWED, name, last);
     }
 
-    char potion_name[MAX_LINE_LENGTH] = "";
-    for (int i = 2; i < potion_idx; i++)
-    {
-        strcat(potion_name, words[i]);
-        if (i < potion_idx - 1)
-            strcat(potion_name, " ");
-    }
-    // Check if the potion name is valid
-    if (!is_valid_potion_name_spacing(line, potion_name))
-        return FALSE;
+    mem_free(MEM_TEMPORARIES, resolved, potion_count * sizeof(PotionFormula));
+    mem_free(MEM_TEMPORARIES, known, potion_count * sizeof(Bool));
+    mem_free(MEM_TEMPORARIES, slots, (entry_count + 1) * sizeof(int));
+    mem_free(MEM_TEMPORARIES, required_slots, (entry_count + 1) * sizeof(int));
+    mem_free(MEM_TEMPORARIES, required, (entry_count + 1) * sizeof(long long));
+    mem_free(MEM_TEMPORARIES, buckets, bucket_count * sizeof(int));
+}
 
-    if (potion_idx + 1 >= word_count)
-        return FALSE;
+void add_potion(Potion *potions, const char *name)
+{
+    /**
+        * Function Name: add_potion
+        *
+        * Purpose:
+        *    Adds a potion to the potions array or updates its quantity if it already exists.
+        *
+        * Parameters:
+        *     Potion *potions - The array of potions.
+        *     const char *name - The name of the potion to be added or updated.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Same as add_potions with a count of one.
+        */
+    add_potions(potions, name, 1);
+}
 
-    if (strcmp(words[potion_idx + 1], "is") == 0)
-    {
-        //this structure gives a learn a potion against a monster
-        if (word_count != potion_idx + 5)
-            return FALSE;
-        if (strcmp(words[potion_idx + 2], "effective") != 0 ||
-            strcmp(words[potion_idx + 3], "against") != 0)
-            return FALSE;
-        if (!is_alphabetic_custom(words[potion_idx + 4]))
-            return FALSE;
-        return TRUE;
-    }
-    else if (strcmp(words[potion_idx + 1], "consists") == 0)
+void add_potions(Potion *potions, const char *name, int count)
+{
+    /**
+        * Function Name: add_potions
+        *
+        * Purpose:
+        *    Adds potions to the potions array or updates their quantity if they already exist.
+        *
+        * Parameters:
+        *     Potion *potions - The array of potions.
+        *     const char *name - The name of the potion to be added or updated.
+        *     int count - The number of potions.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Modifies the potions array by adding a new potion or updating the quantity of an existing one.
+        *     - The function does allocate the potions array if it is full.
+        */
+    // Check if the potion already exists in the potions array
+    // If it does, increase its quantity and return
+    for (int i = 0; i <= last_added_potion_index; i++)
     {
-        //this structure gives a learn a potion formula
-        if (potion_idx + 2 >= word_count)
-            return FALSE;
-        if (strcmp(words[potion_idx + 2], "of") != 0)
-            return FALSE;
-
-        int curr_index = potion_idx + 3;
-        if (curr_index >= word_count)
-            return FALSE;
-
-        while (curr_index < word_count)
+        if (strcmp(potions[i].name, name) == 0)
         {
-            if (curr_index + 1 >= word_count)
-                return FALSE;
-            if (!is_digit_custom(words[curr_index]))
-                return FALSE;
-            if (!is_alphabetic_custom(words[curr_index + 1]))
-                return FALSE;
-            int quantity = atoi(words[curr_index]);
-            if (quantity <= 0)
-                return FALSE;
-            if (!is_alphabetic_custom(words[curr_index + 1]))
-                return FALSE;
-            curr_index += 2;
-
-            if (curr_index >= word_count)
-                break;
-            if (strcmp(words[curr_index], ",") != 0)
-                return FALSE;
-            curr_index++;
+            potions[i].quantity += count;
+            rank_index_changed(RANK_POTIONS, name, potions[i].quantity - count, potions[i].quantity);
+            return;
         }
-        return TRUE;
-    }
-    else
-    {
-        return FALSE;
     }
+    // If the potion does not exist, add it to the array
+    // Ensure there is enough capacity in the potions array
+    ensure_potion_capacity();
+    last_added_potion_index++;
+    potions[last_added_potion_index].name = name_pool_intern(name);
+    potions[last_added_potion_index].quantity = count;
+    rank_index_changed(RANK_POTIONS, name, 0, count);
 }
 
-Bool learn_potion_formula(char words[][MAX_WORD_LEN], int word_count, PotionFormula *formulas)
+Bool learn_potion_formula(const Command *command, PotionFormula *formulas)
 {
     /**
         * Function Name: learn_potion_formula
@@ -663,30 +626,22 @@ Bool learn_potion_formula(char words[][MAX_WORD_LEN], int word_count, PotionForm
         *    Learns a new potion formula by adding it to the formulas array.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The total number of words in the input line.
+        *     const Command *command - The parsed LEARN formula sentence, its items are the ingredients.
         *     PotionFormula *formulas - The array of potion formulas.
         *
         * Return:
         *     Bool - Returns TRUE if the formula was learned successfully, FALSE otherwise.
         *
         * Side Effects:
-        *     - Modifies the formulas array by adding a new potion formula.
+        *     - Modifies the formulas array by adding a new potion formula, its ingredients in decreasing quantity
+        *       order, then in name order.
+        *     - Files the new formula in the brew index.
         */
-    int i = 2;
-    char potion_name[MAX_WORD_LEN] = "";
-    while (i < word_count && strcmp(words[i], "potion") != 0)
-    {
-        strcat(potion_name, words[i]);
-        strcat(potion_name, " ");
-        i++;
-    }
-    potion_name[strlen(potion_name) - 1] = '\0';
-    i += 3;
+    const char *potion_name = command_text(command, command->name);
 
     if (has_formula(potion_name, formulas))
     {
-        printf("Already known formula\n");
+        respond(RESPONSE_FORMULA_KNOWN, NULL);
         return TRUE;
     }
 
@@ -695,40 +650,72 @@ Bool learn_potion_formula(char words[][MAX_WORD_LEN], int word_count, PotionForm
     last_added_formula_index++;
 
     PotionFormula *formula = &formulas[last_added_formula_index];
-    strcpy(formula->name, potion_name);
+    formula->name = name_pool_intern(potion_name);
     formula->ingredient_capacity = 4;
     formula->ingredient_count = 0;
-    formula->ingredients = malloc(sizeof(Ingredient) * formula->ingredient_capacity);
+    formula->ingredients = mem_malloc(MEM_FORMULAS, sizeof(Ingredient) * formula->ingredient_capacity);
     if (!formula->ingredients) return FALSE;
 
-    while (i < word_count)
+    for (int i = 0; i < command->item_count; i++)
     {
-        if (i + 1 >= word_count) return FALSE;
-        if (!is_digit_custom(words[i]) || !is_alphabetic_custom(words[i + 1])) return FALSE;
-
-        int quantity = atoi(words[i]);
-        if (quantity <= 0) return FALSE;
-
         if (formula->ingredient_count >= formula->ingredient_capacity)
         {
+            formula->ingredients = mem_realloc(MEM_FORMULAS, formula->ingredients, sizeof(Ingredient) * formula->ingredient_capacity,
+                                               sizeof(Ingredient) * formula->ingredient_capacity * 2);
             formula->ingredient_capacity *= 2;
-            formula->ingredients = realloc(formula->ingredients, sizeof(Ingredient) * formula->ingredient_capacity);
             if (!formula->ingredients) return FALSE;
         }
 
-        strcpy(formula->ingredients[formula->ingredient_count].name, words[i + 1]);
-        formula->ingredients[formula->ingredient_count].quantity = quantity;
+        formula->ingredients[formula->ingredient_count].name = name_pool_intern(command_text(command, command->items[i].name));
+        formula->ingredients[formula->ingredient_count].quantity = command->items[i].quantity;
         formula->ingredient_count++;
-
-        i += 2;
-        if (i < word_count && strcmp(words[i], ",") == 0) i++;
     }
+    //a formula never changes once learned, so it is kept in the order "What is in" lists it
+    qsort(formula->ingredients, formula->ingredient_count, sizeof(Ingredient), cmpForRecipe);
+    brew_index_formula_learned(last_added_formula_index);
+
+    respond(RESPONSE_FORMULA_LEARNED, potion_name);
+    return TRUE;
+}
 
-    printf("New alchemy formula obtained: %s\n", potion_name);
+static Bool add_effective(Monster *m, const char *thing_name, Bool is_sign)
+{
+    /**
+        * Function Name: add_effective
+        *
+        * Purpose:
+        *    Adds a sign or potion to the effective ones of a monster, keeping them in name order.
+        *
+        * Parameters:
+        *     Monster *m - The monster.
+        *     const char *thing_name - The name of the sign or potion.
+        *     Bool is_sign - TRUE for a sign, FALSE for a potion.
+        *
+        * Return:
+        *     Bool - TRUE if it was added, FALSE if the monster already had it.
+        *
+        * Side Effects:
+        *     - Finds the place of the name by binary search and shifts the names after it.
+        */
+    if (is_sign)
+        ensure_monster_sign_capacity(m);
+    else
+        ensure_monster_potion_capacity(m);
+    //signs and potions share the same layout
+    Potion *effective = is_sign ? (Potion *)m->signs : m->potions;
+    int *count = is_sign ? &m->sign_count : &m->potion_count;
+
+    int position = first_name_from(effective, *count, sizeof(Potion), thing_name);
+    if (position < *count && strcmp(effective[position].name, thing_name) == 0)
+        return FALSE;
+    memmove(&effective[position + 1], &effective[position], (*count - position) * sizeof(Potion));
+    effective[position].name = name_pool_intern(thing_name);
+    effective[position].quantity = 1;
+    (*count)++;
     return TRUE;
 }
 
-Bool learn_effectiveness(char words[][MAX_WORD_LEN], int word_count, Monster *monsters)
+Bool learn_effectiveness(const Command *command, Monster *monsters)
 {
     /**
         * Function Name: learn_effectiveness
@@ -737,8 +724,7 @@ Bool learn_effectiveness(char words[][MAX_WORD_LEN], int word_count, Monster *mo
         *    Learns the effectiveness of a sign or potion against a monster by adding it to the monster's entry.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The total number of words in the input line.
+        *     const Command *command - The parsed LEARN effectiveness sentence.
         *     Monster *monsters - The array of monsters.
         *
         * Return:
@@ -746,26 +732,13 @@ Bool learn_effectiveness(char words[][MAX_WORD_LEN], int word_count, Monster *mo
         *
         * Side Effects:
         *     - Modifies the monsters array by adding a new effectiveness entry for the specified monster.
+        *     - For a monster of the knowledge base, the session entry only holds what was learned on top of it.
+        *     - The signs and the potions of a monster are kept in name order.
+        *     - Files the monster under the sign or potion in the bestiary index.
         */
-    char monster_name[MAX_WORD_LEN];
-
-    char thing_name[MAX_WORD_LEN] = "";
-    char thing_type[MAX_WORD_LEN] = "";
-
-    int i = 2;
-    while (i < word_count && strcmp(words[i], "sign") != 0 && strcmp(words[i], "potion") != 0)
-    {
-        strcat(thing_name, words[i]);
-        if (i + 1 < word_count && strcmp(words[i + 1], "sign") != 0 && strcmp(words[i + 1], "potion") != 0)
-            strcat(thing_name, " ");
-        i++;
-    }
-
-    if (i >= word_count)
-        return FALSE;
-
-    strcpy(thing_type, words[i]);
-    strcpy(monster_name, words[word_count - 1]);
+    const char *monster_name = command_text(command, command->target);
+    const char *thing_name = command_text(command, command->name);
+    const KbMonster *known_monster = kb_find_monster(monster_name);
 
     int monster_index = -1;
     for (int i = 0; i <= last_added_monster_index; i++) {
@@ -775,99 +748,107 @@ Bool learn_effectiveness(char words[][MAX_WORD_LEN], int word_count, Monster *mo
         }
     }
 
+    if (kb_knows_effectiveness(known_monster, thing_name, command->is_sign)) {
+        respond(RESPONSE_EFFECTIVENESS_KNOWN, NULL);
+        return TRUE;
+    }
+
     if (monster_index == -1) {
         ensure_monster_capacity();
         last_added_monster_index++;
         monster_index = last_added_monster_index;
         Monster *m = &monsters[monster_index];
-        strcpy(m->name, monster_name);
+        m->name = name_pool_intern(monster_name);
+        rank_index_add_name(RANK_MONSTERS, monster_name);
 
         m->sign_capacity = 4;
         m->sign_count = 0;
-        m->signs = malloc(m->sign_capacity * sizeof(Sign));
+        m->signs = mem_malloc(MEM_BESTIARY, m->sign_capacity * sizeof(Sign));
 
         m->potion_capacity = 4;
         m->potion_count = 0;
-        m->potions = malloc(m->potion_capacity * sizeof(Potion));
-
-        if (strcmp(thing_type, "sign") == 0) {
-            ensure_monster_sign_capacity(m);
-            strcpy(m->signs[m->sign_count].name, thing_name);
-            m->signs[m->sign_count].quantity = 1;
-            m->sign_count++;
-        } else {
-            ensure_monster_potion_capacity(m);
-            strcpy(m->potions[m->potion_count].name, thing_name);
-            m->potions[m->potion_count].quantity = 1;
-            m->potion_count++;
-        }
+        m->potions = mem_malloc(MEM_BESTIARY, m->potion_capacity * sizeof(Potion));
 
-        printf("New bestiary entry added: %s\n", monster_name);
+        add_effective(m, thing_name, command->is_sign);
+        bestiary_index_learned(thing_name, monster_index);
+
+        if (known_monster != NULL)
+            respond(RESPONSE_BESTIARY_UPDATED, monster_name);
+        else
+            respond(RESPONSE_BESTIARY_ADDED, monster_name);
         return TRUE;
     }
 
-    Monster *m = &monsters[monster_index];
+    if (!add_effective(&monsters[monster_index], thing_name, command->is_sign)) {
+        respond(RESPONSE_EFFECTIVENESS_KNOWN, NULL);
+        return TRUE;
+    }
+    bestiary_index_learned(thing_name, monster_index);
 
-    if (strcmp(thing_type, "sign") == 0) {
-        for (int i = 0; i < m->sign_count; i++) {
-            if (strcmp(m->signs[i].name, thing_name) == 0) {
-                printf("Already known effectiveness\n");
-                return TRUE;
-            }
-        }
-        ensure_monster_sign_capacity(m);
-        strcpy(m->signs[m->sign_count].name, thing_name);
-        m->signs[m->sign_count].quantity = 1;
-        m->sign_count++;
-    } else {
-        for (int i = 0; i < m->potion_count; i++) {
-            if (strcmp(m->potions[i].name, thing_name) == 0) {
-                printf("Already known effectiveness\n");
+    respond(RESPONSE_BESTIARY_UPDATED, monster_name);
+    return TRUE;
+}
+
+static Bool has_potion_in_stock(const Potion *effective, int effective_count, Potion *potions)
+{
+    /**
+        * Function Name: has_potion_in_stock
+        *
+        * Purpose:
+        *    Checks if Geralt has at least one of the given effective potions.
+        *
+        * Parameters:
+        *     const Potion *effective - The potions effective against a monster.
+        *     int effective_count - The number of effective potions.
+        *     Potion *potions - The array of potions.
+        *
+        * Return:
+        *     Bool - TRUE if one of them is in stock, FALSE otherwise.
+        */
+    for (int i = 0; i < effective_count; i++)
+    {
+        for (int j = 0; j <= last_added_potion_index; j++)
+        {
+            if (strcmp(effective[i].name, potions[j].name) == 0 && potions[j].quantity > 0)
                 return TRUE;
-            }
         }
-        ensure_monster_potion_capacity(m);
-        strcpy(m->potions[m->potion_count].name, thing_name);
-        m->potions[m->potion_count].quantity = 1;
-        m->potion_count++;
     }
-
-    printf("Bestiary entry updated: %s\n", monster_name);
-    return TRUE;
+    return FALSE;
 }
 
-Bool is_valid_encounter_sentence(char words[][MAX_WORD_LEN], int word_count)
+static void use_potions(const Potion *effective, int effective_count, Potion *potions)
 {
     /**
-        * Function Name: is_valid_encounter_sentence
+        * Function Name: use_potions
         *
         * Purpose:
-        *    Validates the format of an encounter sentence.
+        *    Uses one of each given effective potion that Geralt has.
+        *
+        * Parameters:
+        *     const Potion *effective - The potions effective against a monster.
+        *     int effective_count - The number of effective potions.
+        *     Potion *potions - The array of potions.
         *
         * Return:
-        *     Bool - Returns TRUE if the format is valid, FALSE otherwise.
+        *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - The function assumes that the first two words are "Geralt" and "encounters".
-        *     - The function checks if the monster name is alphabetic and if the word count is exactly 4.
-        *     - The function does not modify any global variables or data structures.
+        *     - Decreases the quantity of every effective potion in stock by one.
         */
-    if (word_count != 4)
-        return FALSE;
-
-    if (strcmp(words[0], "Geralt") != 0)
-        return FALSE;
-    if (strcmp(words[1], "encounters") != 0)
-        return FALSE;
-    if (strcmp(words[2], "a") != 0)
-        return FALSE;
-    if (!is_alphabetic_custom(words[3]))
-        return FALSE;
-
-    return TRUE;
+    for (int i = 0; i < effective_count; i++)
+    {
+        for (int j = 0; j <= last_added_potion_index; j++)
+        {
+            if (strcmp(effective[i].name, potions[j].name) == 0 && potions[j].quantity > 0)
+            {
+                potions[j].quantity--;
+                rank_index_changed(RANK_POTIONS, potions[j].name, potions[j].quantity + 1, potions[j].quantity);
+            }
+        }
+    }
 }
 
-void handle_encounter(char words[][MAX_WORD_LEN], int word_count, Monster *monsters, Potion *potions, Trophy *trophies)
+void handle_encounter(const char *monster_name, Monster *monsters, Potion *potions, Trophy *trophies)
 {
     /**
         * Function Name: handle_encounter
@@ -876,8 +857,7 @@ void handle_encounter(char words[][MAX_WORD_LEN], int word_count, Monster *monst
         *    Handles the encounter with a monster by checking if Geralt is prepared and updating the trophies.
         *
         * Parameters:
-        *     char words[][MAX_WORD_LEN] - The array of words from the input line.
-        *     int word_count - The total number of words in the input line.
+        *     const char *monster_name - The name of the encountered monster.
         *     Monster *monsters - The array of monsters.
         *     Potion *potions - The array of potions.
         *     Trophy *trophies - The array of trophies.
@@ -887,16 +867,9 @@ void handle_encounter(char words[][MAX_WORD_LEN], int word_count, Monster *monst
         *
         * Side Effects:
         *     - Modifies the trophies array by updating the quantity of the trophy obtained from the encounter.
+        *     - A fight won with INT_MAX trophies of the monster already is INVALID and changes nothing,
+        *       the same ceiling as handle_encounters.
         */
-    if (word_count < 4 || strcmp(words[2], "a") != 0)
-    {
-        printf("INVALID\n");
-        return;
-    }
-
-    char monster_name[MAX_WORD_LEN];
-    strcpy(monster_name, words[3]);
-
     int monster_index = -1;
     for (int i = 0; i <= last_added_monster_index; i++)
     {
@@ -907,65 +880,180 @@ void handle_encounter(char words[][MAX_WORD_LEN], int word_count, Monster *monst
             break;
         }
     }
+    const KbMonster *known_monster = kb_find_monster(monster_name);
 
-    if (monster_index == -1)
+    if (monster_index == -1 && known_monster == NULL)
     {
-        printf("Geralt is unprepared and barely escapes with his life\n");
+        respond(RESPONSE_UNPREPARED, NULL);
         return;
     }
 
-    Monster *m = &monsters[monster_index];
+    //what the knowledge base lists and what the session learned on top of it are both effective
+    Monster *m = monster_index == -1 ? NULL : &monsters[monster_index];
+    const Potion *known_potions = known_monster == NULL ? NULL : kb_monster_potions(known_monster);
+    int known_potion_count = known_monster == NULL ? 0 : known_monster->potion_count;
 
-    int has_effective_sign = m->sign_count > 0;
+    int has_effective_sign = (m != NULL && m->sign_count > 0) || (known_monster != NULL && known_monster->sign_count > 0);
     int has_effective_potion = 0;
 
     //checks if Geralt has an effective potion against the monster
-    for (int i = 0; i < m->potion_count; i++)
-    {
-        for (int j = 0; j <= last_added_potion_index; j++)
-        {
-            if (strcmp(m->potions[i].name, potions[j].name) == 0 && potions[j].quantity > 0)
-            {
-                has_effective_potion = 1;
-                break;
-            }
-        }
-    }
+    if (m != NULL && has_potion_in_stock(m->potions, m->potion_count, potions))
+        has_effective_potion = 1;
+    if (has_potion_in_stock(known_potions, known_potion_count, potions))
+        has_effective_potion = 1;
 
     if (!has_effective_sign && !has_effective_potion)
     {
         //if no sign or potion is effective against the monster we can't fight
-        printf("Geralt is unprepared and barely escapes with his life\n");
+        respond(RESPONSE_UNPREPARED, NULL);
         return;
     }
 
-    printf("Geralt defeats %s\n", monster_name);
+    int trophy_index = -1;
+    for (int i = 0; i <= last_added_trophy_index && trophy_index < 0; i++)
+    {
+        if (strcmp(trophies[i].name, monster_name) == 0)
+            trophy_index = i;
+    }
+    if (trophy_index >= 0 && trophies[trophy_index].quantity == INT_MAX)
+    {
+        respond(RESPONSE_INVALID, NULL);
+        return;
+    }
+
+    respond(RESPONSE_MONSTER_DEFEATED, monster_name);
 
     //uses all possessed potions just in case
-    for (int i = 0; i < m->potion_count; i++)
+    if (m != NULL)
+        use_potions(m->potions, m->potion_count, potions);
+    use_potions(known_potions, known_potion_count, potions);
+
+    if (trophy_index >= 0)
     {
+        trophies[trophy_index].quantity++;
+        rank_index_changed(RANK_TROPHIES, monster_name, trophies[trophy_index].quantity - 1, trophies[trophy_index].quantity);
+        return;
+    }
+    // If the trophy does not exist, add it to the array
+    // Ensure there is enough capacity in the trophies array
+    ensure_trophy_capacity();
+    last_added_trophy_index++;
+    trophies[last_added_trophy_index].name = name_pool_intern(monster_name);
+    trophies[last_added_trophy_index].quantity = 1;
+    rank_index_changed(RANK_TROPHIES, monster_name, 0, 1);
+}
+void handle_encounters(const char *monster_name, int count, Monster *monsters, Potion *potions, Trophy *trophies)
+{
+    /**
+        * Function Name: handle_encounters
+        *
+        * Purpose:
+        *    Handles a number of encounters with the same monster at once, as that many handle_encounter calls would.
+        *
+        * Parameters:
+        *     const char *monster_name - The name of the encountered monster.
+        *     int count - The number of encounters.
+        *     Monster *monsters - The array of monsters.
+        *     Potion *potions - The array of potions.
+        *     Trophy *trophies - The array of trophies, with room for one more trophy.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Uses up the effective potions and adds one trophy per fight won, in one step instead of one per fight.
+        *     - The potion arithmetic is done in long long. Fights won that would take the trophies past INT_MAX
+        *       make the command INVALID, and it changes nothing.
+        *     - Prints how many fights were won and how many times Geralt escaped.
+        */
+    int monster_index = -1;
+    for (int i = 0; i <= last_added_monster_index; i++)
+    {
+        if (strcmp(monsters[i].name, monster_name) == 0)
+        {
+            monster_index = i;
+            break;
+        }
+    }
+    const KbMonster *known_monster = kb_find_monster(monster_name);
+    Monster *m = monster_index == -1 ? NULL : &monsters[monster_index];
+
+    //every fight uses one of each effective potion in stock, once per list naming it,
+    //so a potion lasts ceil(stock / uses) fights
+    int list_count = (m != NULL ? m->potion_count : 0) + (known_monster != NULL ? known_monster->potion_count : 0);
+    int *slots = mem_malloc(MEM_TEMPORARIES, (list_count + 1) * sizeof(int));
+    int *uses = mem_malloc(MEM_TEMPORARIES, (list_count + 1) * sizeof(int));
+    int slot_count = 0;
+    for (int i = 0; i < list_count; i++)
+    {
+        const char *effective = m != NULL && i < m->potion_count ? m->potions[i].name
+                                                                 : kb_monster_potions(known_monster)[i - (m != NULL ? m->potion_count : 0)].name;
         for (int j = 0; j <= last_added_potion_index; j++)
         {
-            if (strcmp(m->potions[i].name, potions[j].name) == 0 && potions[j].quantity > 0)
+            if (strcmp(effective, potions[j].name) != 0 || potions[j].quantity <= 0)
+                continue;
+            int k = 0;
+            while (k < slot_count && slots[k] != j)
+                k++;
+            if (k == slot_count)
             {
-                potions[j].quantity--;
+                slots[slot_count] = j;
+                uses[slot_count++] = 0;
             }
+            uses[k]++;
         }
     }
 
-    for (int i = 0; i <= last_added_trophy_index; i++)
+    Bool has_effective_sign = (m != NULL && m->sign_count > 0) || (known_monster != NULL && known_monster->sign_count > 0);
+    int won = 0;
+    if (has_effective_sign)
+        won = count;
+    for (int k = 0; k < slot_count && won < count; k++)
+    {
+        long long lasts = ((long long)potions[slots[k]].quantity + uses[k] - 1) / uses[k];
+        if (lasts > won)
+            won = lasts < count ? (int)lasts : count;
+    }
+
+    int trophy_index = -1;
+    for (int i = 0; i <= last_added_trophy_index && trophy_index < 0; i++)
     {
-        // Check if the trophy name matches the one in the trophies array, then increase by 1
         if (strcmp(trophies[i].name, monster_name) == 0)
-        {
-            trophies[i].quantity++;
-            return;
-        }
+            trophy_index = i;
+    }
+    if (trophy_index >= 0 && trophies[trophy_index].quantity > INT_MAX - won)
+    {
+        mem_free(MEM_TEMPORARIES, slots, (list_count + 1) * sizeof(int));
+        mem_free(MEM_TEMPORARIES, uses, (list_count + 1) * sizeof(int));
+        respond(RESPONSE_INVALID, NULL);
+        return;
+    }
+
+    for (int k = 0; k < slot_count; k++)
+    {
+        Potion *potion = &potions[slots[k]];
+        long long used = (long long)uses[k] * won;
+        int quantity = used >= potion->quantity ? 0 : potion->quantity - (int)used;
+        rank_index_changed(RANK_POTIONS, potion->name, potion->quantity, quantity);
+        potion->quantity = quantity;
+    }
+    mem_free(MEM_TEMPORARIES, slots, (list_count + 1) * sizeof(int));
+    mem_free(MEM_TEMPORARIES, uses, (list_count + 1) * sizeof(int));
+
+    int escaped = count - won;
+    respond_encounters(won, escaped, monster_name);
+    if (won == 0)
+        return;
+
+    if (trophy_index >= 0)
+    {
+        trophies[trophy_index].quantity += won;
+        rank_index_changed(RANK_TROPHIES, monster_name, trophies[trophy_index].quantity - won, trophies[trophy_index].quantity);
+        return;
     }
-    // If the trophy does not exist, add it to the array
-    // Ensure there is enough capacity in the trophies array
     ensure_trophy_capacity();
     last_added_trophy_index++;
-    strcpy(trophies[last_added_trophy_index].name, monster_name);
-    trophies[last_added_trophy_index].quantity = 1;
-}
\ No newline at end of file
+    trophies[last_added_trophy_index].name = name_pool_intern(monster_name);
+    trophies[last_added_trophy_index].quantity = won;
+    rank_index_changed(RANK_TROPHIES, monster_name, 0, won);
+}
@@ -0,0 +1,570 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "globals.h"
+
+void snapshot_store_init(SnapshotStore *store)
+{
+    /**
+        * Function Name: snapshot_store_init
+        *
+        * Purpose:
+        *    Creates an empty snapshot store, nothing is readable until the first snapshot_publish.
+        *
+        * Parameters:
+        *     SnapshotStore *store - The store to be created.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    atomic_init(&store->current, NULL);
+    store->retired_count = 0;
+    store->retired_capacity = 16;
+    store->retired = malloc(store->retired_capacity * sizeof(RetiredBlock));
+}
+
+unsigned snapshot_dirty_tables(CommandKind kind)
+{
+    /**
+        * Function Name: snapshot_dirty_tables
+        *
+        * Purpose:
+        *    Tells which tables a command may change, so only those are copied by the next snapshot_publish.
+        *
+        * Parameters:
+        *     CommandKind kind - The kind of the command executed.
+        *
+        * Return:
+        *     unsigned - The dirty mask, 0 for commands that only read.
+        */
+    switch (kind)
+    {
+    case COMMAND_LOOT:
+        return 1 << SNAPSHOT_INGREDIENTS | 1 << SNAPSHOT_RANKED_INGREDIENTS | 1 << SNAPSHOT_BREWABLE;
+    case COMMAND_TRADE:
+        return 1 << SNAPSHOT_INGREDIENTS | 1 << SNAPSHOT_RANKED_INGREDIENTS | 1 << SNAPSHOT_TROPHIES | 1 << SNAPSHOT_RANKED_TROPHIES |
+               1 << SNAPSHOT_BREWABLE;
+    case COMMAND_BREW:
+    case COMMAND_BREW_BATCH:
+    case COMMAND_BREW_LIST:
+        return 1 << SNAPSHOT_INGREDIENTS | 1 << SNAPSHOT_RANKED_INGREDIENTS | 1 << SNAPSHOT_POTIONS | 1 << SNAPSHOT_RANKED_POTIONS |
+               1 << SNAPSHOT_BREWABLE;
+    case COMMAND_LEARN_FORMULA:
+        return 1 << SNAPSHOT_FORMULAS | 1 << SNAPSHOT_BREWABLE | 1 << SNAPSHOT_USES;
+    case COMMAND_LEARN_EFFECTIVENESS:
+        return 1 << SNAPSHOT_MONSTERS | 1 << SNAPSHOT_EFFECTIVE;
+    case COMMAND_ENCOUNTER:
+    case COMMAND_ENCOUNTER_BATCH:
+        //the encounter uses up the potions that are effective against the monster
+        return 1 << SNAPSHOT_POTIONS | 1 << SNAPSHOT_RANKED_POTIONS | 1 << SNAPSHOT_TROPHIES | 1 << SNAPSHOT_RANKED_TROPHIES;
+    default:
+        return 0;
+    }
+}
+
+static TableVersion *copy_counted_table(const void *items, int count, size_t item_size, int (*compare)(const void *, const void *))
+{
+    /**
+        * Function Name: copy_counted_table
+        *
+        * Purpose:
+        *    Copies an ingredient, potion or trophy table into a new immutable version.
+        *
+        * Parameters:
+        *     const void *items - The first item of the table.
+        *     int count - The number of items.
+        *     size_t item_size - The size of one item.
+        *     int (*compare)(const void *, const void *) - The name comparator of the items.
+        *
+        * Return:
+        *     TableVersion * - The new version, a single block.
+        *
+        * Side Effects:
+        *     - The copy is sorted by name once here, so readers never have to sort the shared table.
+        */
+    TableVersion *table = malloc(sizeof(TableVersion) + count * item_size);
+    table->count = count;
+    table->items = table + 1;
+    memcpy(table->items, items, count * item_size);
+    qsort(table->items, count, item_size, compare);
+    return table;
+}
+
+static TableVersion *copy_formula_table()
+{
+    /**
+        * Function Name: copy_formula_table
+        *
+        * Purpose:
+        *    Copies the calling thread's formulas, with their ingredient lists, into a new immutable version.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     TableVersion * - The new version, a single block sorted by name.
+        */
+    int count = last_added_formula_index + 1;
+    int ingredient_total = 0;
+    for (int i = 0; i < count; i++)
+        ingredient_total += formulas[i].ingredient_count;
+
+    TableVersion *table = malloc(sizeof(TableVersion) + count * sizeof(PotionFormula) + ingredient_total * sizeof(Ingredient));
+    PotionFormula *copies = (PotionFormula *)(table + 1);
+    Ingredient *next_ingredient = (Ingredient *)(copies + count);
+    table->count = count;
+    table->items = copies;
+
+    for (int i = 0; i < count; i++)
+    {
+        copies[i] = formulas[i];
+        copies[i].ingredients = next_ingredient;
+        copies[i].ingredient_capacity = formulas[i].ingredient_count;
+        memcpy(next_ingredient, formulas[i].ingredients, formulas[i].ingredient_count * sizeof(Ingredient));
+        next_ingredient += formulas[i].ingredient_count;
+    }
+    qsort(copies, count, sizeof(PotionFormula), cmpFormula);
+    return table;
+}
+
+static TableVersion *copy_monster_table()
+{
+    /**
+        * Function Name: copy_monster_table
+        *
+        * Purpose:
+        *    Copies the calling thread's monsters, with their signs and potions, into a new immutable version.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     TableVersion * - The new version, a single block sorted by name.
+        */
+    int count = last_added_monster_index + 1;
+    int sign_total = 0;
+    int potion_total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        sign_total += monsters[i].sign_count;
+        potion_total += monsters[i].potion_count;
+    }
+
+    TableVersion *table = malloc(sizeof(TableVersion) + count * sizeof(Monster) + sign_total * sizeof(Sign) + potion_total * sizeof(Potion));
+    Monster *copies = (Monster *)(table + 1);
+    Sign *next_sign = (Sign *)(copies + count);
+    Potion *next_potion = (Potion *)(next_sign + sign_total);
+    table->count = count;
+    table->items = copies;
+
+    for (int i = 0; i < count; i++)
+    {
+        copies[i] = monsters[i];
+        copies[i].signs = next_sign;
+        copies[i].sign_capacity = monsters[i].sign_count;
+        memcpy(next_sign, monsters[i].signs, monsters[i].sign_count * sizeof(Sign));
+        next_sign += monsters[i].sign_count;
+
+        copies[i].potions = next_potion;
+        copies[i].potion_capacity = monsters[i].potion_count;
+        memcpy(next_potion, monsters[i].potions, monsters[i].potion_count * sizeof(Potion));
+        next_potion += monsters[i].potion_count;
+    }
+    qsort(copies, count, sizeof(Monster), cmpMonster);
+    return table;
+}
+
+static TableVersion *copy_brewable_table()
+{
+    /**
+        * Function Name: copy_brewable_table
+        *
+        * Purpose:
+        *    Copies the potions the calling thread's inventory is enough for into a new immutable version.
+        *
+        * Parameters:
+        *     void - This function does not take any parameters.
+        *
+        * Return:
+        *     TableVersion * - The new version, a single block sorted by name.
+        */
+    TableVersion *table = malloc(sizeof(TableVersion) + brew_index.brewable_count * sizeof(Potion));
+    table->items = table + 1;
+    table->count = brew_index_collect(table->items);
+    qsort(table->items, table->count, sizeof(Potion), cmpPotion);
+    return table;
+}
+
+static TableVersion *copy_ranked_table(RankTable ranked)
+{
+    /**
+        * Function Name: copy_ranked_table
+        *
+        * Purpose:
+        *    Copies the items in stock of one of the calling thread's inventories into a new immutable version.
+        *
+        * Parameters:
+        *     RankTable ranked - The inventory.
+        *
+        * Return:
+        *     TableVersion * - The new version, a single block of Ingredient in rank index order.
+        */
+    TableVersion *table = malloc(sizeof(TableVersion) + rank_index[ranked].count * sizeof(Ingredient));
+    table->items = table + 1;
+    table->count = rank_index_collect(ranked, table->items);
+    return table;
+}
+
+static int cmp_posting(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmp_posting
+        *
+        * Purpose:
+        *    Orders postings by name, then by owner.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first posting.
+        *     const void *b - Pointer to the second posting.
+        *
+        * Return:
+        *     int - Negative if a < b, positive if a > b, zero if equal.
+        */
+    const Posting *first = a;
+    const Posting *second = b;
+    int by_name = strcmp(first->name, second->name);
+    return by_name != 0 ? by_name : strcmp(first->owner, second->owner);
+}
+
+static TableVersion *copy_postings_table(Bool uses)
+{
+    /**
+        * Function Name: copy_postings_table
+        *
+        * Purpose:
+        *    Copies one of the calling thread's reverse indexes into a new immutable version of sorted postings.
+        *
+        * Parameters:
+        *     Bool uses - TRUE for ingredient to formula, FALSE for sign or potion to monster.
+        *
+        * Return:
+        *     TableVersion * - The new version, a single block sorted by name then owner, without repeated pairs.
+        */
+    int count = 0;
+    int bucket_count = uses ? brew_index.bucket_count : bestiary_index.bucket_count;
+    for (int i = 0; i < bucket_count; i++)
+    {
+        if (uses)
+            for (const BrewIngredient *entry = brew_index.buckets[i]; entry != NULL; entry = entry->next_in_bucket)
+                count += entry->requirement_count;
+        else
+            for (const BestiaryEntry *entry = bestiary_index.buckets[i]; entry != NULL; entry = entry->next_in_bucket)
+                count += entry->monster_count;
+    }
+
+    TableVersion *table = malloc(sizeof(TableVersion) + count * sizeof(Posting));
+    Posting *postings = (Posting *)(table + 1);
+    int next = 0;
+    for (int i = 0; i < bucket_count; i++)
+    {
+        if (uses)
+        {
+            for (const BrewIngredient *entry = brew_index.buckets[i]; entry != NULL; entry = entry->next_in_bucket)
+            {
+                for (int j = 0; j < entry->requirement_count; j++, next++)
+                {
+                    postings[next].name = entry->name;
+                    postings[next].owner = formulas[entry->requirements[j].formula].name;
+                }
+            }
+        }
+        else
+        {
+            for (const BestiaryEntry *entry = bestiary_index.buckets[i]; entry != NULL; entry = entry->next_in_bucket)
+            {
+                for (int j = 0; j < entry->monster_count; j++, next++)
+                {
+                    postings[next].name = entry->name;
+                    postings[next].owner = monsters[entry->monsters[j]].name;
+                }
+            }
+        }
+    }
+    qsort(postings, count, sizeof(Posting), cmp_posting);
+
+    table->items = postings;
+    table->count = 0;
+    for (int i = 0; i < count; i++)
+        if (table->count == 0 || cmp_posting(&postings[table->count - 1], &postings[i]) != 0)
+            postings[table->count++] = postings[i];
+    return table;
+}
+
+static TableVersion *copy_table(SnapshotTable table)
+{
+    /**
+        * Function Name: copy_table
+        *
+        * Purpose:
+        *    Copies one table of the calling thread's session into a new immutable version.
+        *
+        * Parameters:
+        *     SnapshotTable table - The table to be copied.
+        *
+        * Return:
+        *     TableVersion * - The new version.
+        */
+    switch (table)
+    {
+    case SNAPSHOT_INGREDIENTS:
+        return copy_counted_table(ingredients, last_added_ingredient_index + 1, sizeof(Ingredient), cmpIngredient);
+    case SNAPSHOT_POTIONS:
+        return copy_counted_table(potions, last_added_potion_index + 1, sizeof(Potion), cmpPotion);
+    case SNAPSHOT_TROPHIES:
+        return copy_counted_table(trophies, last_added_trophy_index + 1, sizeof(Trophy), cmpTrophy);
+    case SNAPSHOT_FORMULAS:
+        return copy_formula_table();
+    case SNAPSHOT_BREWABLE:
+        return copy_brewable_table();
+    case SNAPSHOT_USES:
+        return copy_postings_table(TRUE);
+    case SNAPSHOT_EFFECTIVE:
+        return copy_postings_table(FALSE);
+    case SNAPSHOT_RANKED_INGREDIENTS:
+    case SNAPSHOT_RANKED_POTIONS:
+    case SNAPSHOT_RANKED_TROPHIES:
+        return copy_ranked_table(table - SNAPSHOT_RANKED_INGREDIENTS);
+    default:
+        return copy_monster_table();
+    }
+}
+
+static void retire_block(SnapshotStore *store, void *block, long epoch)
+{
+    /**
+        * Function Name: retire_block
+        *
+        * Purpose:
+        *    Queues a block that is no longer current, to be freed by snapshot_reclaim.
+        *
+        * Parameters:
+        *     SnapshotStore *store - The store.
+        *     void *block - The snapshot or table version.
+        *     long epoch - The epoch the block was replaced in.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    if (store->retired_count >= store->retired_capacity)
+    {
+        store->retired_capacity *= 2;
+        store->retired = realloc(store->retired, store->retired_capacity * sizeof(RetiredBlock));
+    }
+    store->retired[store->retired_count].block = block;
+    store->retired[store->retired_count].epoch = epoch;
+    store->retired_count++;
+}
+
+Snapshot *snapshot_publish(SnapshotStore *store, unsigned dirty, long epoch)
+{
+    /**
+        * Function Name: snapshot_publish
+        *
+        * Purpose:
+        *    Publishes the calling thread's session as the new current snapshot, for the single writer only.
+        *
+        * Parameters:
+        *     SnapshotStore *store - The store.
+        *     unsigned dirty - The tables changed since the previous publish, see snapshot_dirty_tables.
+        *     long epoch - The writer's current epoch, readers that may still hold the replaced version
+        *                  all started before it.
+        *
+        * Return:
+        *     Snapshot * - The new snapshot.
+        *
+        * Side Effects:
+        *     - Copies the dirty tables and shares the others with the previous snapshot, every table is copied the first time.
+        *     - The previous snapshot and its replaced tables are retired, nothing is freed here and readers are never waited for.
+        */
+    Snapshot *previous = atomic_load_explicit(&store->current, memory_order_relaxed);
+    Snapshot *snapshot = malloc(sizeof(Snapshot));
+    snapshot->version = previous == NULL ? 1 : previous->version + 1;
+
+    for (int t = 0; t < SNAPSHOT_TABLE_COUNT; t++)
+    {
+        if (previous != NULL && !(dirty & 1u << t))
+        {
+            snapshot->tables[t] = previous->tables[t];
+            continue;
+        }
+        snapshot->tables[t] = copy_table(t);
+        if (previous != NULL)
+            retire_block(store, previous->tables[t], epoch);
+    }
+
+    //the release store makes the copied tables visible to every reader that loads the new snapshot
+    atomic_store_explicit(&store->current, snapshot, memory_order_release);
+    if (previous != NULL)
+        retire_block(store, previous, epoch);
+    return snapshot;
+}
+
+Snapshot *snapshot_current(SnapshotStore *store)
+{
+    /**
+        * Function Name: snapshot_current
+        *
+        * Purpose:
+        *    Returns the latest published snapshot, from any thread and without locking.
+        *
+        * Parameters:
+        *     SnapshotStore *store - The store.
+        *
+        * Return:
+        *     Snapshot * - The current snapshot, NULL if nothing was published yet.
+        *
+        * Side Effects:
+        *     - The snapshot stays valid as long as the caller's epoch is not passed to snapshot_reclaim.
+        */
+    return atomic_load_explicit(&store->current, memory_order_acquire);
+}
+
+void snapshot_reclaim(SnapshotStore *store, long safe_epoch)
+{
+    /**
+        * Function Name: snapshot_reclaim
+        *
+        * Purpose:
+        *    Frees the retired blocks that no reader can hold anymore, for the writer only.
+        *
+        * Parameters:
+        *     SnapshotStore *store - The store.
+        *     long safe_epoch - Every reader that started before this epoch is done.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Frees every block retired at an epoch not after safe_epoch, the rest stays queued.
+        */
+    int kept = 0;
+    for (int i = 0; i < store->retired_count; i++)
+    {
+        if (store->retired[i].epoch <= safe_epoch)
+            free(store->retired[i].block);
+        else
+            store->retired[kept++] = store->retired[i];
+    }
+    store->retired_count = kept;
+}
+
+void snapshot_store_free(SnapshotStore *store)
+{
+    /**
+        * Function Name: snapshot_store_free
+        *
+        * Purpose:
+        *    Releases the current snapshot and every retired block, once all readers are gone.
+        *
+        * Parameters:
+        *     SnapshotStore *store - The store to be released.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        */
+    for (int i = 0; i < store->retired_count; i++)
+        free(store->retired[i].block);
+    free(store->retired);
+    store->retired = NULL;
+    store->retired_count = 0;
+
+    Snapshot *snapshot = atomic_load_explicit(&store->current, memory_order_relaxed);
+    if (snapshot != NULL)
+    {
+        for (int t = 0; t < SNAPSHOT_TABLE_COUNT; t++)
+            free(snapshot->tables[t]);
+        free(snapshot);
+    }
+    atomic_store_explicit(&store->current, NULL, memory_order_relaxed);
+}
+
+void snapshot_install(const Snapshot *snapshot)
+{
+    /**
+        * Function Name: snapshot_install
+        *
+        * Purpose:
+        *    Points the calling thread's tables at a snapshot, so the query handlers answer from it.
+        *
+        * Parameters:
+        *     const Snapshot *snapshot - The snapshot to be read.
+        *
+        * Return:
+        *     void - This function does not return a value.
+        *
+        * Side Effects:
+        *     - Sets the thread's table pointers, indices and capacities, the views and tables_read_only.
+        *     - Only the query handlers may run afterwards, and init_state or free_state must not be called on these tables.
+        */
+    ingredients = snapshot->tables[SNAPSHOT_INGREDIENTS]->items;
+    last_added_ingredient_index = snapshot->tables[SNAPSHOT_INGREDIENTS]->count - 1;
+    ingredient_capacity = snapshot->tables[SNAPSHOT_INGREDIENTS]->count;
+
+    potions = snapshot->tables[SNAPSHOT_POTIONS]->items;
+    last_added_potion_index = snapshot->tables[SNAPSHOT_POTIONS]->count - 1;
+    potion_capacity = snapshot->tables[SNAPSHOT_POTIONS]->count;
+
+    trophies = snapshot->tables[SNAPSHOT_TROPHIES]->items;
+    last_added_trophy_index = snapshot->tables[SNAPSHOT_TROPHIES]->count - 1;
+    trophy_capacity = snapshot->tables[SNAPSHOT_TROPHIES]->count;
+
+    formulas = snapshot->tables[SNAPSHOT_FORMULAS]->items;
+    last_added_formula_index = snapshot->tables[SNAPSHOT_FORMULAS]->count - 1;
+    formula_capacity = snapshot->tables[SNAPSHOT_FORMULAS]->count;
+
+    monsters = snapshot->tables[SNAPSHOT_MONSTERS]->items;
+    last_added_monster_index = snapshot->tables[SNAPSHOT_MONSTERS]->count - 1;
+    monster_capacity = snapshot->tables[SNAPSHOT_MONSTERS]->count;
+
+    brewable_view = snapshot->tables[SNAPSHOT_BREWABLE];
+    uses_view = snapshot->tables[SNAPSHOT_USES];
+    effective_view = snapshot->tables[SNAPSHOT_EFFECTIVE];
+    for (int t = 0; t < RANK_INVENTORY_COUNT; t++)
+        ranked_view[t] = snapshot->tables[SNAPSHOT_RANKED_INGREDIENTS + t];
+    tables_read_only = TRUE;
+}
+
+const Posting *snapshot_find_postings(const TableVersion *table, const char *name, int *count)
+{
+    /**
+        * Function Name: snapshot_find_postings
+        *
+        * Purpose:
+        *    Looks up the postings of a name in a snapshot's reverse index.
+        *
+        * Parameters:
+        *     const TableVersion *table - The SNAPSHOT_USES or SNAPSHOT_EFFECTIVE version.
+        *     const char *name - The name.
+        *     int *count - Receives the number of postings.
+        *
+        * Return:
+        *     const Posting * - The first posting, its owners in alphabetical order, NULL if there is none.
+        */
+    const Posting *postings = table->items;
+    int low = 0;
+    int high = table->count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (strcmp(postings[middle].name, name) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    int end = low;
+    while (end < table->count && strcmp(postings[end].name, name) == 0)
+        end++;
+    *count = end - low;
+    return *count > 0 ? &postings[low] : NULL;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "globals.h"
+
+THREAD_LOCAL int last_added_ingredient_index = -1;
+THREAD_LOCAL int last_added_potion_index = -1;
+THREAD_LOCAL int last_added_sign_index = -1;
+THREAD_LOCAL int last_added_monster_index = -1;
+THREAD_LOCAL int last_added_trophy_index = -1;
+THREAD_LOCAL int last_added_formula_index = -1;
+
+THREAD_LOCAL int ingredient_capacity = 2;
+THREAD_LOCAL int potion_capacity = 2;
+THREAD_LOCAL int trophy_capacity = 2;
+THREAD_LOCAL int monster_capacity = 2;
+THREAD_LOCAL int formula_capacity = 2;
+THREAD_LOCAL int sign_capacity = 2;
+
+THREAD_LOCAL Ingredient *ingredients;
+THREAD_LOCAL Potion *potions;
+THREAD_LOCAL Sign *signs;
+THREAD_LOCAL Monster *monsters;
+THREAD_LOCAL Trophy *trophies;
+THREAD_LOCAL PotionFormula *formulas;
+
+THREAD_LOCAL Bool tables_read_only;
+THREAD_LOCAL const TableVersion *brewable_view;
+THREAD_LOCAL const TableVersion *uses_view;
+THREAD_LOCAL const TableVersion *effective_view;
+THREAD_LOCAL const TableVersion *ranked_view[RANK_INVENTORY_COUNT];
+
+THREAD_LOCAL FILE *output_stream;
+THREAD_LOCAL OutputBuffer *output_buffer;
+
+THREAD_LOCAL Command line_command;
+
+void init_state()
+{
+    /**
+    * Function Name: init_state
+    *
+    * Purpose:
+    *    Starts a new empty session on the calling thread.
+    *
+    * Parameters:
+    *     void - This function does not take any parameters.
+    *
+    * Return:
+    *     void - This function does not return a value.
+    *
+    * Side Effects:
+    *     - Resets the indices and capacities of the calling thread's tables.
+    *     - Allocates the ingredients, potions, trophies, formulas, monsters, and signs arrays.
+    *     - Other threads' sessions are not affected since all state is thread local.
+    */
+    last_added_ingredient_index = -1;
+    last_added_potion_index = -1;
+    last_added_sign_index = -1;
+    last_added_monster_index = -1;
+    last_added_trophy_index = -1;
+    last_added_formula_index = -1;
+
+    ingredient_capacity = 2;
+    potion_capacity = 2;
+    trophy_capacity = 2;
+    monster_capacity = 2;
+    formula_capacity = 2;
+    sign_capacity = 2;
+
+    ingredients = mem_malloc(MEM_INVENTORY, sizeof(Ingredient) * ingredient_capacity);
+    potions = mem_malloc(MEM_POTIONS, sizeof(Potion) * potion_capacity);
+    trophies = mem_malloc(MEM_TROPHIES, sizeof(Trophy) * trophy_capacity);
+    formulas = mem_malloc(MEM_FORMULAS, sizeof(PotionFormula) * formula_capacity);
+    monsters = mem_malloc(MEM_BESTIARY, sizeof(Monster) * monster_capacity);
+    signs = mem_malloc(MEM_BESTIARY, sizeof(Sign) * sign_capacity);
+}
+
+void free_state()
+{
+    /**
+    * Function Name: free_state
+    *
+    * Purpose:
+    *    Releases every table of the calling thread's session.
+    *
+    * Parameters:
+    *     void - This function does not take any parameters.
+    *
+    * Return:
+    *     void - This function does not return a value.
+    *
+    * Side Effects:
+    *     - Adds the memory counters of the session to the process totals first, then resets them last.
+    *     - Frees the ingredient lists of the formulas and the sign and potion lists of the monsters.
+    *     - Frees the ingredients, potions, trophies, formulas, monsters, and signs arrays.
+    *     - Frees the buffers of the thread's reusable line command, its parse cache, its brew, bestiary, rank and inventory
+    *       indexes and its LOOT and TRADE plan buffers.
+    *     - Frees the names of the session last, the tables and indexes point at them.
+    */
+    mem_stats_end_session();
+
+    for (int i = 0; i <= last_added_formula_index; i++)
+    {
+        mem_free(MEM_FORMULAS, formulas[i].ingredients, formulas[i].ingredient_capacity * sizeof(Ingredient));
+    }
+    for (int i = 0; i <= last_added_monster_index; i++)
+    {
+        mem_free(MEM_BESTIARY, monsters[i].signs, monsters[i].sign_capacity * sizeof(Sign));
+        mem_free(MEM_BESTIARY, monsters[i].potions, monsters[i].potion_capacity * sizeof(Potion));
+    }
+
+    mem_free(MEM_INVENTORY, ingredients, ingredient_capacity * sizeof(Ingredient));
+    mem_free(MEM_POTIONS, potions, potion_capacity * sizeof(Potion));
+    mem_free(MEM_TROPHIES, trophies, trophy_capacity * sizeof(Trophy));
+    mem_free(MEM_FORMULAS, formulas, formula_capacity * sizeof(PotionFormula));
+    mem_free(MEM_BESTIARY, monsters, monster_capacity * sizeof(Monster));
+    mem_free(MEM_BESTIARY, signs, sign_capacity * sizeof(Sign));
+
+    command_free(&line_command);
+    parse_cache_free();
+    line_parser_free();
+    brew_index_free();
+    bestiary_index_free();
+    rank_index_free();
+    inventory_index_free();
+    item_plan_free();
+    name_pool_free();
+    mem_stats_free();
+}
@@ -1,120 +1,53 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include "globals.h"
 
-void remove_trailing_newline(char *line)
+void print_output(const char *format, ...)
 {
     /**
-        * Function Name: remove_trailing_newline
+        * Function Name: print_output
         *
         * Purpose:
-        *    Removes the trailing newline character from a string.
-        * 
-        * Parameters:
-        *     char *line - The string from which to remove the trailing newline.
-        *
-        * Return:
-        *     void - This function does not return a value.
-        *
-        * Side Effects:
-        *     - Modifies the input string by replacing the trailing newline character with a null terminator.
-        *     - The function does not allocate or reallocate memory.
-        *     - The function does not print any output.
-        *     - The function does not modify any global variables or data structures.
-     */
-    size_t len = strlen(line);
-    if (len > 0 && line[len - 1] == '\n')
-    {
-        line[len - 1] = '\0';
-    }
-}
-
-void remove_trailing_spaces(char *line)
-{
-    /**
-        * Function Name: remove_trailing_spaces
-        *
-        * Purpose:
-        *    Removes trailing spaces and tabs from a string.
+        *    Prints a response of the current session, like printf.
         *
         * Parameters:
-        *     char *line - The string from which to remove trailing spaces and tabs.
+        *     const char *format - The printf style format string.
+        *     ... - The values to be formatted.
         *
         * Return:
         *     void - This function does not return a value.
         *
         * Side Effects:
-        *     - Modifies the input string by replacing trailing spaces and tabs with null terminators.
-        *     - The function does not allocate or reallocate memory.
-        *     - The function does not print any output.
-        *     - The function does not modify any global variables or data structures.
+        *     - Appends to the session's output_buffer if it has one, doubling its capacity when full.
+        *     - Otherwise writes to the session's output_stream, or to stdout if the session has none.
+        *     - The function does not modify any other global variables or data structures.
      */
-    size_t len = strlen(line);
-    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t'))
+    va_list args;
+    va_start(args, format);
+    if (output_buffer == NULL)
     {
-        line[--len] = '\0';
+        vfprintf(output_stream != NULL ? output_stream : stdout, format, args);
+        va_end(args);
+        return;
     }
-}
 
-int split_into_words(char *line, char words[][MAX_WORD_LEN])
-{
-    /**
-        * Function Name: split_into_words
-        *
-        * Purpose:
-        *    Splits a string into words based on spaces, commas, and question marks.
-        *
-        * Parameters:
-        *     char *line - The string to be split into words.
-        *     char words[][MAX_WORD_LEN] - The array to store the split words.
-        *
-        * Return:
-        *     int - The number of words in the input string.
-        *
-        * Side Effects:
-        *     - Modifies the input array by storing the split words.
-        *     - The function treats spaces as delimiters and ignores leading spaces.
-        *     - The function treats consecutive spaces as a single delimiter.
-        *     - Treats commas and question marks as separate words even if they are smushed to a word.
-        *     - The function does not allocate or reallocate memory.
-        *     - The function does not print any output.
-        *     - The function does not modify any global variables or data structures.
-     */
-    int count = 0;
-    int i = 0;
-    while (line[i] != '\0')
+    va_list retry;
+    va_copy(retry, args);
+    int length = vsnprintf(output_buffer->data + output_buffer->length,
+                           output_buffer->capacity - output_buffer->length, format, args);
+    if (output_buffer->length + length >= output_buffer->capacity)
     {
-        while (line[i] == ' ')
-            i++;
-
-        if (line[i] == '\0')
-            break;
-
-        if (line[i] == ',' || line[i] == '?')
-        {
-            words[count][0] = line[i];
-            words[count][1] = '\0';
-            count++;
-            i++;
-        }
-        else
-        {
-            int j = 0;
-            while (line[i] != '\0' && line[i] != ' ' && line[i] != ',' && line[i] != '?')
-            {
-                if (j < MAX_WORD_LEN - 1)
-                {
-                    words[count][j++] = line[i];
-                }
-                i++;
-            }
-            words[count][j] = '\0';
-            count++;
-        }
+        while (output_buffer->length + length >= output_buffer->capacity)
+            output_buffer->capacity = output_buffer->capacity == 0 ? 256 : output_buffer->capacity * 2;
+        output_buffer->data = realloc(output_buffer->data, output_buffer->capacity);
+        vsnprintf(output_buffer->data + output_buffer->length,
+                  output_buffer->capacity - output_buffer->length, format, retry);
     }
-
-    return count;
+    output_buffer->length += length;
+    va_end(retry);
+    va_end(args);
 }
 
 Bool is_alphabetic_custom(const char *token)
@@ -261,33 +194,71 @@ int cmpTrophy(const void *a, const void *b)
     */
     return strcmp(((Trophy *)a)->name, ((Trophy *)b)->name);
 }
-int cmp(const void *a, const void *b)
+int cmpSign(const void *a, const void *b)
 {
     /**
-     * Function Name: cmp
+     * Function Name: cmpSign
      *
      * Purpose:
-     *    Compares two strings for sorting.
+     *    Compares two signs based on their names for sorting.
      *
      * Parameters:
-     *     const void *a - Pointer to the first string.
-     *     const void *b - Pointer to the second string.
+     *     const void *a - Pointer to the first sign.
+     *     const void *b - Pointer to the second sign.
      *
      * Return:
      *     int - Negative if a < b, positive if a > b, zero if equal.
      *
      * Side Effects:
-     *     - Compares strings based on their names using strcmp, 
-     *       returns a negative value if the first string comes before the second string, 
-     *       a positive value if it comes after, and zero if they are equal.
-     *     - The function does not modify the input strings.
+     *     - Compares signs based on their names using strcmp.
+     *     - The function does not modify the input signs.
      *     - The function does not allocate or reallocate memory.
      *     - The function does not print any output.
      *     - The function does not modify any global variables or data structures.
     */
-    const char *s1 = *(const char **)a;
-    const char *s2 = *(const char **)b;
-    return strcmp(s1, s2);
+    return strcmp(((Sign *)a)->name, ((Sign *)b)->name);
+}
+int cmpMonster(const void *a, const void *b)
+{
+    /**
+     * Function Name: cmpMonster
+     *
+     * Purpose:
+     *    Compares two monsters based on their names for sorting.
+     *
+     * Parameters:
+     *     const void *a - Pointer to the first monster.
+     *     const void *b - Pointer to the second monster.
+     *
+     * Return:
+     *     int - Negative if a < b, positive if a > b, zero if equal.
+     *
+     * Side Effects:
+     *     - Compares monsters based on their names using strcmp.
+     *     - The function does not modify the input monsters.
+     *     - The function does not allocate or reallocate memory.
+     *     - The function does not print any output.
+     *     - The function does not modify any global variables or data structures.
+    */
+    return strcmp(((Monster *)a)->name, ((Monster *)b)->name);
+}
+
+int cmpFormula(const void *a, const void *b)
+{
+    /**
+        * Function Name: cmpFormula
+        *
+        * Purpose:
+        *    Compares two potion formulas based on their potion names for sorting.
+        *
+        * Parameters:
+        *     const void *a - Pointer to the first formula.
+        *     const void *b - Pointer to the second formula.
+        *
+        * Return:
+        *     int - Negative if a < b, positive if a > b, zero if equal.
+        */
+    return strcmp(((PotionFormula *)a)->name, ((PotionFormula *)b)->name);
 }
 
 int cmpForRecipe(const void *a, const void *b)
@@ -324,44 +295,55 @@ int cmpForRecipe(const void *a, const void *b)
     return (*((Ingredient *)b)).quantity - (*((Ingredient *)a)).quantity;
 }
 
-Bool is_valid_potion_name_spacing(const char *line, const char *potion_name)
+unsigned hash_name(const char *name)
 {
     /**
-     * Function Name: is_valid_potion_name_spacing
-     *
-     * Purpose:
-     *    Checks if the potion name has valid spacing in the input line.
-     *
-     * Parameters:
-     *     const char *line - The input line containing the potion name.
-     *     const char *potion_name - The potion name to check for valid spacing.
-     *
-     * Return:
-     *     Bool - TRUE if the spacing is valid, FALSE otherwise.
-     *
-     * Side Effects:
-     *     - Checks the spacing of the potion name in the input line to ensure it doesn't have multiple spaces between the words.
-     *     - The function does not modify the input line or potion name.
-     *     - The function does not allocate or reallocate memory.
-     *     - The function does not print any output.
-     *     - The function does not modify any global variables or data structures.
-    */
-    const char *start = strstr(line, potion_name);
-    if (!start)
-        return FALSE;
-
-    for (int i = 0; start[i] != '\0'; i++)
+        * Function Name: hash_name
+        *
+        * Purpose:
+        *    Hashes a name with 32-bit FNV-1a.
+        *
+        * Parameters:
+        *     const char *name - The name.
+        *
+        * Return:
+        *     unsigned - The hash.
+        */
+    unsigned hash = 2166136261u;
+    for (; *name != '\0'; name++)
     {
-        if (start[i] == ' ')
-        {
-            if (start[i + 1] == ' ')
-            {
-                return FALSE;
-            }
-        }
-        if (start[i] == '?' || start[i] == '\0')
-            break;
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
     }
+    return hash;
+}
 
-    return TRUE;
+int first_name_from(const void *items, int count, size_t item_size, const char *name)
+{
+    /**
+        * Function Name: first_name_from
+        *
+        * Purpose:
+        *    Binary searches a table sorted by name, whose items start with a pointer to their name.
+        *
+        * Parameters:
+        *     const void *items - The first item.
+        *     int count - The number of items.
+        *     size_t item_size - The size of one item.
+        *     const char *name - The name searched for.
+        *
+        * Return:
+        *     int - The position of the first item whose name is not smaller, count if there is none.
+        */
+    int low = 0;
+    int high = count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (strcmp(*(const char *const *)((const char *)items + middle * item_size), name) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
 }